@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <LightClusters.hpp>
+#include <ThreadPool.hpp>
+
+/**
+ * GL-free checks of LightClusters::build(): the light list of each cluster is compared to a
+ * brute force reference, testing every light against every cluster (of the depth slices it overlaps).
+ *  - Lower bound: a light must be listed in a cluster if its sphere contains a point sampled in the volume of the cluster,
+ *  - Upper bound: a listed light must intersect the view space AABB of the cluster.
+ * Lists must also be sorted and their offsets contiguous, and be the same with or without workers.
+ * Also prints the build times of 100k lights, serial and with the workers of ThreadPool::get().
+**/
+
+namespace
+{
+
+constexpr size_t	Width = 1280;
+constexpr size_t	Height = 720;
+constexpr float		Near = 0.1f;
+constexpr float		Far = 1000.0f;
+constexpr size_t	Samples = 3;		///< Points sampled along each dimension of a cluster
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+	if(!condition)
+	{
+		std::cerr << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+const glm::mat4& projection()
+{
+	static const glm::mat4 p = glm::perspective(glm::radians(60.0f), static_cast<float>(Width) / Height, Near, Far);
+	return p;
+}
+
+/**
+ * Reference grid, independent of the builder apart from the documented layout. The slices use the near and far
+ * planes of the builder (also used by the shader): the ones derived from the projection are a bit off.
+**/
+struct Reference
+{
+	glm::uvec3				count;
+	std::vector<glm::vec3>	points;		///< Samples * Samples * Samples view space points by cluster
+	std::vector<glm::vec3>	bounds;		///< View space AABB (min, max) by cluster
+
+	Reference(float near, float far)
+	{
+		count = glm::uvec3{(Width + LightClusters::TileSize - 1) / LightClusters::TileSize,
+						   (Height + LightClusters::TileSize - 1) / LightClusters::TileSize,
+						   LightClusters::DepthSlices};
+		const glm::mat4 inv = glm::inverse(projection());
+		// View space point of a pixel at a distance along -z
+		auto unproject = [&](const glm::vec2& pixel, float depth) {
+			const glm::vec4 p = inv * glm::vec4{2.0f * pixel.x / Width - 1.0f, 2.0f * pixel.y / Height - 1.0f, -1.0f, 1.0f};
+			const glm::vec3 v = glm::vec3{p} / p.w;
+			return v * (depth / -v.z);
+		};
+		auto slice_depth = [=](float z) { return near * std::pow(far / near, z / LightClusters::DepthSlices); };
+
+		for(size_t z = 0; z < count.z; ++z)
+			for(size_t y = 0; y < count.y; ++y)
+				for(size_t x = 0; x < count.x; ++x)
+				{
+					const glm::vec2 pixel_min{x * LightClusters::TileSize, y * LightClusters::TileSize};
+					const glm::vec2 pixel_max{std::min((x + 1) * LightClusters::TileSize, Width),
+											  std::min((y + 1) * LightClusters::TileSize, Height)};
+					glm::vec3 min{std::numeric_limits<float>::max()};
+					glm::vec3 max{std::numeric_limits<float>::lowest()};
+					for(int i = 0; i < 8; ++i)
+					{
+						const glm::vec3 c = unproject({(i & 1) ? pixel_max.x : pixel_min.x, (i & 2) ? pixel_max.y : pixel_min.y},
+													  slice_depth(static_cast<float>(z + (i >> 2))));
+						min = glm::min(min, c);
+						max = glm::max(max, c);
+					}
+					bounds.push_back(min);
+					bounds.push_back(max);
+					// Strictly inside the cluster: no ambiguity on its boundaries
+					for(size_t k = 0; k < Samples; ++k)
+						for(size_t j = 0; j < Samples; ++j)
+							for(size_t i = 0; i < Samples; ++i)
+							{
+								const glm::vec3 t = (glm::vec3{i, j, k} + 0.5f) / static_cast<float>(Samples);
+								points.push_back(unproject(glm::mix(pixel_min, pixel_max, glm::vec2{t}), slice_depth(z + t.z)));
+							}
+				}
+	}
+
+	size_t clusterCount() const { return count.x * count.y * count.z; }
+
+	bool mustContain(size_t cluster, const glm::vec3& center, float range) const
+	{
+		for(size_t i = cluster * Samples * Samples * Samples; i < (cluster + 1) * Samples * Samples * Samples; ++i)
+			if(glm::distance(points[i], center) < range)
+				return true;
+		return false;
+	}
+
+	/// Rounding of the bounds, computed differently by the builder
+	static float slack(const glm::vec3& center) { return 1e-4f * std::abs(center.z); }
+
+	bool mayContain(size_t cluster, const glm::vec3& center, float range) const
+	{
+		const glm::vec3 closest = glm::clamp(center, bounds[2 * cluster], bounds[2 * cluster + 1]);
+		return glm::distance(closest, center) <= range + slack(center);
+	}
+
+	/// Necessary condition of mayContain() for all the clusters of a slice (they share their depth bounds).
+	bool mayContainSlice(size_t slice, const glm::vec3& center, float range) const
+	{
+		const size_t cluster = slice * count.y * count.x;
+		return center.z + range + slack(center) >= bounds[2 * cluster].z && center.z - range - slack(center) <= bounds[2 * cluster + 1].z;
+	}
+};
+
+/// Compares every list of c to the reference, returns the number of (cluster, light) pairs.
+size_t check_lists(const LightClusters& c, const std::vector<PointLight>& lights, const glm::mat4& view, const std::string& label)
+{
+	check(std::abs(c.getNear() - Near) < 1e-4f * Near && std::abs(c.getFar() - Far) < 1e-2f * Far, label + ": near/far planes");
+	const Reference ref(c.getNear(), c.getFar());
+	check(c.getCount() == ref.count, label + ": cluster count");
+	if(c.getClusters().size() != ref.clusterCount())
+	{
+		check(false, label + ": size of the cluster list");
+		return 0;
+	}
+
+	std::vector<glm::vec3> centers;
+	for(const auto& l : lights)
+		centers.emplace_back(view * glm::vec4{l.position, 1.0f});
+	// Enabled lights overlapping the depth range of each slice: only skips lights out of reach of the whole slice.
+	std::vector<std::vector<uint32_t>> candidates(ref.count.z);
+	for(size_t z = 0; z < ref.count.z; ++z)
+		for(uint32_t l = 0; l < lights.size(); ++l)
+			if(lights[l].info >= 0.0f && ref.mayContainSlice(z, centers[l], lights[l].range))
+				candidates[z].push_back(l);
+
+	const auto& indices = c.getLightIndices();
+	size_t missing = 0, extra = 0, unsorted = 0;
+	uint32_t offset = 0;
+	for(size_t i = 0; i < ref.clusterCount(); ++i)
+	{
+		const auto& cluster = c.getClusters()[i];
+		if(cluster.offset != offset || cluster.offset + cluster.count > indices.size())
+		{
+			check(false, label + ": bad range for cluster " + std::to_string(i));
+			return 0;
+		}
+		offset += cluster.count;
+		const auto begin = indices.begin() + cluster.offset;
+		const auto end = begin + cluster.count;
+		if(std::adjacent_find(begin, end, std::greater_equal<uint32_t>()) != end)
+			++unsorted;
+		for(auto it = begin; it != end; ++it)
+			if(*it >= lights.size() || lights[*it].info < 0.0f || !ref.mayContain(i, centers[*it], lights[*it].range))
+				++extra;
+		for(const uint32_t l : candidates[i / (ref.count.x * ref.count.y)])
+			if(ref.mayContain(i, centers[l], lights[l].range) && ref.mustContain(i, centers[l], lights[l].range) &&
+			   !std::binary_search(begin, end, l))
+				++missing;
+	}
+	check(offset == indices.size(), label + ": unused light indices");
+	check(unsorted == 0, label + ": " + std::to_string(unsorted) + " unsorted list(s)");
+	check(missing == 0, label + ": " + std::to_string(missing) + " missing light(s)");
+	check(extra == 0, label + ": " + std::to_string(extra) + " light(s) outside of their cluster");
+	return indices.size();
+}
+
+/// Clusters listing the light l.
+size_t clusters_of(const LightClusters& c, uint32_t l)
+{
+	size_t n = 0;
+	for(const auto& cluster : c.getClusters())
+		n += std::count(c.getLightIndices().begin() + cluster.offset, c.getLightIndices().begin() + cluster.offset + cluster.count, l);
+	return n;
+}
+
+bool listed(const LightClusters& c, size_t cluster, uint32_t l)
+{
+	const auto& cl = c.getClusters()[cluster];
+	const auto begin = c.getLightIndices().begin() + cl.offset;
+	return std::find(begin, begin + cl.count, l) != begin + cl.count;
+}
+
+void test_known_lights()
+{
+	const glm::mat4 view{1.0f}; // Looking along -z
+	const std::vector<PointLight> lights{
+		PointLight{{0.0f, 0.0f, -5.0f}, 0.5f},			// 0: Center of the screen
+		PointLight{{0.0f, 0.0f, -5.0f}, 0.5f, glm::vec3{1.0f}, -1.0f},	// 1: Disabled
+		PointLight{{0.0f, 0.0f, 5.0f}, 1.0f},			// 2: Behind the camera
+		PointLight{{0.0f, 0.0f, -1100.0f}, 10.0f},		// 3: Beyond the far plane
+		PointLight{{0.0f, 0.0f, 0.0f}, 0.5f},			// 4: Crossing the near plane
+		PointLight{{500.0f, 0.0f, -10.0f}, 1.0f},		// 5: Outside of the frustum
+		PointLight{{0.0f, 0.0f, -50.0f}, 200.0f},		// 6: Huge, most of the clusters
+	};
+	LightClusters c;
+	c.build(lights, view, projection(), Width, Height);
+	check_lists(c, lights, view, "Known lights");
+
+	const auto& count = c.getCount();
+	auto index = [&](size_t x, size_t y, size_t z) { return (z * count.y + y) * count.x + x; };
+	// Center of the screen is on the corner of 4 tiles
+	const size_t cx = Width / 2 / LightClusters::TileSize;
+	const size_t cy = Height / 2 / LightClusters::TileSize;
+	const size_t slice = c.getSlice(5.0f);
+	check(listed(c, index(cx, cy, slice), 0) && listed(c, index(cx - 1, cy - 1, slice), 0), "Light 0 should be in the clusters at its center");
+	check(!listed(c, index(0, 0, slice), 0), "Light 0 shouldn't be in a corner cluster");
+	check(clusters_of(c, 1) == 0, "Disabled light 1 shouldn't be listed");
+	check(clusters_of(c, 2) == 0, "Light 2 (behind the camera) shouldn't be listed");
+	check(clusters_of(c, 3) == 0, "Light 3 (beyond the far plane) shouldn't be listed");
+	check(listed(c, index(cx, cy, 0), 4), "Light 4 (crossing the near plane) should be in the first slice");
+	check(clusters_of(c, 5) == 0, "Light 5 (outside of the frustum) shouldn't be listed");
+	check(listed(c, index(0, 0, c.getSlice(50.0f)), 6) && !listed(c, index(0, 0, LightClusters::DepthSlices - 1), 6), "Light 6 should cover its slices only");
+}
+
+std::vector<PointLight> random_lights(size_t count, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> xz(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> y(-20.0f, 40.0f);
+	std::uniform_real_distribution<float> range(0.5f, 8.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<PointLight> lights;
+	for(size_t i = 0; i < count; ++i)
+	{
+		// One draw per statement: the order of evaluation of arguments is unspecified
+		PointLight l;
+		l.position.x = xz(rng);
+		l.position.y = y(rng);
+		l.position.z = xz(rng);
+		l.range = range(rng);
+		l.info = unit(rng) < 0.05f ? -1.0f : 1.0f; // Some disabled lights
+		lights.push_back(l);
+	}
+	return lights;
+}
+
+const glm::mat4& random_view()
+{
+	static const glm::mat4 v = glm::lookAt(glm::vec3{-30.0f, 10.0f, 40.0f}, glm::vec3{20.0f, 0.0f, -10.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+	return v;
+}
+
+void test_random_lights()
+{
+	const auto lights = random_lights(2000, 42);
+	LightClusters c;
+	c.build(lights, random_view(), projection(), Width, Height);
+	const size_t pairs = check_lists(c, lights, random_view(), "2000 random lights");
+	check(pairs > 0, "2000 random lights: empty clusters");
+}
+
+bool same_lists(const LightClusters& a, const LightClusters& b)
+{
+	return a.getLightIndices() == b.getLightIndices() &&
+		   std::equal(a.getClusters().begin(), a.getClusters().end(), b.getClusters().begin(), b.getClusters().end(),
+					  [](const LightClusters::Cluster& l, const LightClusters::Cluster& r) { return l.offset == r.offset && l.count == r.count; });
+}
+
+/// Fastest of a few builds, in ms.
+double build_time(LightClusters& c, const std::vector<PointLight>& lights, ThreadPool* pool)
+{
+	double best = std::numeric_limits<double>::max();
+	for(int i = 0; i < 5; ++i)
+	{
+		c.build(lights, random_view(), projection(), Width, Height, pool);
+		best = std::min(best, c.getBuildTime());
+	}
+	return best;
+}
+
+/// 100k lights: serial and pooled builds must give the same lists, also checked against the reference.
+void test_stress()
+{
+	const size_t count = 100000;
+	const auto lights = random_lights(count, 1337);
+
+	LightClusters serial;
+	const double serial_time = build_time(serial, lights, nullptr);
+	const size_t pairs = check_lists(serial, lights, random_view(), "100k random lights");
+
+	// More chunks than cores on small machines: still exercises the merge of the chunks.
+	ThreadPool pool(4);
+	LightClusters pooled;
+	pooled.build(lights, random_view(), projection(), Width, Height, &pool);
+	check(same_lists(serial, pooled), "100k random lights: lists differ with 4 workers");
+
+	const double pooled_time = build_time(pooled, lights, &ThreadPool::get());
+	check(same_lists(serial, pooled), "100k random lights: lists differ with the default workers");
+
+	std::cout << count << " lights, " << pairs << " (cluster, light) pairs: serial build " << serial_time << " ms, "
+			  << ThreadPool::get().getThreadCount() << " worker(s) " << pooled_time << " ms (best of 5, "
+			  << std::thread::hardware_concurrency() << " hardware thread(s))" << std::endl;
+}
+
+}
+
+int main()
+{
+	test_known_lights();
+	test_random_lights();
+	test_stress();
+
+	if(failures > 0)
+	{
+		std::cerr << failures << " check(s) failed." << std::endl;
+		return 1;
+	}
+	std::cout << "All checks passed." << std::endl;
+	return 0;
+}
@@ -0,0 +1,249 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <OcclusionRasterizer.hpp>
+#include <ThreadPool.hpp>
+
+/**
+ * GL-free checks of OcclusionRasterizer: depth buffers of known occluders against golden
+ * buffers (exe/golden/, 16 bits PGM images) and isVisible() on known boxes, for both the SSE
+ * and the scalar paths, with and without workers.
+ * Run from the root of the repository. '--update' rewrites the golden buffers.
+**/
+
+namespace
+{
+
+const std::string	GoldenDirectory = "exe/golden/";
+constexpr float		GoldenTolerance = 1e-4f;	///< A few steps of the 16 bits storage: rounding varies between compilers
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+	if(!condition)
+	{
+		std::cerr << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+struct Geometry
+{
+	std::vector<glm::vec3>	positions;
+	std::vector<uint32_t>	indices;
+	glm::mat4				model{1.0f};
+};
+
+/// Quad of corners a, b, c and a + c - b.
+Geometry quad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	return Geometry{{a, b, c, a + c - b}, {0, 1, 2, 0, 2, 3}};
+}
+
+/// Unit cube centered on the origin.
+Geometry cube(const glm::mat4& model)
+{
+	Geometry g;
+	for(int i = 0; i < 8; ++i)
+		g.positions.push_back(glm::vec3{(i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f});
+	g.indices = {
+		0, 1, 3, 0, 3, 2,	4, 6, 7, 4, 7, 5,	// -z, +z
+		0, 4, 5, 0, 5, 1,	2, 3, 7, 2, 7, 6,	// -y, +y
+		0, 2, 6, 0, 6, 4,	1, 5, 7, 1, 7, 3	// -x, +x
+	};
+	g.model = model;
+	return g;
+}
+
+struct Scene
+{
+	std::string				name;
+	std::vector<Geometry>	occluders;
+};
+
+const glm::mat4& view_projection()
+{
+	static const glm::mat4 vp = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f) *
+								glm::lookAt(glm::vec3{0.0f}, glm::vec3{0.0f, 0.0f, -1.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+	return vp;
+}
+
+std::vector<Scene> scenes()
+{
+	return {
+		// Wall in the center of the screen and a rotated cube in front of its top right corner
+		{"wall", {
+			quad({-4.0f, -2.0f, -10.0f}, {4.0f, -2.0f, -10.0f}, {4.0f, 2.0f, -10.0f}),
+			cube(glm::rotate(glm::translate(glm::mat4{1.0f}, glm::vec3{3.0f, 1.0f, -6.0f}), glm::radians(45.0f), glm::vec3{0.0f, 1.0f, 0.0f}))
+		}},
+		// Ground crossing the near plane (clipped) and a tilted panel, partially beyond the far plane
+		{"ground", {
+			quad({-20.0f, -1.0f, 5.0f}, {20.0f, -1.0f, 5.0f}, {20.0f, -1.0f, -50.0f}),
+			quad({-6.0f, -1.0f, -30.0f}, {-2.0f, -1.0f, -30.0f}, {-2.0f, 6.0f, -150.0f})
+		}}
+	};
+}
+
+void render(OcclusionRasterizer& r, const Scene& s, ThreadPool* pool)
+{
+	r.begin(view_projection());
+	for(const auto& o : s.occluders)
+		r.addOccluder(o.model, o.positions.data(), sizeof(glm::vec3), o.indices.data(), o.indices.size() / 3);
+	r.render(pool);
+}
+
+/// Binary PGM, 16 bits per pixel (big endian), rows from the top of the image.
+bool save_golden(const std::string& path, const float* depth)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << "P5\n" << OcclusionRasterizer::Width << " " << OcclusionRasterizer::Height << "\n65535\n";
+	for(size_t y = OcclusionRasterizer::Height; y-- > 0;)
+		for(size_t x = 0; x < OcclusionRasterizer::Width; ++x)
+		{
+			const auto v = static_cast<uint16_t>(std::round(glm::clamp(depth[y * OcclusionRasterizer::Width + x], 0.0f, 1.0f) * 65535.0f));
+			file.put(static_cast<char>(v >> 8));
+			file.put(static_cast<char>(v & 0xFF));
+		}
+	return static_cast<bool>(file);
+}
+
+bool load_golden(const std::string& path, std::vector<float>& depth)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string magic;
+	size_t width = 0, height = 0, max = 0;
+	file >> magic >> width >> height >> max;
+	file.get(); // Single whitespace before the data
+	if(!file || magic != "P5" || width != OcclusionRasterizer::Width || height != OcclusionRasterizer::Height || max != 65535)
+		return false;
+	depth.resize(width * height);
+	for(size_t y = height; y-- > 0;)
+		for(size_t x = 0; x < width; ++x)
+		{
+			const int hi = file.get();
+			const int lo = file.get();
+			depth[y * width + x] = ((hi << 8) | lo) / 65535.0f;
+		}
+	return static_cast<bool>(file);
+}
+
+size_t count_mismatches(const float* depth, const float* expected)
+{
+	size_t mismatches = 0;
+	for(size_t i = 0; i < OcclusionRasterizer::Width * OcclusionRasterizer::Height; ++i)
+		if(std::abs(depth[i] - expected[i]) > GoldenTolerance)
+			++mismatches;
+	return mismatches;
+}
+
+void test_depth(const Scene& s, bool update, ThreadPool& pool)
+{
+	const std::string path = GoldenDirectory + "occlusion_" + s.name + ".pgm";
+	constexpr size_t Size = OcclusionRasterizer::Width * OcclusionRasterizer::Height;
+
+	OcclusionRasterizer simd;
+	OcclusionRasterizer scalar;
+	scalar.UseSIMD = false;
+	render(simd, s, nullptr);
+	render(scalar, s, nullptr);
+
+	if(update)
+	{
+		check(save_golden(path, scalar.getDepth()), "Writing " + path);
+		std::cout << "Updated " << path << std::endl;
+	}
+
+	std::vector<float> golden;
+	if(!load_golden(path, golden))
+	{
+		check(false, "Reading " + path);
+		return;
+	}
+
+	for(auto* r : {&simd, &scalar})
+	{
+		const std::string label = s.name + (r == &simd ? " (SIMD)" : " (scalar)");
+		const size_t mismatches = count_mismatches(r->getDepth(), golden.data());
+		check(mismatches == 0, label + ": " + std::to_string(mismatches) + " pixel(s) differ from " + path);
+
+		// Bands rasterized by the workers: exactly the same result.
+		std::vector<float> single(r->getDepth(), r->getDepth() + Size);
+		render(*r, s, &pool);
+		check(std::memcmp(single.data(), r->getDepth(), Size * sizeof(float)) == 0, label + ": result differs with workers");
+	}
+	// Both paths perform the same operations (up to the contraction to FMAs by the compiler)
+	check(count_mismatches(simd.getDepth(), scalar.getDepth()) == 0, s.name + ": SIMD and scalar depth buffers differ");
+
+	size_t covered = 0;
+	for(size_t i = 0; i < Size; ++i)
+		covered += golden[i] < 1.0f;
+	check(covered > 0, s.name + ": empty golden buffer");
+}
+
+struct VisibilityCase
+{
+	std::string			scene;
+	std::string			name;
+	AABB<glm::vec3>		box;
+	bool				visible;
+};
+
+void test_visibility()
+{
+	const std::vector<VisibilityCase> cases = {
+		{"wall", "Fully hidden behind the wall", {{-0.5f, -0.5f, -15.5f}, {0.5f, 0.5f, -14.5f}}, false},
+		{"wall", "Hidden behind the cube (in front of the wall)", {{4.3f, 1.3f, -9.5f}, {4.7f, 1.7f, -9.0f}}, false},
+		{"wall", "Partially hidden (sticks out of the wall)", {{3.5f, -0.5f, -16.0f}, {6.5f, 0.5f, -14.0f}}, true},
+		{"wall", "In front of the wall", {{-0.5f, -0.5f, -8.5f}, {0.5f, 0.5f, -7.5f}}, true},
+		{"wall", "Intersecting the wall", {{-0.5f, -0.5f, -10.5f}, {0.5f, 0.5f, -9.5f}}, true},
+		{"wall", "Crossing the near plane", {{-1.0f, -1.0f, -2.0f}, {1.0f, 1.0f, 0.5f}}, true},
+		{"wall", "Behind the camera", {{-1.0f, -1.0f, 2.0f}, {1.0f, 1.0f, 3.0f}}, true},
+		{"wall", "Outside of the frustum", {{49.0f, -1.0f, -16.0f}, {51.0f, 1.0f, -14.0f}}, true},
+		{"ground", "Under the ground", {{-1.0f, -3.0f, -20.0f}, {1.0f, -2.0f, -18.0f}}, false},
+		{"ground", "Under the ground, crossing the near plane", {{-1.0f, -3.0f, -2.0f}, {1.0f, -2.0f, 1.0f}}, true},
+		{"ground", "On the ground", {{-1.0f, -1.0f, -20.0f}, {1.0f, 1.0f, -18.0f}}, true},
+		{"ground", "Behind the panel", {{-6.3f, -0.75f, -63.5f}, {-5.7f, -0.15f, -62.5f}}, false},
+		{"ground", "Beside the panel", {{5.7f, -0.75f, -63.5f}, {6.3f, -0.15f, -62.5f}}, true},
+	};
+
+	for(const auto& s : scenes())
+		for(bool use_simd : {true, false})
+		{
+			OcclusionRasterizer r;
+			r.UseSIMD = use_simd;
+			render(r, s, nullptr);
+			for(const auto& c : cases)
+				if(c.scene == s.name)
+					check(r.isVisible(c.box) == c.visible, s.name + (use_simd ? " (SIMD): " : " (scalar): ") + c.name +
+						" should be " + (c.visible ? "visible" : "occluded"));
+		}
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	const bool update = argc > 1 && std::string(argv[1]) == "--update";
+	ThreadPool pool(4);
+
+	for(const auto& s : scenes())
+		test_depth(s, update, pool);
+	test_visibility();
+
+	if(failures > 0)
+	{
+		std::cerr << failures << " check(s) failed." << std::endl;
+		return 1;
+	}
+	std::cout << "All checks passed." << std::endl;
+	return 0;
+}
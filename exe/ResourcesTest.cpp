@@ -0,0 +1,158 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <Context.hpp>
+#include <GLFW/glfw3.h>
+
+#include <Resources.hpp>
+
+/**
+ * Eviction of the meshes (see Resources::Budget): a referenced mesh is kept, an unreferenced one is evicted
+ * and reloaded from its file by Resources::getMesh(). Meshes own GL objects: a hidden window provides the context,
+ * the test is skipped (exit code 77) if none can be created.
+ * Run from the root of the repository (writes and removes a small OBJ file).
+**/
+
+namespace
+{
+
+constexpr int		Skipped = 77;
+const std::string	MeshPath = "ResourcesTest.obj";
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+	if(!condition)
+	{
+		std::cerr << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+/// Tiny budget: every unreferenced resource not used during the current frame is over it.
+const MemoryUsage Tight{1, 1};
+
+/// Next frame: resources used so far become candidates for the eviction.
+void next_frame()
+{
+	Resources::_meshes.setTime(Resources::_meshes.getTime() + 1);
+	Resources::_textures.setTime(Resources::_textures.getTime() + 1);
+}
+
+void write_mesh()
+{
+	std::ofstream file(MeshPath);
+	file << "o Quad\n"
+		 << "v -1 -1 0\nv 1 -1 0\nv 1 1 0\nv -1 1 0\n"
+		 << "vn 0 0 1\n"
+		 << "f 1//1 2//1 3//1\nf 1//1 3//1 4//1\n";
+}
+
+void test_reload()
+{
+	write_mesh();
+	const auto meshes = Mesh::load(MeshPath);
+	check(meshes.size() == 1, "Loading " + MeshPath);
+	if(meshes.size() != 1)
+		return;
+	meshes[0]->createVAO();
+	const std::string name = meshes[0]->getName();
+	const size_t triangles = meshes[0]->getTriangles().size();
+	const auto handle = Resources::getMeshHandle(name);
+
+	// Referenced: kept
+	Resources::updateMemoryUsage();
+	auto ref = Resources::_meshes.ref(handle);
+	next_frame();
+	Resources::enforceBudget(Tight);
+	check(Resources::isMesh(name), "A referenced mesh shouldn't be evicted");
+
+	// Unreferenced: evicted, then reloaded on lookup
+	ref.reset();
+	next_frame();
+	check(Resources::enforceBudget(Tight) > 0 && !Resources::isMesh(name), "An unreferenced mesh should be evicted");
+	try
+	{
+		const Mesh& reloaded = Resources::getMesh(name);
+		check(reloaded.getName() == name && reloaded.getTriangles().size() == triangles, "Reloaded mesh differs");
+		check(static_cast<bool>(reloaded.getVAO()), "Reloaded mesh should be uploaded");
+	} catch(const std::runtime_error& e) {
+		check(false, std::string("Reloading an evicted mesh: ") + e.what());
+	}
+
+	// Used during the current frame (just reloaded): kept
+	Resources::updateMemoryUsage();
+	Resources::enforceBudget(Tight);
+	check(Resources::isMesh(name), "A mesh used during the current frame shouldn't be evicted");
+
+	std::remove(MeshPath.c_str());
+	std::remove((MeshPath + Mesh::CacheExtension).c_str());
+}
+
+void test_not_reloadable()
+{
+	// Not loaded from a file
+	const auto handle = Resources::getMeshHandle("Procedural");
+	Resources::_meshes.getOrCreate(handle);
+	Resources::_meshes[handle].memory = MemoryUsage{1024, 1024};
+	next_frame();
+	Resources::enforceBudget(Tight);
+	check(!Resources::isMesh("Procedural"), "An unreferenced procedural mesh should be evicted");
+	bool thrown = false;
+	try
+	{
+		Resources::getMesh(handle);
+	} catch(const std::runtime_error&) {
+		thrown = true;
+	}
+	check(thrown, "Looking up an evicted procedural mesh should throw");
+
+	// Never loaded: empty placeholder, filled later by Mesh::finalize()
+	check(Resources::getMesh("Placeholder").getTriangles().empty(), "Unknown meshes should be created empty");
+}
+
+}
+
+int main()
+{
+	if(!glfwInit())
+	{
+		std::cout << "Skipped: couldn't initialize GLFW." << std::endl;
+		return Skipped;
+	}
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(64, 64, "ResourcesTest", nullptr, nullptr);
+	if(!window)
+	{
+		std::cout << "Skipped: no OpenGL context." << std::endl;
+		glfwTerminate();
+		return Skipped;
+	}
+	glfwMakeContextCurrent(window);
+	if(!Context::init())
+	{
+		std::cout << "Skipped: couldn't initialize gl3w." << std::endl;
+		glfwTerminate();
+		return Skipped;
+	}
+
+	test_reload();
+	test_not_reloadable();
+
+	Resources::clearMeshes(); // Before the context is gone
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	if(failures > 0)
+	{
+		std::cerr << failures << " check(s) failed." << std::endl;
+		return 1;
+	}
+	std::cout << "All checks passed." << std::endl;
+	return 0;
+}
@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <deque>
 #include <set>
+#include <random>
 #include <experimental/filesystem>
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -17,11 +18,14 @@
 #include <Query.hpp>
 
 #include <SpotLight.hpp>
+#include <DirectionalLight.hpp>
 #include <DeferredRenderer.hpp>
 
 #include <MathTools.hpp>
 
 #include <Log.hpp>
+#include <AsyncLoader.hpp>
+#include <BindlessTextures.hpp>
 
 #include <Entity.hpp>
 
@@ -72,29 +76,31 @@ std::experimental::filesystem::path explore(const std::experimental::filesystem:
 
 bool loadModel(const std::string& path)
 {
-	EntityID base_entity = create_entity(path).get_id();
-	ComponentID base_transform = get_id(get_entity(base_entity).add<Transformation>());
-
-	auto m = Mesh::load(path);
-	
-	for(auto& part : m)
-	{
-		auto t = part->resetPivot();
-		part->createVAO();
-		part->getMaterial().setUniform("R", 0.95f);
-		part->getMaterial().setUniform("F0", 0.15f);
+	AsyncLoader::loadMeshes(path, [path](const std::vector<Mesh*>& m) {
+		if(m.empty())
+			return;
 		
-		if(m.size() == 1)
+		EntityID base_entity = create_entity(path).get_id();
+		ComponentID base_transform = get_id(get_entity(base_entity).add<Transformation>());
+		
+		for(auto& part : m)
 		{
-			get_entity(base_entity).set_name(part->getName());
-			get_entity(base_entity).add<MeshRenderer>(*part);
-		} else {
-			auto& entity = create_entity(part->getName());
-			auto& ent_transform = entity.add<Transformation>(t);
-			get_component<Transformation>(base_transform).addChild(ent_transform);
-			entity.add<MeshRenderer>(*part);
+			auto t = part->getPivot();
+			part->getMaterial().setUniform("R", 0.95f);
+			part->getMaterial().setUniform("F0", 0.15f);
+			
+			if(m.size() == 1)
+			{
+				get_entity(base_entity).set_name(part->getName());
+				get_entity(base_entity).add<MeshRenderer>(*part);
+			} else {
+				auto& entity = create_entity(part->getName());
+				auto& ent_transform = entity.add<Transformation>(t);
+				get_component<Transformation>(base_transform).addChild(ent_transform);
+				entity.add<MeshRenderer>(*part);
+			}
 		}
-	}
+	});
 	
 	return true;
 }
@@ -114,52 +120,69 @@ bool loadScene(const std::string& path)
 	for_each<deletion_pass_wrapper, ComponentTypes>{}();
 	Resources::clearMeshes();
 	
-	nlohmann::json j;
-	f >> j;
-	
-	for(auto& e : j["models"])
-	{
-		auto m = Mesh::load(e);
-		for(auto& part : m)
-		{
-			part->resetPivot();
-			part->createVAO();
-		}
-	}
-	
-	// TODO: Handle transformation hierarchy!
+	auto j = std::make_shared<nlohmann::json>();
+	f >> *j;
 	
-	std::vector<std::tuple<ComponentID, ComponentID>> transform_relations;
-	for(auto& e : j["entities"])
-	{
-		auto& base_entity = create_entity(e["Name"].is_string() ? e["Name"] : "UnamedEntity");
+	// Models are streamed, entities are created once all of them are ready.
+	static size_t scene_generation = 0;
+	const size_t generation = ++scene_generation;
+	auto create_entities = [j, generation, scene_loading_start]() {
+		if(generation != scene_generation) // Another scene has been loaded since
+			return;
+		// TODO: Handle transformation hierarchy!
 		
-		auto transform = e.find("Transformation");
-		if(transform != e.end())
+		std::vector<std::tuple<ComponentID, ComponentID>> transform_relations;
+		for(auto& e : (*j)["entities"])
 		{
-			ComponentID base_transform = get_id(base_entity.add<Transformation>(*transform));
-			if((*transform).find("parent") != (*transform).end() && (*transform)["parent"] != invalid_component_idx)
-				transform_relations.push_back({(*transform)["parent"], base_transform});
-		
-			auto meshrenderer = e.find("MeshRenderer");
-			if(meshrenderer != e.end())
-				base_entity.add<MeshRenderer>(*meshrenderer);
-				
-			auto spotlight = e.find("SpotLight");
-			if(spotlight != e.end())
-				base_entity.add<SpotLight>(*spotlight);
+			auto& base_entity = create_entity(e["Name"].is_string() ? e["Name"] : "UnamedEntity");
+			
+			auto transform = e.find("Transformation");
+			if(transform != e.end())
+			{
+				ComponentID base_transform = get_id(base_entity.add<Transformation>(*transform));
+				if((*transform).find("parent") != (*transform).end() && (*transform)["parent"] != invalid_component_idx)
+					transform_relations.push_back({(*transform)["parent"], base_transform});
 			
-			auto collisionbox = e.find("CollisionBox");
-			if(collisionbox != e.end())
-				base_entity.add<CollisionBox>(*collisionbox);
+				auto meshrenderer = e.find("MeshRenderer");
+				if(meshrenderer != e.end())
+					base_entity.add<MeshRenderer>(*meshrenderer);
+					
+				auto spotlight = e.find("SpotLight");
+				if(spotlight != e.end())
+					base_entity.add<SpotLight>(*spotlight);
+				
+				auto directionallight = e.find("DirectionalLight");
+				if(directionallight != e.end())
+					base_entity.add<DirectionalLight>(*directionallight);
+				
+				auto collisionbox = e.find("CollisionBox");
+				if(collisionbox != e.end())
+					base_entity.add<CollisionBox>(*collisionbox);
+			}
 		}
-	}
-	
-	for(const auto& r : transform_relations)
-		get_component<Transformation>(std::get<0>(r)).addChild(std::get<1>(r));
+		
+		for(const auto& r : transform_relations)
+			get_component<Transformation>(std::get<0>(r)).addChild(std::get<1>(r));
+		
+		auto scene_loading_end = Clock::now();
+		Log::info("Scene loading done in ", std::chrono::duration_cast<std::chrono::milliseconds>(scene_loading_end - scene_loading_start).count(), "ms.");
+	};
 	
-	auto scene_loading_end = scene_loading_clock.now();
-	Log::info("Scene loading done in ", std::chrono::duration_cast<std::chrono::milliseconds>(scene_loading_end - scene_loading_start).count(), "ms.");
+	auto remaining = std::make_shared<size_t>((*j)["models"].size());
+	if(*remaining == 0)
+		create_entities();
+	// Loaded meshes are referenced until the entities are created, so they can't be evicted in between.
+	auto loaded = std::make_shared<std::vector<Resources::MeshRef>>();
+	for(auto& e : (*j)["models"])
+		AsyncLoader::loadMeshes(e, [remaining, loaded, create_entities](const std::vector<Mesh*>& meshes) {
+			for(auto m : meshes)
+				loaded->push_back(Resources::_meshes.ref(Resources::getMeshHandle(m->getName())));
+			if(--*remaining == 0)
+			{
+				create_entities();
+				loaded->clear();
+			}
+		});
 	
 	return true;
 }
@@ -178,8 +201,9 @@ bool saveScene(const std::string& path)
 	nlohmann::json j;
 	
 	std::set<std::string> temp_mesh_paths;
-	for(const auto& m : Resources::_meshes)
-		temp_mesh_paths.insert(m.second->getPath());
+	Resources::_meshes.for_each([&](const std::string&, const Mesh& m) {
+		temp_mesh_paths.insert(m.getPath());
+	});
 	for(const auto& p : temp_mesh_paths)
 		j["models"].push_back(p);
 	
@@ -195,6 +219,8 @@ bool saveScene(const std::string& path)
 				je["MeshRenderer"] = e.get<MeshRenderer>().json();
 			if(e.has<SpotLight>())
 				je["SpotLight"] = e.get<SpotLight>().json();
+			if(e.has<DirectionalLight>())
+				je["DirectionalLight"] = e.get<DirectionalLight>().json();
 			// TODO: Other Components (...)
 			j["entities"].push_back(je);
 		}
@@ -277,12 +303,6 @@ public:
 				deselectObject();
 			}
 		};
-		
-		for(auto& it : ComponentIterator<SpotLight>{})
-		{
-			it.updateMatrices();
-			it.drawShadowMap(ComponentIterator<MeshRenderer>{});
-		}
 	}
 	
 	virtual void renderGUI() override
@@ -339,7 +359,7 @@ public:
 		ImVec2 win_size = ImGui::GetWindowContentRegionMax();
 		win_size.x -= ImGui::GetWindowContentRegionMin().x;
 		win_size.y -= ImGui::GetWindowContentRegionMin().y;
-		ImGui::Image(reinterpret_cast<ImTextureID>(_postProcessBuffer.getColor(0).getName()), win_size);
+		ImGui::Image(reinterpret_cast<ImTextureID>(_ldrBuffer.getColor(0).getName()), win_size);
 		ImGui::End();
 		*/
 		
@@ -377,14 +397,13 @@ public:
 				if(ImGui::Button("Update shadow maps"))
 				{
 					for(auto& it : ComponentIterator<SpotLight>{})
-					{
-						it.updateMatrices();
-						it.drawShadowMap(ComponentIterator<MeshRenderer>{});
-					}
+						it.invalidateShadowMap();
+					for(auto& it : ComponentIterator<DirectionalLight>{})
+						it.invalidateShadowMap();
 				}
 				ImGui::Separator(); 
 				ImGui::Checkbox("Toggle Debug", &_debug_buffers);
-				const char* debugbuffer_items[] = {"Color","Position", "Normal"};
+				const char* debugbuffer_items[] = {"Color", "Normal", "F0/R"};
 				const Attachment debugbuffer_values[] = {Attachment::Color0, Attachment::Color1, Attachment::Color2};
 				static int debugbuffer_item_current = 0;
 				if(ImGui::Combo("Buffer to Display", &debugbuffer_item_current, debugbuffer_items, 3))
@@ -404,7 +423,15 @@ public:
 			ImGui::Begin("statusbar", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoBringToFrontOnFocus);
 			ImGui::Text("FPS: %f", ImGui::GetIO().Framerate);
 			ImGui::SameLine(125, 0);
-			ImGui::TextColored(LogColors[Log::_logs.front().type], "%s", Log::_logs.front().str().c_str());
+			{
+				std::lock_guard<std::mutex> lock(Log::_log_mutex);
+				ImGui::TextColored(LogColors[Log::_logs.front().type], "%s", Log::_logs.front().str().c_str());
+			}
+			if(AsyncLoader::getPendingCount() > 0)
+			{
+				ImGui::SameLine();
+				ImGui::Text("(Loading %lu resources...)", AsyncLoader::getPendingCount());
+			}
 			ImGui::End();
 			ImGui::PopStyleVar(2);
 		}
@@ -459,7 +486,7 @@ public:
 					Program& blend = Resources::getProgram("Simple");
 					blend.use();
 					blend.setUniform("Color", _selectedObjectColor);
-					blend.setUniform("ModelMatrix", transform.getGlobalMatrix());
+					mr.getMesh().setModelMatrix(blend, transform.getGlobalMatrix());
 					mr.getMesh().draw();
 					
 					blend.setUniform("Color", glm::vec4(1.0, 1.0, 1.0, 0.1));
@@ -717,7 +744,7 @@ protected:
 		   0.5f * (aabb.max + aabb.min),
 		   glm::vec3(0, -1, 0)
 		));
-		GUIModelRender.setUniform("ModelMatrix", glm::rotate(glm::mat4(1.0f), _time, glm::vec3{0, 1, 0}));
+		m.setModelMatrix(GUIModelRender, glm::rotate(glm::mat4(1.0f), _time, glm::vec3{0, 1, 0}));
 		Material mat = m.getMaterial(); // Copy Material... not perfect but will do for now.
 		mat.setShadingProgram(GUIModelRender);
 		
@@ -760,10 +787,10 @@ protected:
 			if(guitimes.size() > max_samples)			guitimes.pop_front();
 			frametimes.push_back(ms);
 			updatetimes.push_back(_updateTiming.get<GLuint64>() / 1000000.0);
-			occlusiontimes.push_back(_OcclusionCullingTiming.get<GLuint64>() / 1000000.0);
-			gbuffertimes.push_back(_GBufferPassTiming.get<GLuint64>() / 1000000.0);
-			lighttimes.push_back(_lightPassTiming.get<GLuint64>() / 1000000.0);
-			postprocesstimes.push_back(_postProcessTiming.get<GLuint64>() / 1000000.0);
+			occlusiontimes.push_back(_lastOcclusionCullingTiming / 1000000.0);
+			gbuffertimes.push_back(_lastGBufferPassTiming / 1000000.0);
+			lighttimes.push_back(_lastLightPassTiming / 1000000.0);
+			postprocesstimes.push_back(_lastPostProcessTiming / 1000000.0);
 			guitimes.push_back(_lastGUITiming / 1000000.0);
 			last_update = 0.0;
 		}
@@ -785,11 +812,38 @@ protected:
 			ImGui::PlotLines("Update", lamba_data, &updatetimes, updatetimes.size(), 0, to_string(updatetimes.back(), 4).c_str(), 0.0, 10.0);    
 			ImGui::PlotLines("Occlusion Culling", lamba_data, &occlusiontimes, occlusiontimes.size(), 0, to_string(occlusiontimes.back(), 4).c_str(), 0.0, 10.0);    
 			ImGui::PlotLines("GBuffer", lamba_data, &gbuffertimes, gbuffertimes.size(), 0, to_string(gbuffertimes.back(), 4).c_str(), 0.0, 10.0);    
+			// Bytes per nanosecond: GB/s
+			ImGui::Text("G-Buffer: %zu bytes/pixel, %.1f MB (%.1f GB/s)", GBufferBytesPerPixel, getGBufferSize() / 1000000.0,
+				_lastGBufferPassTiming > 0 ? static_cast<double>(getGBufferSize()) / _lastGBufferPassTiming : 0.0);
 			ImGui::PlotLines("Lights", lamba_data, &lighttimes, lighttimes.size(), 0, to_string(lighttimes.back(), 4).c_str(), 0.0, 10.0);    
 			ImGui::PlotLines("Post Process",lamba_data, &postprocesstimes, postprocesstimes.size(), 0, to_string(postprocesstimes.back(), 4).c_str(), 0.0, 10.0);    
 			ImGui::PlotLines("GUI", lamba_data, &guitimes, guitimes.size(), 0, to_string(guitimes.back(), 4).c_str(), 0.0, 10.0);
+			ImGui::Text("Render graph: %zu passes (%zu culled), %zu barrier(s), %zu transient(s) in %zu texture(s) (%.1f MB)",
+				_graph.getPassCount(), _graph.getCulledPassCount(), _graph.getBarrierCount(), _graph.getTransientCount(),
+				_graph.getPooledTextureCount(), _graph.getPooledBytes() / 1000000.0);
 
 			ImGui::Text("Scene DrawCalls: %d", _scene_draw_calls);
+			const auto& clusters = _scene.getLightClusters();
+			ImGui::Text("Light clusters: %u * %u * %u, %zu light indices, built in %.2f ms (CPU)", clusters.getCount().x,
+				clusters.getCount().y, clusters.getCount().z, clusters.getLightIndices().size(), clusters.getBuildTime());
+			const auto& atlas = _scene.getShadowAtlas();
+			ImGui::Text("Shadow atlas: %zu * %zu (up to %zu lights), %zu shadow map(s) updated", atlas.getSize(), atlas.getSize(),
+				atlas.getCapacity(), _scene.getShadowMapUpdates());
+			if(ImGui::TreeNode("Shadow maps"))
+			{
+				for(auto& it : ComponentIterator<SpotLight>{})
+					ImGui::Text("Entity %u: %zu * %zu, %.3f ms", static_cast<unsigned int>(get_owner<SpotLight>(it)),
+						it.getShadowTile().size, it.getShadowTile().size, it.getShadowMapTime() / 1000000.0);
+				for(auto& it : ComponentIterator<DirectionalLight>{})
+					ImGui::Text("Entity %u: %zu cascade(s), %.3f ms", static_cast<unsigned int>(get_owner<DirectionalLight>(it)),
+						it.getCascadeCount(), it.getShadowMapTime() / 1000000.0);
+				ImGui::TreePop();
+			}
+			const auto& material_state = _scene.getMaterialState();
+			ImGui::Text("Program changes: %zu, Subroutine uploads: %zu (%zu skipped)", material_state.program_changes,
+				material_state.subroutine_calls, material_state.skipped_subroutine_calls);
+			if(BindlessTextures::isSupported())
+				ImGui::Text("Resident texture handles: %zu", BindlessTextures::getResidentCount());
 		}
 		//ImGui::EndDock();
 		ImGui::End();
@@ -808,6 +862,17 @@ protected:
 			ImGui::Checkbox("Frustum Culling", &_scene.UseFrustumCulling);
 			ImGui::SameLine();
 			ImGui::Checkbox("Occlusion Culling", &_scene.UseOcclusionCulling);
+			if(_scene.UseOcclusionCulling)
+			{
+				ImGui::SameLine();
+				ImGui::Text("(%zu occluded)", _scene.getHiZ().getOccludedCount());
+			}
+			ImGui::Checkbox("Software Occlusion Culling", &_scene.UseSoftwareOcclusionCulling);
+			if(_scene.UseSoftwareOcclusionCulling)
+			{
+				ImGui::SameLine();
+				ImGui::Text("(%zu occluder triangles)", _scene.getOcclusionRasterizer().getTriangleCount());
+			}
 			ImGui::Text("Window resolution: %d * %d", _width, _height);
 			const char* internal_resolution_items[] = {"Windows resolution", "1920 * 1080", "2715 * 1527", "3840 * 2160"};
 			static int internal_resolution_item_current = 0;
@@ -837,6 +902,7 @@ protected:
 			
 			ImGui::Checkbox("Bloom", &_bloom);
 			ImGui::DragFloat("Bloom Strength", &_bloom_strength, 0.05, 0.0, 5.0);
+			ImGui::SliderInt("Bloom Levels", &_bloomLevels, 1, 8);
 			
 			ImGui::Separator();
 			
@@ -845,6 +911,10 @@ protected:
 			ImGui::Separator();
 			
 			ImGui::DragFloat("MinVariance (VSM)", &_minVariance, 0.000001, 0.0, 0.00005);
+			const char* shadow_format_items[] = {"RG16F", "RG32F"};
+			int shadow_format = static_cast<int>(_scene.getShadowAtlas().getFormat());
+			if(ImGui::Combo("Shadow Maps Format", &shadow_format, shadow_format_items, 2))
+				_scene.setShadowMapFormat(static_cast<ShadowAtlas::Format>(shadow_format));
 			
 			ImGui::Separator();
 			
@@ -919,29 +989,39 @@ protected:
 
 				if(selectedEntityPtr->has<MeshRenderer>() && ImGui::TreeNodeEx("MeshRenderer", ImGuiTreeNodeFlags_DefaultOpen))
 				{
-					auto edit_material = [&](Material& mat)
+					// Modifications go through editMaterial (copy-on-write)
+					auto edit_material = [&](MeshRenderer& mr)
 					{
-						if(auto uniform_color = mat.searchUniform<glm::vec3>("Color"))
+						if(auto uniform_color = mr.getMaterial().searchUniform<glm::vec3>("Color"))
 						{
 							float col[3] = {uniform_color->getValue().x, uniform_color->getValue().y, uniform_color->getValue().z};
 							if(ImGui::ColorEdit3("Color", col))
-								uniform_color->setValue(glm::vec3{col[0], col[1], col[2]});
+								mr.editMaterial().setUniform("Color", glm::vec3{col[0], col[1], col[2]});
 						}
-						if(auto uniform_r = mat.searchUniform<float>("R"))
+						if(auto uniform_r = mr.getMaterial().searchUniform<float>("R"))
 						{
 							float val = uniform_r->getValue();
 							if(ImGui::SliderFloat("R", &val, 0.0, 1.0))
-								uniform_r->setValue(val);
+								mr.editMaterial().setUniform("R", val);
 						}
-						if(auto uniform_f0 = mat.searchUniform<float>("F0"))
+						if(auto uniform_f0 = mr.getMaterial().searchUniform<float>("F0"))
 						{
 							float val = uniform_f0->getValue();
 							if(ImGui::SliderFloat("F0", &val, 0.0, 1.0))
-								uniform_f0->setValue(val);
+								mr.editMaterial().setUniform("F0", val);
+						}
+						ImGui::Text("%s material (hash %llx), %zu shared materials.", mr.hasPrivateMaterial() ? "Private" : "Shared",
+							mr.getMaterial().getHash(), Material::getSharedCount());
+						if(mr.hasPrivateMaterial())
+						{
+							ImGui::SameLine();
+							if(ImGui::Button("Share"))
+								mr.shareMaterial();
 						}
+						ImGui::Checkbox("Occluder", &mr.occluder);
 						auto display_texture = [&](const std::string& name) 
 						{
-							if(auto uniform_tex = mat.searchUniform<Texture>(name))
+							if(auto uniform_tex = mr.getMaterial().searchUniform<Texture>(name))
 							{
 								ImGui::Text(name.c_str());
 								gui_display(uniform_tex->getValue());
@@ -959,7 +1039,7 @@ protected:
 					}
 					if(ImGui::TreeNode("Material"))
 					{
-						edit_material(mr.getMaterial());
+						edit_material(mr);
 						ImGui::TreePop();
 					}
 					ImGui::TreePop();
@@ -993,8 +1073,14 @@ protected:
 						if(ImGui::Combo("Resolution", &resolution_item_current, resolution_items, 6))
 							sl.setResolution(pow(2, resolution_item_current + 7));
 							
-						ImGui::Text("Depth Buffer");
-						gui_display(sl.getShadowMap());
+						const auto& tile = sl.getShadowTile();
+						ImGui::Text("Shadow map: %zu * %zu at (%u, %u) in the atlas", tile.size, tile.size, tile.offset.x, tile.offset.y);
+						if(tile.size > 0)
+						{
+							const glm::vec4 rect = _scene.getShadowAtlas().getRect(tile);
+							ImGui::Image(reinterpret_cast<void*>(_scene.getShadowAtlas().getTexture().getName()), ImVec2{256, 256},
+								ImVec2{rect.x, rect.y}, ImVec2{rect.x + rect.z, rect.y + rect.w});
+						}
 						
 						ImGui::TreePop();
 					}
@@ -1004,10 +1090,53 @@ protected:
 						if(!selectedEntityPtr->has<Transformation>())
 							selectedEntityPtr->add<Transformation>();
 						auto& spotlight = selectedEntityPtr->add<SpotLight>();
-						spotlight.init();
 						spotlight.dynamic = true;
 						spotlight.updateMatrices();
-						spotlight.drawShadowMap(ComponentIterator<MeshRenderer>{});
+					}
+				}
+				
+				if(selectedEntityPtr->has<DirectionalLight>())
+				{
+					if(ImGui::TreeNodeEx("DirectionalLight", ImGuiTreeNodeFlags_DefaultOpen))
+					{
+						auto& dl = selectedEntityPtr->get<DirectionalLight>();
+						
+						ImGui::Checkbox("Dynamic", &dl.dynamic);
+						float col[3] = {dl.getColor().x, dl.getColor().y, dl.getColor().z};
+						if(ImGui::ColorEdit3("Color", col))
+							dl.setColor(glm::vec3{col[0], col[1], col[2]});
+						
+						int cascades = dl.getCascadeCount();
+						if(ImGui::SliderInt("Cascades", &cascades, 1, DirectionalLight::MaxCascades))
+							dl.cascadeCount = cascades;
+						ImGui::SliderFloat("Split Lambda", &dl.splitLambda, 0.0, 1.0);
+						ImGui::SliderFloat("Shadow Distance (0: Far)", &dl.shadowDistance, 0.0, 1000.0);
+						
+						const char* resolution_items[] = {"128", "256", "512", "1024", "2048"};
+						int resolution_item_current = log2(dl.resolution) - 7;
+						if(ImGui::Combo("Resolution", &resolution_item_current, resolution_items, 5))
+							dl.resolution = pow(2, resolution_item_current + 7);
+						
+						for(size_t i = 0; i < dl.getCascadeCount(); ++i)
+						{
+							const auto& cascade = dl.getCascade(i);
+							ImGui::Text("Cascade %zu: up to %.1f, %zu * %zu", i, cascade.split, cascade.tile.size, cascade.tile.size);
+							if(cascade.tile.size > 0)
+							{
+								const glm::vec4 rect = _scene.getShadowAtlas().getRect(cascade.tile);
+								ImGui::Image(reinterpret_cast<void*>(_scene.getShadowAtlas().getTexture().getName()), ImVec2{128, 128},
+									ImVec2{rect.x, rect.y}, ImVec2{rect.x + rect.z, rect.y + rect.w});
+							}
+						}
+						
+						ImGui::TreePop();
+					}
+				} else {
+					if(ImGui::Button("Add DirectionalLight component"))
+					{
+						if(!selectedEntityPtr->has<Transformation>())
+							selectedEntityPtr->add<Transformation>();
+						selectedEntityPtr->add<DirectionalLight>();
 					}
 				}
 				
@@ -1093,10 +1222,14 @@ protected:
 				ImGui::TreePop();
 			}
 			
-			if(ImGui::TreeNode(("Point Lights (" + std::to_string(_scene.getPointLights().size()) + ")").c_str()))
+			if(ImGui::TreeNode(("Point Lights (" + std::to_string(_scene.getPointLightCount()) + ")").c_str()))
 			{
-				for(auto& l : _scene.getPointLights())
+				const size_t max_listed = 64;
+				if(_scene.getPointLightCount() > max_listed)
+					ImGui::Text("Only the first %zu are listed.", max_listed);
+				for(size_t i = 0; i < std::min(max_listed, _scene.getPointLightCount()); ++i)
 				{
+					auto& l = _scene.getPointLights()[i];
 					ImGui::PushID(&l);
 					ImGui::InputFloat3("Position", &l.position.x);
 					ImGui::InputFloat3("Color", &l.color.r);
@@ -1112,59 +1245,104 @@ protected:
 				ImGui::InputFloat("Range", &l.range);
 				if(ImGui::Button("Add PointLight"))
 					_scene.getPointLights().push_back(l);
+				
+				// Stress test of the light clusters
+				ImGui::Separator();
+				static int random_count = 10000;
+				static float random_extent = 200.0f;
+				ImGui::InputInt("Count", &random_count);
+				ImGui::InputFloat("Extent", &random_extent);
+				if(ImGui::Button("Add random PointLights"))
+				{
+					static std::mt19937 gen;
+					std::uniform_real_distribution<float> pos(-random_extent, random_extent);
+					std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+					auto& lights = _scene.getPointLights();
+					for(int i = 0; i < random_count; ++i)
+						lights.emplace_back(_camera.getPosition() + glm::vec3{pos(gen), 0.1f * pos(gen), pos(gen)},
+											1.0f + 9.0f * unit(gen), glm::vec3{unit(gen), unit(gen), unit(gen)});
+				}
+				ImGui::SameLine();
+				if(ImGui::Button("Clear"))
+					_scene.getPointLights().clear();
 			}
 			
 			if(ImGui::TreeNode("Resources"))
 			{
+				auto to_kib = [](size_t bytes) { return bytes / 1024.0f; };
+				auto to_mib = [](size_t bytes) { return bytes / (1024.0f * 1024.0f); };
+				const auto mesh_usage = Resources::getMemoryUsage(Resources::_meshes);
+				const auto texture_usage = Resources::getMemoryUsage(Resources::_textures);
+				ImGui::Text("Meshes: %.1f MiB (CPU), %.1f MiB (GPU)", to_mib(mesh_usage.cpu), to_mib(mesh_usage.gpu));
+				ImGui::Text("Textures: %.1f MiB (GPU)", to_mib(texture_usage.gpu));
+				const char* vertex_format_items[] = {"Float (32 bytes)", "Packed (20 bytes)", "Quantized (16 bytes)"};
+				int vertex_format = static_cast<int>(Mesh::LoadedVertexFormat);
+				if(ImGui::Combo("Vertex Format (next loads)", &vertex_format, vertex_format_items, 3))
+					Mesh::LoadedVertexFormat = static_cast<Mesh::VertexFormat>(vertex_format);
+				int budget[2] = {static_cast<int>(Resources::Budget.cpu / (1024 * 1024)), static_cast<int>(Resources::Budget.gpu / (1024 * 1024))};
+				if(ImGui::InputInt2("Budget (MiB, CPU/GPU)", budget))
+				{
+					Resources::Budget.cpu = static_cast<size_t>(std::max(0, budget[0])) * 1024 * 1024;
+					Resources::Budget.gpu = static_cast<size_t>(std::max(0, budget[1])) * 1024 * 1024;
+				}
+				if(ImGui::SmallButton("Enforce Budget"))
+				{
+					Resources::updateMemoryUsage();
+					Resources::enforceBudget(Resources::Budget);
+				}
+				
 				if(ImGui::TreeNode("Textures"))
 				{
-					for(auto& p : Resources::_textures)
-						if(ImGui::TreeNode(p.first.c_str()))
+					for(const auto& e : Resources::_textures)
+						if(ImGui::TreeNode(e.name.c_str(), "%s [%s, %u ref(s), %.1f KiB]", e.name.c_str(),
+								e.resource ? "Resident" : "Evicted", e.refcount, to_kib(e.memory.gpu)))
 						{
-							gui_display(*p.second);
+							if(e.resource)
+								gui_display(*e.resource);
 							ImGui::TreePop();
 						}
 					ImGui::TreePop();
 				}
 				if(ImGui::TreeNode("Shaders"))
 				{
-					for(auto& p : Resources::_shaders)
-					{
-						if(ImGui::TreeNode(p.first.c_str()))
+					ImGui::Checkbox("Reload modified shaders", &Resources::WatchShaders);
+					std::string to_reload;
+					Resources::_shaders.for_each([&](const std::string& name, Shader& s) {
+						if(ImGui::TreeNode(name.c_str()))
 						{
-							ImGui::PushID(&p);
-							ImGui::Text("Path: %s", p.second->getPath().c_str());
-							ImGui::Text(p.second->isValid() ? "Valid" : "Invalid!");
+							ImGui::PushID(&s);
+							ImGui::Text("Path: %s", s.getPath().c_str());
+							ImGui::Text(s.isValid() ? "Valid" : "Not compiled (loaded from the program cache) or invalid");
 							ImGui::SameLine();
 							if(ImGui::SmallButton("Reload"))
-							{
-								Log::info("Reloading ", p.first, "...");
-								p.second->reload();
-								Log::info(p.first, " reloaded.");
-							}
+								to_reload = name;
 							ImGui::PopID();
 							ImGui::TreePop();
 						}
-					}
+					});
+					// Reloading replaces the shader: not done while iterating.
+					if(!to_reload.empty())
+						Resources::reloadShader(Resources::getShaderHandle(to_reload));
 					ImGui::TreePop();
 				}
 				if(ImGui::TreeNode("Programs"))
 				{
-					for(auto& p : Resources::_programs)
-					{
-						if(p.second.isValid())
-							ImGui::Text("%s: Valid", p.first.c_str());
+					Resources::_programs.for_each([&](const std::string& name, Program& p) {
+						if(p.isValid())
+							ImGui::Text("%s: Valid", name.c_str());
 						else
-							ImGui::Text("%s: Invalid!", p.first.c_str());
-					}
+							ImGui::Text("%s: Invalid!", name.c_str());
+					});
 					ImGui::TreePop();
 				}
 				if(ImGui::TreeNode("Meshs"))
 				{
-					for(auto& p : Resources::_meshes)
-						if(ImGui::TreeNode(p.first.c_str()))
+					for(const auto& e : Resources::_meshes)
+						if(ImGui::TreeNode(e.name.c_str(), "%s [%s, %u ref(s), %.1f KiB (CPU), %.1f KiB (GPU)]", e.name.c_str(),
+								e.resource ? "Resident" : "Evicted", e.refcount, to_kib(e.memory.cpu), to_kib(e.memory.gpu)))
 						{
-							gui_display(*p.second);
+							if(e.resource)
+								gui_display(*e.resource);
 							ImGui::TreePop();
 						}
 					ImGui::TreePop();
@@ -1183,6 +1361,7 @@ protected:
 		{
 			static int log_level_current = 0;
 			ImGui::Combo("Log Level", &log_level_current, Log::_log_types.data(), 3);
+			std::lock_guard<std::mutex> lock(Log::_log_mutex);
 			std::vector<Log::LogLine*> tmp_logs;
 			if(log_level_current > 0)
 				for(auto& l : Log::_logs)
@@ -1211,4 +1390,8 @@ int main(int argc, char* argv[])
 	Editor _app(argc, argv);
 	_app.init();	
 	_app.run();
+	
+	// Releases the references to Resources held by the components while Resources still exist.
+	clear_entities();
+	for_each<deletion_pass_wrapper, ComponentTypes>{}();
 }
@@ -12,6 +12,9 @@
 #include <imgui_impl_opengl3.h>
 
 #include <stdext.hpp>
+#include <AsyncLoader.hpp>
+#include <ProgramCache.hpp>
+#include <Clock.hpp>
 
 Application* Application::s_instance = nullptr;
 
@@ -291,7 +294,7 @@ void Application::update()
 	_camera.updateGPUBuffer();
 
 	if(!_paused || _time == 0.0f)
-		_scene.update();
+		_scene.update(_camera);
 }
 
 void Application::renderGUI()
@@ -309,7 +312,11 @@ void Application::renderGUI()
 
 void Application::run()
 {
+	const auto init_start = Clock::now();
 	run_init();
+	const auto& programs = ProgramCache::getStatistics();
+	Log::info("Initialization done in ", std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - init_start).count(), "ms (",
+		programs.hits, " program(s) loaded from cache and ", programs.misses, " compiled, in ", static_cast<int>(programs.time), "ms).");
 	
 	resize_callback(_window, _width, _height);
 	
@@ -333,6 +340,8 @@ void Application::run()
         ImGui::NewFrame();
 	
 		update();
+		AsyncLoader::update(_streamingBudget);
+		Resources::update();
 		
 		render();
 		
@@ -118,6 +118,7 @@ protected:
 	float	_frameTime;
 	float	_frameRate;
 	bool	_paused = false;
+	float	_streamingBudget = 4.0f; ///< Time (ms) the main thread can spend each frame on streamed resources (see AsyncLoader)
 
 	// Callbacks (GLFW)
 	virtual void error_callback(int error, const char* description);
@@ -0,0 +1,146 @@
+#include <AsyncLoader.hpp>
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <array>
+
+#include <Clock.hpp>
+#include <ThreadPool.hpp>
+#include <Resources.hpp>
+#include <BindlessTextures.hpp>
+
+namespace AsyncLoader
+{
+
+namespace
+{
+
+std::mutex							_main_queue_mutex;
+std::deque<std::function<void()>>	_main_queue;
+std::atomic<size_t>					_pending{0};
+
+std::array<unsigned char, 4> placeholder_texel(TexturePipeline::Usage usage)
+{
+	return usage == TexturePipeline::Usage::Normal ?
+		std::array<unsigned char, 4>{128, 128, 255, 255} :
+		std::array<unsigned char, 4>{255, 255, 255, 255};
+}
+
+/**
+ * Used instead of the streamed textures by bindless materials: a texture can't be
+ * specified once it has a handle (see BindlessTextures).
+**/
+const Texture2D& placeholder(TexturePipeline::Usage usage)
+{
+	static Texture2D color;
+	static Texture2D normal;
+	auto& t = usage == TexturePipeline::Usage::Normal ? normal : color;
+	if(!t.isValid())
+	{
+		const auto texel = placeholder_texel(usage);
+		t.create(texel.data(), 1, 1, GL_RGBA8, GL_RGBA, false);
+	}
+	return t;
+}
+
+}
+
+void loadMeshes(const std::string& path, const Program& p, const MeshCallback& callback)
+{
+	++_pending;
+	const Program* program = &p;
+	ThreadPool::get().submit([path, program, callback]() {
+		// shared_ptr: std::function has to be copyable. The Import is released on the main thread.
+		std::shared_ptr<Mesh::Import> import{Mesh::import(path)};
+		runOnMainThread([path, program, callback, import]() {
+			--_pending;
+			if(!import)
+			{
+				if(callback) callback({});
+				return;
+			}
+			
+			auto meshes = std::make_shared<std::vector<Mesh*>>(Mesh::finalize(*import, *program));
+			// Meshes are referenced until the callback so they can't be evicted in between.
+			auto refs = std::make_shared<std::vector<Resources::MeshRef>>();
+			// One upload per task to spread them over several frames.
+			for(auto m : *meshes)
+			{
+				refs->push_back(Resources::_meshes.ref(Resources::getMeshHandle(m->getName())));
+				runOnMainThread([ref = refs->back()]() {
+					ref->createVAO();
+				});
+			}
+			if(callback)
+				runOnMainThread([meshes, refs, callback]() { callback(*meshes); });
+		});
+	});
+}
+
+void loadMeshes(const std::string& path, const MeshCallback& callback)
+{
+	loadMeshes(path, Resources::getProgram("Default"), callback);
+}
+
+Texture2D& loadTexture(const std::string& path, TexturePipeline::Usage usage)
+{
+	auto& t = Resources::getTexture<Texture2D>(path);
+	if(t.isValid()) // Already loaded or loading
+		return t;
+	
+	const auto texel = placeholder_texel(usage);
+	t.create(texel.data(), 1, 1, GL_RGBA8, GL_RGBA, false);
+	if(BindlessTextures::isSupported())
+		BindlessTextures::defer(t, placeholder(usage));
+	
+	const bool compression = TexturePipeline::CompressionEnabled && TexturePipeline::isSupported(
+		usage == TexturePipeline::Usage::Normal ? TexturePipeline::Compression::BC5 : TexturePipeline::Compression::BC3);
+	++_pending;
+	ThreadPool::get().submit([path, usage, compression]() {
+		std::shared_ptr<TexturePipeline::MipChain> chain{TexturePipeline::load(path, usage, compression)};
+		runOnMainThread([path, chain]() {
+			--_pending;
+			auto handle = Resources::getTextureHandle(path);
+			if(!Resources::_textures.contains(handle)) // May have been evicted in the meantime
+				return;
+			auto& t = Resources::getTexture<Texture2D>(handle);
+			if(chain)
+				TexturePipeline::upload(t, *chain);
+			BindlessTextures::ready(t);
+		});
+	});
+	return t;
+}
+
+void runOnMainThread(std::function<void()> task)
+{
+	std::lock_guard<std::mutex> lock(_main_queue_mutex);
+	_main_queue.push_back(std::move(task));
+}
+
+void update(float budget)
+{
+	const auto start = Clock::now();
+	do
+	{
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock(_main_queue_mutex);
+			if(_main_queue.empty())
+				return;
+			task = std::move(_main_queue.front());
+			_main_queue.pop_front();
+		}
+		task();
+	} while(std::chrono::duration<float, std::milli>(Clock::now() - start).count() < budget);
+}
+
+size_t getPendingCount()
+{
+	std::lock_guard<std::mutex> lock(_main_queue_mutex);
+	return _pending + _main_queue.size();
+}
+
+}
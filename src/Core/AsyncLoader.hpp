@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <Texture2D.hpp>
+#include <TexturePipeline.hpp>
+
+class Mesh;
+class Program;
+
+/**
+ * Streams resources without blocking the main loop:
+ * file I/O and decoding run on the ThreadPool, and the GL work
+ * (uploads, Resources registration) is queued for the main thread,
+ * which drains it under a time budget every frame (see update()).
+**/
+namespace AsyncLoader
+{
+
+/// Called on the main thread once all the meshes of a file are registered and uploaded (empty on failure).
+using MeshCallback = std::function<void(const std::vector<Mesh*>&)>;
+
+/**
+ * Loads the meshes of a file in the background (see Mesh::import and Mesh::finalize).
+ * @param p Shading program of the meshes' materials
+**/
+void loadMeshes(const std::string& path, const Program& p, const MeshCallback& callback = {});
+/// Uses the "Default" program.
+void loadMeshes(const std::string& path, const MeshCallback& callback = {});
+
+/**
+ * Loads a texture through the TexturePipeline (mip chain built by the workers, optionally compressed, cached on disk).
+ * Main thread only.
+ * @param usage Also selects the single texel placeholder used until the texture is uploaded (white or flat normal).
+ * @return Texture registered as path to Resources, immediately usable.
+**/
+Texture2D& loadTexture(const std::string& path, TexturePipeline::Usage usage = TexturePipeline::Usage::Color);
+
+/**
+ * Queues a task for the main thread (thread safe).
+**/
+void runOnMainThread(std::function<void()> task);
+
+/**
+ * Runs queued main thread tasks until the queue is empty or budget is exhausted
+ * (at least one task is run each call).
+ * @param budget Time budget in milliseconds.
+**/
+void update(float budget);
+
+/// @return Number of resources currently loading
+size_t getPendingCount();
+
+}
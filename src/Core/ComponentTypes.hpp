@@ -3,6 +3,7 @@
 #include <Meta.hpp>
 
 #include <SpotLight.hpp>
+#include <DirectionalLight.hpp>
 #include <CollisionBox.hpp>
 
-using ComponentTypes = TList<Transformation, MeshRenderer, SpotLight, CollisionBox>;
+using ComponentTypes = TList<Transformation, MeshRenderer, SpotLight, DirectionalLight, CollisionBox>;
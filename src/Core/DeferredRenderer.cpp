@@ -1,9 +1,27 @@
 #include <DeferredRenderer.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 #include <stb_image_write.hpp>
 
 #include <Component.hpp>
 #include <SpotLight.hpp>
+#include <DirectionalLight.hpp>
+
+namespace
+{
+
+void init_target(Texture2D& t, size_t width, size_t height, GLenum internalFormat, GLenum format, Texture::PixelType type)
+{
+	t.setPixelType(type);
+	t.create(nullptr, width, height, internalFormat, format, false);
+	t.set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
+	t.set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
+}
+
+}
 
 DeferredRenderer::DeferredRenderer(int argc, char* argv[]) :
 	Application(argc, argv)
@@ -18,7 +36,7 @@ void DeferredRenderer::init(const std::string& windowName)
 	
 void DeferredRenderer::screen(const std::string& path) const
 {
-	_offscreenRender.bind(FramebufferTarget::Read);
+	_ldrBuffer.bind(FramebufferTarget::Read);
 	GLubyte* pixels = new GLubyte[4 * getInternalWidth() * getInternalHeight()];
 	glReadPixels(0, 0, getInternalWidth(), getInternalHeight(), GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 	stbi_write_png(path.c_str(), getInternalWidth(), getInternalHeight(), 4, pixels, 0);
@@ -28,17 +46,6 @@ void DeferredRenderer::screen(const std::string& path) const
 void DeferredRenderer::update()
 {
 	updateGPUTimings();
-	
-	// Occlusion Culling needs to use last frame camera position
-	// ... or not, doesn't solves the flickering
-	_OcclusionCullingTiming.begin(Query::Target::TimeElapsed);
-	if(_scene.UseOcclusionCulling)
-	{
-		_offscreenRender.bind();
-		_scene.occlusion_query( );
-		//glFinish();
-	}
-	_OcclusionCullingTiming.end();
 		
 	Application::update();
 }
@@ -52,17 +59,16 @@ void DeferredRenderer::run_init()
 		"DeferredShadowCS",
 		"src/GLSL/Deferred/tiled_deferred_shadow_cs.glsl"
 	);
-	DeferredShadowCS.getProgram().bindUniformBlock("LightBlock", _scene.getPointLightBuffer());
 		
 	Resources::loadProgram("FXAA",
 		load<VertexShader>("src/GLSL/fullscreen_vs.glsl"),
 		load<FragmentShader>("src/GLSL/fxaa_fs.glsl")
 	);
 	
-	Resources::loadProgram("BloomBlend",
-		load<VertexShader>("src/GLSL/fullscreen_vs.glsl"),
-		load<FragmentShader>("src/GLSL/bloom_blend_fs.glsl")
-	);
+	// Post process chain (see buildRenderGraph)
+	load<ComputeShader>("BloomDownsample", "src/GLSL/bloom_downsample_cs.glsl");
+	load<ComputeShader>("BloomUpsample", "src/GLSL/bloom_upsample_cs.glsl");
+	load<ComputeShader>("PostComposite", "src/GLSL/post_composite_cs.glsl");
 	
 	auto& Deferred = Resources::loadProgram("Default",
 		load<VertexShader>("src/GLSL/Deferred/deferred_vs.glsl"),
@@ -71,11 +77,9 @@ void DeferredRenderer::run_init()
 	
 	Deferred.bindUniformBlock("Camera", _camera.getGPUBuffer()); 
 	
-	auto& aabb = Resources::loadProgram("AABB",
-		Resources::load<VertexShader>("src/GLSL/vs.glsl"),
-		Resources::load<FragmentShader>("src/GLSL/fs.glsl")
-	);
-	aabb.bindUniformBlock("Camera", _camera.getGPUBuffer());
+	// Occlusion Culling (see HiZ)
+	load<ComputeShader>("HiZBuild", "src/GLSL/hiz_cs.glsl");
+	load<ComputeShader>("HiZCull", "src/GLSL/hiz_cull_cs.glsl");
 }
 
 void DeferredRenderer::renderGBuffer()
@@ -91,155 +95,223 @@ void DeferredRenderer::renderGBuffer()
 	_offscreenRender.unbind();
 }
 
-void DeferredRenderer::renderLightPass()
+void DeferredRenderer::renderLightPass(const Texture2D& lit, const Texture2D* bloom)
 {
 	// Light pass (Compute Shader)
 	Context::viewport(0, 0, _width, _height);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	Context::clear(BufferBit::All);
 	
-	_offscreenRender.getColor(0).bindImage(0, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-	_offscreenRender.getColor(1).bindImage(1, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-	_offscreenRender.getColor(2).bindImage(2, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	_offscreenRender.getColor(0).bindImage(0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+	_offscreenRender.getColor(1).bindImage(1, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG16F);
+	_offscreenRender.getColor(2).bindImage(2, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG8);
+	lit.bindImage(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	if(bloom)
+		bloom->bindImage(4, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	_offscreenRender.getDepth().bind(0);
 	
-	size_t lc = 0;
-	for(auto& it : ComponentIterator<SpotLight>{})
-		it.getShadowMap().bind(lc++ + 3);
+	_scene.updateLightClusters(_camera, getInternalWidth(), getInternalHeight());
 	
-	ComputeShader& DeferredShadowCS = Resources::getShader<ComputeShader>("DeferredShadowCS");
-	DeferredShadowCS.getProgram().setUniform("ColorMaterial", (int) 0);
-	DeferredShadowCS.getProgram().setUniform("PositionDepth", (int) 1);
-	DeferredShadowCS.getProgram().setUniform("Normal", (int) 2);	
+	_scene.getShadowAtlas().getTexture().bind(3);
+	_scene.getSpotLightBuffer().bind(Scene::SpotLightsBinding);
+	_scene.getDirectionalLightBuffer().bind(Scene::DirectionalLightsBinding);
 	
-	/// @todo Move this to getLights, or something like that ?
-	for(size_t i = 0; i < impl::components<SpotLight>.count(); ++i)
-		DeferredShadowCS.getProgram().setUniform(std::string("ShadowMaps[").append(std::to_string(i)).append("]"), (int) i + 3);
-	/// @todo No more omnidirectional lights. Add them again? Or maybe its better not to?
-	DeferredShadowCS.getProgram().setUniform("ShadowCount", impl::components<SpotLight>.count());
-	DeferredShadowCS.getProgram().setUniform("CubeShadowCount", 0);
-	DeferredShadowCS.getProgram().setUniform("LightCount", _scene.getPointLights().size());
+	// Samplers (Depth, ShadowAtlas) use the bindings of their declarations.
+	static const auto DeferredShadowCSHandle = Resources::getShaderHandle("DeferredShadowCS");
+	ComputeShader& DeferredShadowCS = Resources::getShader<ComputeShader>(DeferredShadowCSHandle);
 	
-	DeferredShadowCS.getProgram().setUniform("CameraPosition", _camera.getPosition());
-	DeferredShadowCS.getProgram().setUniform("Exposure", _exposure);
-	DeferredShadowCS.getProgram().setUniform("Bloom", _bloom_strength);
-	DeferredShadowCS.getProgram().setUniform("Ambiant", _ambiant);
-	DeferredShadowCS.getProgram().setUniform("MinVariance", _minVariance);
-	DeferredShadowCS.getProgram().setUniform("AOSamples", _aoSamples);
-	DeferredShadowCS.getProgram().setUniform("AOThreshold", _aoThreshold);
-	DeferredShadowCS.getProgram().setUniform("AORadius", _aoRadius);
-	DeferredShadowCS.getProgram().setUniform("AORadius", _aoRadius);
-	DeferredShadowCS.getProgram().setUniform("VolumeSamples", _volumeSamples);
-	DeferredShadowCS.getProgram().setUniform("AtmosphericDensity", _atmosphericDensity);
+	static_assert(sizeof(LightPassParameters) == 224, "LightPassParameters has to match the std140 layout of LightPassBlock.");
+	// See the 2.5D culling of tiled_deferred_shadow_cs.glsl
+	static_assert(LightClusters::TileSize % 16 == 0, "A workgroup of the light pass (WORKGROUP_SIZE) has to lie in a single cluster tile.");
+	static_assert(LightClusters::DepthSlices <= 32, "Slices of a workgroup are stored as the bits of an uint.");
+	const auto& clusters = _scene.getLightClusters();
+	const LightPassParameters parameters{
+		_camera.getInvViewProjection(),
+		_camera.getInvProjection(),
+		_camera.getPosition(),
+		static_cast<GLuint>(impl::components<DirectionalLight>.count()),
+		_ambiant,
+		bloom ? _bloom_strength : 0.0f,
+		_minVariance,
+		_atmosphericDensity,
+		_aoThreshold,
+		_aoRadius,
+		clusters.getNear(),
+		clusters.getFar(),
+		_aoSamples,
+		_volumeSamples,
+		static_cast<GLuint>(impl::components<SpotLight>.count()),
+		0, /// @todo No more omnidirectional lights. Add them again? Or maybe its better not to?
+		glm::uvec4{clusters.getCount(), LightClusters::TileSize},
+		{0, 0}
+	};
+	if(!_lightPassBufferValid || std::memcmp(&parameters, &_lightPassParameters, sizeof(LightPassParameters)) != 0)
+	{
+		_lightPassParameters = parameters;
+		if(!_lightPassBufferValid)
+		{
+			_lightPassBuffer.init();
+			_lightPassBuffer.data(&_lightPassParameters, sizeof(LightPassParameters), Buffer::Usage::DynamicDraw);
+			_lightPassBufferValid = true;
+		} else {
+			_lightPassBuffer.subData(0, sizeof(LightPassParameters), &_lightPassParameters);
+		}
+	}
+	_lightPassBuffer.bind(LightPassBinding);
 
-	DeferredShadowCS.compute(getInternalWidth() / DeferredShadowCS.getWorkgroupSize().x + 1, 
-							getInternalHeight() / DeferredShadowCS.getWorkgroupSize().y + 1, 1);
-	DeferredShadowCS.memoryBarrier();
+	const glm::ivec3 size = Resources::getWorkgroupSize(DeferredShadowCS);
+	DeferredShadowCS.compute(Resources::groupCount(getInternalWidth(), size.x), Resources::groupCount(getInternalHeight(), size.y), 1);
 }
 
-void DeferredRenderer::renderPostProcess()
+void DeferredRenderer::renderBloom(const Texture2D& bloom, int levels)
 {
-	Framebuffer<>::unbind(FramebufferTarget::Draw);
-	Program::useNone();
+	static const auto BloomDownsampleHandle = Resources::getShaderHandle("BloomDownsample");
+	ComputeShader& BloomDownsample = Resources::getShader<ComputeShader>(BloomDownsampleHandle);
+	static const auto BloomUpsampleHandle = Resources::getShaderHandle("BloomUpsample");
+	ComputeShader& BloomUpsample = Resources::getShader<ComputeShader>(BloomUpsampleHandle);
 	
-	if(_debug_buffers) // Blit offscreen buffers.
+	auto groups = [&](int level, size_t res) {
+		return static_cast<GLuint>((std::max<size_t>(1, res >> level) + 15) / 16); // See WORKGROUP_SIZE
+	};
+	// Between the steps only, the RenderGraph synchronizes the result with the next pass.
+	const GLbitfield barrier = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+	
+	// Each level only reads the previous one: a few taps per texel, at decreasing resolutions.
+	bloom.bind(0);
+	for(int level = 0; level < levels; ++level)
 	{
-		_offscreenRender.bind(FramebufferTarget::Read, _framebufferToBlit);
-		glBlitFramebuffer(0, 0, getInternalWidth(), getInternalHeight(), 
-							0, 0, _width, _height, 
-							GL_COLOR_BUFFER_BIT, GL_LINEAR);
-		return;
+		if(level > 0)
+			ComputeShader::memoryBarrier(barrier);
+		bloom.bindImage(0, level + 1, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		BloomDownsample.getProgram().setUniform("Level", level);
+		BloomDownsample.compute(groups(level + 1, getInternalWidth()), groups(level + 1, getInternalHeight()), 1);
 	}
+	// Accumulates the levels back up to the level 1, the last step is done by the composition.
+	for(int level = levels - 1; level >= 1; --level)
+	{
+		ComputeShader::memoryBarrier(barrier);
+		bloom.bindImage(0, level, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+		BloomUpsample.getProgram().setUniform("Level", level);
+		BloomUpsample.compute(groups(level, getInternalWidth()), groups(level, getInternalHeight()), 1);
+	}
+}
+
+void DeferredRenderer::renderComposite(const Texture2D& color, const Texture2D* bloom, int bloomLevels)
+{
+	// Bloom blend, tone mapping and luma for the FXAA in a single pass
+	static const auto PostCompositeHandle = Resources::getShaderHandle("PostComposite");
+	ComputeShader& PostComposite = Resources::getShader<ComputeShader>(PostCompositeHandle);
+	color.bind(0);
+	if(bloom)
+		bloom->bind(1);
+	_ldrBuffer.getColor(0).bindImage(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	PostComposite.getProgram().setUniform("Exposure", _exposure);
+	PostComposite.getProgram().setUniform("BloomLevel", bloom ? 1 : 0);
+	PostComposite.getProgram().setUniform("BloomIntensity", bloom ? 1.0f / bloomLevels : 0.0f);
+	PostComposite.compute((getInternalWidth() + 15) / 16, (getInternalHeight() + 15) / 16, 1); // See WORKGROUP_SIZE
+}
+
+void DeferredRenderer::renderPresent()
+{
+	// FXAA, implementation from https://github.com/McNopper/OpenGL/blob/master/Example42/shader/fxaa.frag.glsl
+	// Directly to the screen (also scales the internal resolution to the window).
+	Framebuffer<>::unbind(FramebufferTarget::Draw);
+	Context::viewport(0, 0, _width, _height);
+	_ldrBuffer.getColor(0).bind(0);
+	static const auto FXAAHandle = Resources::getProgramHandle("FXAA");
+	Program& FXAA = Resources::getProgram(FXAAHandle);
+	FXAA.use();
+	FXAA.setUniform("u_texelStep", glm::vec2(1.0f / getInternalWidth(), 1.0f / getInternalHeight()));
+	FXAA.setUniform("u_showEdges", _fxaa_showEdges ? 1 : 0);
+	FXAA.setUniform("u_fxaaOn", _fxaa ? 1 : 0);
+	FXAA.setUniform("u_lumaThreshold", _fxaa_lumaThreshold);
+	FXAA.setUniform("u_mulReduce", 1.0f / _fxaa_mulReduce);
+	FXAA.setUniform("u_minReduce", 1.0f / _fxaa_minReduce);
+	FXAA.setUniform("u_maxSpan", _fxaa_maxSpan);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4); // Dummy draw call
+	FXAA.useNone();
+}
+
+void DeferredRenderer::buildRenderGraph()
+{
+	using Access = RenderGraph::Access;
+	_graph.reset();
 	
-	bool write_to_post_buffer = true;
-	_postProcessBuffer.clear();
+	// Persistent: G-Buffer (also used by the occlusion culling and the debug view) and final image
+	const auto color_material = _graph.import("ColorMaterial", _offscreenRender.getColor(0));
+	const auto normal = _graph.import("Normal", _offscreenRender.getColor(1));
+	const auto material = _graph.import("Material", _offscreenRender.getColor(2));
+	const auto depth = _graph.import("Depth", _offscreenRender.getDepth());
+	const auto shadow_atlas = _graph.import("ShadowAtlas", _scene.getShadowAtlas().getTexture());
+	const auto ldr = _graph.import("LDR", _ldrBuffer.getColor(0));
 	
-	// Alternate between two color buffers to compose post processes
-	auto select_buffer = [&]() {
-		if(write_to_post_buffer)
-		{
-			_postProcessBuffer.bind();
-			_offscreenRender.getColor(0).bind(0);
-		} else {
-			_offscreenRender.bind();
-			_postProcessBuffer.getColor(0).bind(0);
-		}
-		write_to_post_buffer = !write_to_post_buffer;
-	};
+	// Transients
+	RenderGraph::TextureDesc hdr_desc{getInternalWidth(), getInternalHeight(), GL_RGBA16F, GL_RGBA, Texture::PixelType::Float};
+	const auto lit = _graph.create("Lit", hdr_desc);
+	const int max_levels = static_cast<int>(std::log2(std::max(getInternalWidth(), getInternalHeight())));
+	const int bloom_levels = _bloom ? std::min(std::max(_bloomLevels, 1), max_levels) : 0;
+	RenderGraph::TextureDesc bloom_desc = hdr_desc;
+	bloom_desc.mipmaps = true; // Levels of the bloom chain
+	const auto bloom = bloom_levels > 0 ? _graph.create("Bloom", bloom_desc) : lit;
+	const auto blurred = _postProcessBlur ? _graph.create("Blurred", hdr_desc) : lit;
+	
+	_graph.addPass("GBuffer", [this](const RenderGraph&) { renderGBuffer(); })
+		.write(color_material, Access::Attachment).write(normal, Access::Attachment)
+		.write(material, Access::Attachment).write(depth, Access::Attachment);
+	
+	// Tests the objects against this frame's depth, for the next frames
+	_graph.addPass("OcclusionCulling", [this, depth](const RenderGraph& g) {
+		_scene.updateOcclusionCulling(g.getTexture(depth), getInternalWidth(), getInternalHeight(), _camera);
+	}).read(depth, Access::Sampled).sideEffect();
+	
+	auto& light_pass = _graph.addPass("Light", [this, lit, bloom, bloom_levels](const RenderGraph& g) {
+		renderLightPass(g.getTexture(lit), bloom_levels > 0 ? &g.getTexture(bloom) : nullptr);
+	}).read(color_material, Access::Image).read(normal, Access::Image).read(material, Access::Image)
+	  .read(depth, Access::Sampled).read(shadow_atlas, Access::Sampled).write(lit, Access::Image);
+	if(bloom_levels > 0)
+		light_pass.write(bloom, Access::Image);
 	
 	// This looks really good with downsampling (but is obviously really expensive)
 	/// @todo The amount of blur (i.e. its kernel) should be customizable.
 	if(_postProcessBlur)
-		blur(_offscreenRender.getColor(0), getInternalWidth(), getInternalHeight(), 0);
+		_graph.addPass("Blur", [this, lit, blurred](const RenderGraph& g) {
+			blur(g.getTexture(lit), g.getTexture(blurred), GL_RGBA16F, getInternalWidth(), getInternalHeight());
+		}).read(lit, Access::Sampled).write(blurred, Access::Image);
 	
-	// FXAA, implementation from https://github.com/McNopper/OpenGL/blob/master/Example42/shader/fxaa.frag.glsl
-	if(_fxaa)
-	{
-		select_buffer();
-		Program& FXAA = Resources::getProgram("FXAA");
-		FXAA.use();
-		FXAA.setUniform("u_texelStep", glm::vec2(1.0f / getInternalWidth(), 1.0f / getInternalHeight()));
-		FXAA.setUniform("u_showEdges", _fxaa_showEdges ? 1 : 0);
-		FXAA.setUniform("u_fxaaOn", _fxaa ? 1 : 0);
-		FXAA.setUniform("u_lumaThreshold", _fxaa_lumaThreshold);
-		FXAA.setUniform("u_mulReduce", 1.0f / _fxaa_mulReduce);
-		FXAA.setUniform("u_minReduce", 1.0f / _fxaa_minReduce);
-		FXAA.setUniform("u_maxSpan", _fxaa_maxSpan);
-		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4); // Dummy draw call
-		FXAA.useNone();
-		Framebuffer<>::unbind(FramebufferTarget::Draw);
-	}
+	if(bloom_levels > 0)
+		_graph.addPass("Bloom", [this, bloom, bloom_levels](const RenderGraph& g) {
+			renderBloom(g.getTexture(bloom), bloom_levels);
+		}).read(bloom, Access::Sampled).write(bloom, Access::Image);
 	
-	if(_bloom)
-	{
-		// Downsampling and blur
-		_offscreenRender.getColor(2).generateMipmaps();
-		_offscreenRender.getColor(2).set(Texture::Parameter::BaseLevel, _bloomDownsampling);
-		for(int i = 0; i < _bloomBlur; ++i)
-			blur(_offscreenRender.getColor(2), getInternalWidth(), getInternalHeight(), _bloomDownsampling);
-		_offscreenRender.getColor(2).generateMipmaps();
-		
-		// Blend and display
-		select_buffer();
-		_offscreenRender.getColor(2).bind(1);
-		Program& BloomBlend = Resources::getProgram("BloomBlend");
-		BloomBlend.use();
-		BloomBlend.setUniform("Exposure", _exposure);
-		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4); // Dummy draw call
-		_offscreenRender.getColor(2).set(Texture::Parameter::BaseLevel, 0);
-		BloomBlend.useNone();
-		Framebuffer<>::unbind(FramebufferTarget::Draw);
-	}
+	auto& composite = _graph.addPass("Composite", [this, blurred, bloom, bloom_levels](const RenderGraph& g) {
+		renderComposite(g.getTexture(blurred), bloom_levels > 0 ? &g.getTexture(bloom) : nullptr, bloom_levels);
+	}).read(blurred, Access::Sampled).write(ldr, Access::Image);
+	if(bloom_levels > 0)
+		composite.read(bloom, Access::Sampled);
 	
-	// Blit the result of the light pass.
-	Framebuffer<>::unbind(FramebufferTarget::Draw);
-	if(write_to_post_buffer) // Select the last color buffer we wrote to.
+	// Only the passes contributing to the displayed image are executed.
+	if(_debug_buffers) // Blit offscreen buffers.
 	{
-		_offscreenRender.bind(FramebufferTarget::Read);
-		_offscreenRender.getColor(0).bind(0);
+		const auto displayed = _framebufferToBlit == Attachment::Color0 ? color_material :
+							   _framebufferToBlit == Attachment::Color1 ? normal : material;
+		_graph.addPass("Present", [this](const RenderGraph&) {
+			Framebuffer<>::unbind(FramebufferTarget::Draw);
+			_offscreenRender.bind(FramebufferTarget::Read, _framebufferToBlit);
+			glBlitFramebuffer(0, 0, getInternalWidth(), getInternalHeight(), 
+								0, 0, _width, _height, 
+								GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}).read(displayed, Access::Attachment).sideEffect();
 	} else {
-		_postProcessBuffer.bind(FramebufferTarget::Read);
-		_postProcessBuffer.getColor(0).bind(0);
+		_graph.addPass("Present", [this](const RenderGraph&) { renderPresent(); })
+			.read(ldr, Access::Sampled).sideEffect();
 	}
-	glBlitFramebuffer(0, 0, getInternalWidth(), getInternalHeight(), 
-					0, 0, _width, _height,
-					GL_COLOR_BUFFER_BIT,
-					GL_LINEAR);
 }
 
 void DeferredRenderer::render()
 {
-	_GBufferPassTiming.begin(Query::Target::TimeElapsed);
-	renderGBuffer();
-	_GBufferPassTiming.end();
-	
-	_lightPassTiming.begin(Query::Target::TimeElapsed);
-	if(!_debug_buffers)
-		renderLightPass();
-	_lightPassTiming.end();
-	
-	_postProcessTiming.begin(Query::Target::TimeElapsed);
-	renderPostProcess();
-	_postProcessTiming.end();
+	buildRenderGraph();
+	_graph.compile();
+	_graph.execute();
 
 	_GUITiming.begin(Query::Target::TimeElapsed);
 	renderGUI();
@@ -248,11 +320,17 @@ void DeferredRenderer::render()
 
 void DeferredRenderer::updateGPUTimings()
 {
-	_lastOcclusionCullingTiming = _OcclusionCullingTiming.get<GLuint64>();
-	_lastGBufferPassTiming = _GBufferPassTiming.get<GLuint64>();
-	_lastLightPassTiming = _lightPassTiming.get<GLuint64>();
-	_lastPostProcessTiming = _postProcessTiming.get<GLuint64>();
+	_graph.updateTimings();
+	_lastOcclusionCullingTiming = _graph.getPassTime("OcclusionCulling");
+	_lastGBufferPassTiming = _graph.getPassTime("GBuffer");
+	_lastLightPassTiming = _graph.getPassTime("Light");
+	_lastPostProcessTiming = _graph.getPassTime("Blur") + _graph.getPassTime("Bloom") +
+							 _graph.getPassTime("Composite") + _graph.getPassTime("Present");
 	_lastGUITiming = _GUITiming.get<GLuint64>();
+	for(auto& it : ComponentIterator<SpotLight>{})
+		it.updateShadowMapTime();
+	for(auto& it : ComponentIterator<DirectionalLight>{})
+		it.updateShadowMapTime();
 }
 
 void DeferredRenderer::setInternalResolution(size_t width, size_t height)
@@ -270,26 +348,17 @@ void DeferredRenderer::setInternalResolution(size_t width, size_t height)
 void DeferredRenderer::initGBuffer(size_t width, size_t height)
 {
 	_offscreenRender = Framebuffer<Texture2D, 3>(width, height);
-	_offscreenRender.getColor(0).setPixelType(Texture::PixelType::Float);
-	_offscreenRender.getColor(0).create(nullptr, width, height, GL_RGBA32F, GL_RGBA, false);
-	_offscreenRender.getColor(0).set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
-	_offscreenRender.getColor(0).set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
-	_offscreenRender.getColor(1).setPixelType(Texture::PixelType::Float);
-	_offscreenRender.getColor(1).create(nullptr, width, height, GL_RGBA32F, GL_RGBA, false);
-	_offscreenRender.getColor(1).set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
-	_offscreenRender.getColor(1).set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
-	_offscreenRender.getColor(2).setPixelType(Texture::PixelType::Float);
-	_offscreenRender.getColor(2).create(nullptr, width, height, GL_RGBA32F, GL_RGBA, false);
-	_offscreenRender.getColor(2).set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
-	_offscreenRender.getColor(2).set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
+	init_target(_offscreenRender.getColor(0), width, height, GL_RGBA8, GL_RGBA, Texture::PixelType::UnsignedByte);
+	init_target(_offscreenRender.getColor(1), width, height, GL_RG16F, GL_RG, Texture::PixelType::Float);
+	init_target(_offscreenRender.getColor(2), width, height, GL_RG8, GL_RG, Texture::PixelType::UnsignedByte);
 	_offscreenRender.init();
 	
-	_postProcessBuffer = Framebuffer<Texture2D, 1>(width, height);
-	_postProcessBuffer.getColor(0).setPixelType(Texture::PixelType::Float);
-	_postProcessBuffer.getColor(0).create(nullptr, width, height, GL_RGBA32F, GL_RGBA, false);
-	_postProcessBuffer.getColor(0).set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
-	_postProcessBuffer.getColor(0).set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
-	_postProcessBuffer.init();
+	// The HDR targets of the light pass and of the post process are transients of _graph:
+	// reallocated on their first use at the new resolution, the old ones released a few frames later.
+	
+	_ldrBuffer = Framebuffer<Texture2D, 1>(width, height);
+	init_target(_ldrBuffer.getColor(0), width, height, GL_RGBA8, GL_RGBA, Texture::PixelType::UnsignedByte);
+	_ldrBuffer.init();
 }
 	
 void DeferredRenderer::resize_callback(GLFWwindow* _window, int width, int height)
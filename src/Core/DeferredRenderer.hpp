@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Application.hpp>
+#include <RenderGraph.hpp>
 
 class DeferredRenderer : public Application
 {
@@ -30,16 +31,25 @@ public:
 	virtual void init(const std::string& windowName = "Default Window") override;
 	
 	virtual void run_init() override;
+	
+	/// Size of the G-Buffer: RGBA8 + RG16F + RG8 + 32 bits depth (was 3 * RGBA32F + depth, 52 bytes).
+	static constexpr size_t GBufferBytesPerPixel = 4 + 4 + 2 + 4;
+	
+	inline size_t getGBufferSize() const { return getInternalWidth() * getInternalHeight() * GBufferBytesPerPixel; }
 
 protected:
 	/**
 	 * G-Buffer:
-	 *  Color0 : Color (xyz) and MaterialInfo (w)
-	 *  Color1 : World Position (xyz) and Depth (w)
-	 *  Color2 : Encoded Normal (xy), F0 (z) and R (w)
+	 *  Color0 : Color (xyz) and MaterialInfo (w), RGBA8
+	 *  Color1 : Octahedral Normal (xy), RG16F
+	 *  Color2 : F0 (x) and R (y), RG8
+	 *  Depth  : World Position is reconstructed from it (inverse of the view projection)
 	**/
 	Framebuffer<Texture2D, 3>		_offscreenRender;
-	Framebuffer<Texture2D, 1>		_postProcessBuffer;
+	Framebuffer<Texture2D, 1>		_ldrBuffer;			///< Tone mapped output of the post process (RGBA8, luma in alpha for the FXAA)
+	
+	/// Passes of the frame, also owns the intermediate (HDR) targets, see buildRenderGraph().
+	RenderGraph						_graph;
 	
 	// Downsampling
 	bool		_postProcessBlur = false;
@@ -60,8 +70,7 @@ protected:
 	
 	bool 		_bloom = true;
 	float		_bloom_strength = 1.2f;
-	int			_bloomBlur = 2;
-	int			_bloomDownsampling = 3;
+	int			_bloomLevels = 5;			///< Length of the downsampling chain of the bloom
 	
 	float		_minVariance = 0.0000001f;
 	
@@ -72,16 +81,44 @@ protected:
 	int			_volumeSamples = 0;
 	float		_atmosphericDensity = 0.002f;
 	
+	/**
+	 * Parameters of the light pass, LightPassBlock of tiled_deferred_shadow_cs.glsl (std140).
+	 * Uploaded only when they change.
+	**/
+	struct LightPassParameters
+	{
+		glm::mat4		invViewProjection;
+		glm::mat4		invProjection;
+		glm::vec3		cameraPosition;
+		GLuint			directionalLightCount;
+		glm::vec3		ambiant;
+		float			bloom;
+		float			minVariance;
+		float			atmosphericDensity;
+		float			aoThreshold;
+		float			aoRadius;
+		float			clusterNear;
+		float			clusterFar;
+		GLint			aoSamples;
+		GLint			volumeSamples;
+		GLuint			shadowCount;
+		GLuint			cubeShadowCount;
+		glm::uvec4		clusterCount;		///< Tiles along x and y, depth slices, tile size (in pixels)
+		GLuint			padding[2];			///< std140 size of the block
+	};
+	
+	static constexpr GLuint	LightPassBinding = 1;
+	
+	LightPassParameters	_lightPassParameters;
+	UniformBuffer		_lightPassBuffer;
+	bool				_lightPassBufferValid = false;
+	
 	// Debug
 	bool		_debug_buffers		= false;
 	Attachment	_framebufferToBlit	= Attachment::Color0;
 	
 	Query		_updateTiming;
-	Query		_OcclusionCullingTiming;
-	Query		_GBufferPassTiming;
-	Query		_lightPassTiming;
-	Query		_postProcessTiming;
-	Query		_GUITiming;
+	Query		_GUITiming;	///< The passes of the RenderGraph are timed by it.
 	GLuint64	_lastOcclusionCullingTiming = 0;
 	GLuint64	_lastGBufferPassTiming = 0;
 	GLuint64	_lastLightPassTiming = 0;
@@ -96,8 +133,21 @@ protected:
 	
 	virtual void renderGBuffer();
 	virtual void renderGBufferPost() {};
-	virtual void renderLightPass();
-	virtual void renderPostProcess();
+	/// @param bloom Thresholded output, nullptr if the bloom is disabled.
+	virtual void renderLightPass(const Texture2D& lit, const Texture2D* bloom);
+	/// Dual filter downsampling, then upsampling, in the mipmaps of bloom (see dual_filter.glsl).
+	void renderBloom(const Texture2D& bloom, int levels);
+	/// Last step of the bloom, tone mapping and luma to _ldrBuffer.
+	void renderComposite(const Texture2D& color, const Texture2D* bloom, int bloomLevels);
+	/// FXAA of _ldrBuffer to the screen.
+	void renderPresent();
+	
+	/**
+	 * Declares the passes of the frame (and the textures they access) to _graph:
+	 * GBuffer -> OcclusionCulling -> Light -> [Blur] -> [Bloom] -> Composite -> Present.
+	 * With _debug_buffers, Present blits the G-Buffer and the light and post process passes are culled.
+	**/
+	virtual void buildRenderGraph();
 	
 	void updateGPUTimings();
 	
@@ -1,4 +1,4 @@
-#include <log.hpp>
+#include <Log.hpp>
 
 namespace Log
 {
@@ -12,6 +12,7 @@ std::array<const char*, 3>	_log_types = {
 std::ostringstream						_log_line;
 std::deque<LogLine>						_logs;
 std::function<void(const LogLine& ll)>	_log_callback;
+std::mutex								_log_mutex;
 
 void _addLogLine(const LogLine& ll)
 {
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <chrono>
 #include <functional>
+#include <mutex>
 
 namespace Log
 {
@@ -46,6 +47,7 @@ struct LogLine
 extern std::ostringstream						_log_line;
 extern std::deque<LogLine>						_logs;
 extern std::function<void(const LogLine& ll)>	_log_callback;
+extern std::mutex								_log_mutex;	///< Logging is allowed from worker threads
 
 void _log(LogType lt);
 
@@ -59,18 +61,21 @@ inline void _log(LogType lt, const T& msg, Args... args)
 template<typename ...Args>
 inline void info(Args... args)
 {
+	std::lock_guard<std::mutex> lock(_log_mutex);
 	_log(LogType::Info, args...);
 }
 
 template<typename ...Args>
 inline void warn(Args... args)
 {
+	std::lock_guard<std::mutex> lock(_log_mutex);
 	_log(LogType::Warning, args...);
 }
 
 template<typename ...Args>
 inline void error(Args... args)
 {
+	std::lock_guard<std::mutex> lock(_log_mutex);
 	_log(LogType::Error, args...);
 }
 
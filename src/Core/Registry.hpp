@@ -0,0 +1,225 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cassert>
+
+/**
+ * Compact reference to a named resource of a Registry.
+ * Obtained once from the name (Registry::intern), lookups are then a simple array indexing.
+ * A handle stays valid for the whole lifetime of the registry (names are never removed),
+ * even if the resource itself is destroyed.
+**/
+template<typename T>
+struct Handle
+{
+	static constexpr uint32_t Invalid = ~0u;
+	
+	uint32_t	index = Invalid;
+	
+	inline bool isValid() const { return index != Invalid; }
+	inline explicit operator bool() const { return isValid(); }
+	inline bool operator==(const Handle& h) const { return index == h.index; }
+	inline bool operator!=(const Handle& h) const { return index != h.index; }
+};
+
+/**
+ * Memory used by a resource, in bytes.
+**/
+struct MemoryUsage
+{
+	size_t	cpu = 0;	///< Main memory
+	size_t	gpu = 0;	///< Buffers and textures
+	
+	inline MemoryUsage& operator+=(const MemoryUsage& m) { cpu += m.cpu; gpu += m.gpu; return *this; }
+	inline MemoryUsage& operator-=(const MemoryUsage& m) { cpu -= m.cpu; gpu -= m.gpu; return *this; }
+};
+
+template<typename T>
+class Ref;
+
+/**
+ * Named resources of type T, indexed by interned names.
+**/
+template<typename T>
+class Registry
+{
+public:
+	struct Entry
+	{
+		std::string			name;
+		std::unique_ptr<T>	resource;		///< May be null (not created yet, or destroyed)
+		uint32_t			refcount = 0;	///< Number of acquire() without matching release()
+		MemoryUsage			memory;			///< As of the last accounting (see Resources::update())
+		uint64_t			last_used = 0;	///< Time (see setTime()) of the last creation, acquire() or release()
+	};
+	
+	/**
+	 * @return Handle associated with name, created if needed (the resource itself isn't).
+	**/
+	Handle<T> intern(const std::string& name)
+	{
+		auto it = _indices.find(name);
+		if(it != _indices.end())
+			return Handle<T>{it->second};
+		const uint32_t index = static_cast<uint32_t>(_entries.size());
+		_entries.emplace_back();
+		_entries.back().name = name;
+		_indices.emplace(name, index);
+		return Handle<T>{index};
+	}
+	
+	/**
+	 * @return Handle associated with name, or an invalid handle if the name was never interned.
+	**/
+	Handle<T> find(const std::string& name) const
+	{
+		auto it = _indices.find(name);
+		return it != _indices.end() ? Handle<T>{it->second} : Handle<T>{};
+	}
+	
+	/**
+	 * Linear search, avoid it on hot paths.
+	 * @return Handle associated with resource, or an invalid handle if it isn't part of the registry.
+	**/
+	Handle<T> find(const T* resource) const
+	{
+		for(uint32_t i = 0; i < _entries.size(); ++i)
+			if(_entries[i].resource.get() == resource)
+				return Handle<T>{i};
+		return Handle<T>{};
+	}
+	
+	inline Entry&		operator[](Handle<T> h)			{ assert(h.index < _entries.size()); return _entries[h.index]; }
+	inline const Entry&	operator[](Handle<T> h) const	{ assert(h.index < _entries.size()); return _entries[h.index]; }
+	
+	/// @return Resource associated with h, or nullptr if it doesn't exist
+	inline T*		get(Handle<T> h) const { return h.index < _entries.size() ? _entries[h.index].resource.get() : nullptr; }
+	inline bool		contains(Handle<T> h) const { return get(h) != nullptr; }
+	
+	/**
+	 * @return Resource associated with h, created as a U if it doesn't exist.
+	**/
+	template<typename U = T>
+	U& getOrCreate(Handle<T> h)
+	{
+		auto& e = (*this)[h];
+		if(!e.resource)
+		{
+			e.resource.reset(new U());
+			e.last_used = _time;
+		}
+		return *static_cast<U*>(e.resource.get());
+	}
+	
+	/**
+	 * Destroys the resource associated with h (its name and handle stay valid).
+	 * Should only be called on unreferenced resources.
+	**/
+	inline void destroy(Handle<T> h)
+	{
+		auto& e = (*this)[h];
+		e.resource.reset();
+		e.memory = MemoryUsage{};
+	}
+	
+	inline void		acquire(Handle<T> h)	{ auto& e = (*this)[h]; ++e.refcount; e.last_used = _time; }
+	inline void		release(Handle<T> h)	{ auto& e = (*this)[h]; assert(e.refcount > 0); --e.refcount; e.last_used = _time; }
+	
+	/// @return Counted reference to h (an empty Ref if h is invalid).
+	inline Ref<T>	ref(Handle<T> h)		{ return Ref<T>{*this, h}; }
+	
+	/// Sets the time used to track the last use of the resources (usually a frame number).
+	inline void		setTime(uint64_t t)		{ _time = t; }
+	inline uint64_t	getTime() const			{ return _time; }
+	
+	/**
+	 * Calls f(name, resource) for each existing resource.
+	**/
+	template<typename F>
+	void for_each(F&& f)
+	{
+		for(auto& e : _entries)
+			if(e.resource)
+				f(e.name, *e.resource);
+	}
+	
+	inline size_t	size()	const { return _entries.size(); } ///< @return Number of interned names
+	
+	typename std::vector<Entry>::iterator		begin()			{ return _entries.begin(); }
+	typename std::vector<Entry>::iterator		end()			{ return _entries.end(); }
+	typename std::vector<Entry>::const_iterator	begin() const	{ return _entries.begin(); }
+	typename std::vector<Entry>::const_iterator	end() const		{ return _entries.end(); }
+	
+private:
+	std::unordered_map<std::string, uint32_t>	_indices;
+	std::vector<Entry>							_entries;
+	uint64_t									_time = 0;
+};
+
+/**
+ * Counted reference to a resource of a Registry: while at least one Ref to
+ * a resource exists, it will not be evicted (see Resources::update()).
+ * The registry has to outlive its references.
+**/
+template<typename T>
+class Ref
+{
+public:
+	Ref() =default;
+	Ref(Registry<T>& registry, Handle<T> handle) :
+		_registry{&registry},
+		_handle{handle}
+	{
+		if(_handle)
+			_registry->acquire(_handle);
+		else
+			_registry = nullptr;
+	}
+	
+	Ref(const Ref& r) :
+		_registry{r._registry},
+		_handle{r._handle}
+	{
+		if(_registry)
+			_registry->acquire(_handle);
+	}
+	
+	Ref(Ref&& r) noexcept :
+		_registry{r._registry},
+		_handle{r._handle}
+	{
+		r._registry = nullptr;
+		r._handle = Handle<T>{};
+	}
+	
+	Ref& operator=(Ref r) noexcept
+	{
+		std::swap(_registry, r._registry);
+		std::swap(_handle, r._handle);
+		return *this;
+	}
+	
+	~Ref() { reset(); }
+	
+	inline void reset()
+	{
+		if(_registry)
+			_registry->release(_handle);
+		_registry = nullptr;
+		_handle = Handle<T>{};
+	}
+	
+	inline Handle<T>	getHandle()		const { return _handle; }
+	inline T*			get()			const { return _registry ? _registry->get(_handle) : nullptr; }
+	inline T&			operator*()		const { assert(get()); return *get(); }
+	inline T*			operator->()	const { assert(get()); return get(); }
+	inline explicit operator bool()		const { return _registry != nullptr; }
+	
+private:
+	Registry<T>*	_registry = nullptr;
+	Handle<T>		_handle;
+};
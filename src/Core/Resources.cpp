@@ -1,74 +1,638 @@
 #include <Core/Resources.hpp>
 
-std::unordered_map<std::string, std::unique_ptr<Texture>>	Resources::_textures;
-std::unordered_map<std::string, std::unique_ptr<Shader>>	Resources::_shaders;
+#include <algorithm>
+#include <fstream>
 
-std::unordered_map<std::string, Program>					Resources::_programs;
+#include <Clock.hpp>
+#include <FileWatcher.hpp>
+#include <BindlessTextures.hpp>
+#include <ProgramCache.hpp>
 
-std::unordered_map<std::string, std::unique_ptr<Mesh>>		Resources::_meshes;
+Registry<Texture>	Resources::_textures;
+Registry<Shader>	Resources::_shaders;
+Registry<Program>	Resources::_programs;
+Registry<Mesh>		Resources::_meshes;
+
+MemoryUsage			Resources::Budget{1024 * 1024 * 1024, 1024 * 1024 * 1024};
+
+bool				Resources::WatchShaders = true;
+
+namespace
+{
+	uint64_t	_frame = 0;
+	bool		_over_budget = false; ///< Avoids logging the same warning on each accounting
+	
+	struct ShaderSource
+	{
+		std::string					path;
+		std::function<Shader*()>	factory;	///< Creates an empty shader of the right type
+		std::function<void(Shader&, Shader&&)>	replace;	///< Typed move assignment
+		std::vector<std::string>	files;		///< path and its '#pragma include' dependencies (normalized)
+		bool						compiled = false;
+	};
+	
+	std::unordered_map<uint32_t, ShaderSource>					_shader_sources;	///< By ShaderHandle
+	std::unordered_map<uint32_t, std::vector<Resources::ShaderHandle>>	_program_shaders;	///< By ProgramHandle
+	std::unordered_map<std::string, std::vector<uint32_t>>		_file_dependents;	///< File to ShaderHandles
+	
+	struct EvictedMesh
+	{
+		std::string		path;		///< Empty if the mesh wasn't loaded from a file
+		const Program*	program;	///< Shading program of its material (may be null)
+	};
+	std::unordered_map<uint32_t, EvictedMesh>	_evicted_meshes;	///< By MeshHandle, reloaded by getMesh()
+	
+	FileWatcher& watcher()
+	{
+		static FileWatcher w;
+		return w;
+	}
+	
+	/**
+	 * Copies the values of the default block uniforms of from to the uniforms of the same name and type of to,
+	 * so values set once (at initialization) survive a reload. Double precision uniforms aren't supported.
+	**/
+	void copy_uniforms(GLuint from, GLuint to)
+	{
+		GLint count = 0;
+		glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+		for(GLint i = 0; i < count; ++i)
+		{
+			GLchar buffer[256];
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(from, static_cast<GLuint>(i), sizeof(buffer), nullptr, &size, &type, buffer);
+			std::string name{buffer};
+			if(size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+				name.resize(name.size() - 3);
+			
+			for(GLint e = 0; e < size; ++e)
+			{
+				const std::string element = size > 1 ? name + "[" + std::to_string(e) + "]" : name;
+				const GLint src = glGetUniformLocation(from, element.c_str());
+				const GLint dst = glGetUniformLocation(to, element.c_str());
+				if(src < 0 || dst < 0) // Uniform block member, or removed from the new version
+					continue;
+				GLfloat f[16];
+				GLint n[4];
+				GLuint u[4];
+				switch(type)
+				{
+					case GL_FLOAT:				glGetUniformfv(from, src, f); glProgramUniform1fv(to, dst, 1, f); break;
+					case GL_FLOAT_VEC2:			glGetUniformfv(from, src, f); glProgramUniform2fv(to, dst, 1, f); break;
+					case GL_FLOAT_VEC3:			glGetUniformfv(from, src, f); glProgramUniform3fv(to, dst, 1, f); break;
+					case GL_FLOAT_VEC4:			glGetUniformfv(from, src, f); glProgramUniform4fv(to, dst, 1, f); break;
+					case GL_FLOAT_MAT2:			glGetUniformfv(from, src, f); glProgramUniformMatrix2fv(to, dst, 1, GL_FALSE, f); break;
+					case GL_FLOAT_MAT3:			glGetUniformfv(from, src, f); glProgramUniformMatrix3fv(to, dst, 1, GL_FALSE, f); break;
+					case GL_FLOAT_MAT4:			glGetUniformfv(from, src, f); glProgramUniformMatrix4fv(to, dst, 1, GL_FALSE, f); break;
+					case GL_UNSIGNED_INT:		glGetUniformuiv(from, src, u); glProgramUniform1uiv(to, dst, 1, u); break;
+					case GL_UNSIGNED_INT_VEC2:	glGetUniformuiv(from, src, u); glProgramUniform2uiv(to, dst, 1, u); break;
+					case GL_UNSIGNED_INT_VEC3:	glGetUniformuiv(from, src, u); glProgramUniform3uiv(to, dst, 1, u); break;
+					case GL_UNSIGNED_INT_VEC4:	glGetUniformuiv(from, src, u); glProgramUniform4uiv(to, dst, 1, u); break;
+					case GL_INT_VEC2: case GL_BOOL_VEC2:	glGetUniformiv(from, src, n); glProgramUniform2iv(to, dst, 1, n); break;
+					case GL_INT_VEC3: case GL_BOOL_VEC3:	glGetUniformiv(from, src, n); glProgramUniform3iv(to, dst, 1, n); break;
+					case GL_INT_VEC4: case GL_BOOL_VEC4:	glGetUniformiv(from, src, n); glProgramUniform4iv(to, dst, 1, n); break;
+					case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+					case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4: break;
+					default: // int, bool, samplers and images
+						glGetUniformiv(from, src, n); glProgramUniform1iv(to, dst, 1, n); break;
+				}
+			}
+		}
+	}
+}
 
 Shader& Resources::getShader(const std::string& name) noexcept(false)
 {
-	auto it = _shaders.find(name);
-	if(it != _shaders.end())
+	auto h = _shaders.find(name);
+	if(_shaders.contains(h))
 	{
-		return *it->second.get();
+		return *_shaders.get(h);
 	} else {
 		throw std::runtime_error(name + " shader not found. Use a specialized version of getShader or make sure you referenced it to the ResourcesManager before calling getShader.");
 	}
 }
 
+Shader& Resources::getShader(ShaderHandle handle) noexcept(false)
+{
+	if(_shaders.contains(handle))
+	{
+		return *_shaders.get(handle);
+	} else {
+		throw std::runtime_error(_shaders[handle].name + " shader not found. Use a specialized version of getShader or make sure you referenced it to the ResourcesManager before calling getShader.");
+	}
+}
+
 Texture& Resources::getTexture(const std::string& name) noexcept(false)
 {
-	auto it = _textures.find(name);
-	if(it != _textures.end())
+	auto h = _textures.find(name);
+	if(_textures.contains(h))
 	{
-		return *it->second.get();
+		return *_textures.get(h);
 	} else {
 		throw std::runtime_error(name + " texture not found. Use a specialized version of getTexture or make sure you referenced it to the ResourcesManager before calling getTexture.");
 	}
 }
 
+Texture& Resources::getTexture(TextureHandle handle) noexcept(false)
+{
+	if(_textures.contains(handle))
+	{
+		return *_textures.get(handle);
+	} else {
+		throw std::runtime_error(_textures[handle].name + " texture not found. Use a specialized version of getTexture or make sure you referenced it to the ResourcesManager before calling getTexture.");
+	}
+}
+
 Program& Resources::getProgram(const std::string& name)
 { 
-	return _programs[name];
+	return _programs.getOrCreate(_programs.intern(name));
 }
 
-void Resources::reloadShaders()
+namespace
+{
+
+std::string directory_of(const std::string& path)
+{
+	auto p = path.find_last_of('/');
+	return p == std::string::npos ? "." : path.substr(0, p);
+}
+
+/**
+ * Appends path and the files it includes (recursively) to files.
+**/
+void collect_files(const std::string& path, std::vector<std::string>& files)
+{
+	const auto file = FileWatcher::normalize(path);
+	if(std::find(files.begin(), files.end(), file) != files.end())
+		return;
+	files.push_back(file);
+	
+	static const std::string directive = "#pragma include";
+	std::ifstream in(file);
+	std::string line;
+	while(std::getline(in, line))
+	{
+		auto start = line.find_first_not_of(" \t");
+		if(start == std::string::npos || line.compare(start, directive.size(), directive) != 0)
+			continue;
+		auto name_start = line.find_first_not_of(" \t", start + directive.size());
+		auto name_end = line.find_last_not_of(" \t\r");
+		if(name_start == std::string::npos)
+			continue;
+		// Included paths are relative to the including file
+		collect_files(directory_of(file) + "/" + line.substr(name_start, name_end - name_start + 1), files);
+	}
+}
+
+void update_dependencies(uint32_t shader)
+{
+	auto& source = _shader_sources[shader];
+	for(const auto& f : source.files)
+	{
+		auto& d = _file_dependents[f];
+		d.erase(std::remove(d.begin(), d.end(), shader), d.end());
+	}
+	source.files.clear();
+	collect_files(source.path, source.files);
+	for(const auto& f : source.files)
+	{
+		_file_dependents[f].push_back(shader);
+		watcher().watch(f);
+	}
+}
+
+}
+
+void Resources::trackShader(ShaderHandle handle, const std::string& path, std::function<Shader*()> factory,
+							std::function<void(Shader&, Shader&&)> replace)
+{
+	_shader_sources[handle.index] = ShaderSource{path, std::move(factory), std::move(replace), {}};
+	update_dependencies(handle.index);
+}
+
+void Resources::trackProgram(ProgramHandle handle, std::vector<ShaderHandle> shaders)
+{
+	_program_shaders[handle.index] = std::move(shaders);
+}
+
+bool Resources::isLoaded(ShaderHandle handle)
+{
+	return _shader_sources.count(handle.index) > 0;
+}
+
+bool Resources::compileShader(ShaderHandle handle)
+{
+	auto it = _shader_sources.find(handle.index);
+	if(it == _shader_sources.end()) // Not managed by load(): assumed ready.
+		return _shaders.contains(handle);
+	if(it->second.compiled)
+		return true;
+	auto& s = *_shaders.get(handle);
+	s.compile();
+	it->second.compiled = static_cast<bool>(s);
+	return it->second.compiled;
+}
+
+namespace
+{
+
+unsigned long long program_key(const std::vector<Resources::ShaderHandle>& shaders)
+{
+	std::vector<std::string> files;
+	for(auto s : shaders)
+	{
+		auto it = _shader_sources.find(s.index);
+		if(it != _shader_sources.end())
+			files.insert(files.end(), it->second.files.begin(), it->second.files.end());
+	}
+	return ProgramCache::key(files);
+}
+
+void record_build(bool hit, Clock::time_point start)
+{
+	auto& stats = ProgramCache::getStatistics();
+	if(hit)
+		++stats.hits;
+	else
+		++stats.misses;
+	stats.time += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+}
+
+bool Resources::buildProgram(Program& program, const std::vector<ShaderHandle>& shaders)
+{
+	const auto start = Clock::now();
+	const auto key = program_key(shaders);
+	
+	program.init();
+	if(ProgramCache::load(program.getName(), key))
+	{
+		record_build(true, start);
+		return true;
+	}
+	
+	for(auto s : shaders)
+	{
+		if(!compileShader(s))
+			return false;
+		program.attach(*_shaders.get(s));
+	}
+	ProgramCache::prepare(program.getName());
+	program.link();
+	if(!program)
+		return false;
+	ProgramCache::save(program.getName(), key);
+	record_build(false, start);
+	return true;
+}
+
+bool Resources::buildComputeShader(ShaderHandle handle)
 {
-	for(auto& S : _shaders)
+	const auto start = Clock::now();
+	const auto key = program_key({handle});
+	
+	auto& cs = static_cast<ComputeShader&>(*_shaders.get(handle));
+	cs.getProgram().init();
+	if(ProgramCache::load(cs.getProgram().getName(), key))
 	{
-		S.second->reload();
-		S.second->compile();
+		record_build(true, start);
+		return true;
 	}
 	
-	for(auto& P : _programs)
-		P.second.link();
+	if(!compileShader(handle)) // Also links the program of the compute shader
+		return false;
+	ProgramCache::save(cs.getProgram().getName(), key);
+	record_build(false, start);
+	return true;
+}
+
+glm::ivec3 Resources::getWorkgroupSize(const ComputeShader& cs)
+{
+	glm::ivec3 size{1};
+	glGetProgramiv(cs.getProgram().getName(), GL_COMPUTE_WORK_GROUP_SIZE, &size.x);
+	return size;
+}
+
+void Resources::reloadShaders(const std::vector<ShaderHandle>& shaders)
+{
+	const auto start = Clock::now();
+	
+	std::vector<ProgramHandle> programs;
+	size_t reloaded = 0;
+	for(auto h : shaders)
+	{
+		auto it = _shader_sources.find(h.index);
+		if(it == _shader_sources.end())
+		{
+			Log::warn("Resources: Shader '", _shaders[h].name, "' wasn't loaded from a file and can't be reloaded.");
+			continue;
+		}
+		update_dependencies(h.index); // Includes may have changed
+		
+		// The new shader replaces the previous one only if it compiles. It is moved into the previous object:
+		// references to the shader (held across frames) stay valid.
+		std::unique_ptr<Shader> s{it->second.factory()};
+		s->loadFromFile(it->second.path);
+		s->compile();
+		if(!*s)
+		{
+			Log::error("Resources: Error compiling '", it->second.path, "', the previous version is kept.");
+			continue;
+		}
+		if(auto cs = dynamic_cast<ComputeShader*>(s.get()))
+		{
+			copy_uniforms(static_cast<const ComputeShader&>(*_shaders.get(h)).getProgram().getName(), cs->getProgram().getName());
+			ProgramCache::save(cs->getProgram().getName(), program_key({h}));
+		}
+		it->second.replace(*_shaders.get(h), std::move(*s));
+		it->second.compiled = true;
+		++reloaded;
+		
+		for(const auto& p : _program_shaders)
+			if(std::find(p.second.begin(), p.second.end(), h) != p.second.end() &&
+			   std::find(programs.begin(), programs.end(), ProgramHandle{p.first}) == programs.end())
+				programs.push_back(ProgramHandle{p.first});
+	}
+	
+	size_t relinked = 0;
+	for(auto h : programs)
+	{
+		// Linked separately: the previous program stays usable if this one fails.
+		Program p;
+		if(!buildProgram(p, _program_shaders[h.index]))
+		{
+			Log::error("Resources: Error linking program '", _programs[h].name, "', the previous version is kept.");
+			continue;
+		}
+		copy_uniforms(_programs.getOrCreate(h).getName(), p.getName());
+		_programs.getOrCreate(h) = std::move(p);
+		Material::programRelinked(_programs.getOrCreate(h)); // Relinked in place: cached locations are outdated
+		++relinked;
+	}
+	
+	Log::info("Resources: ", reloaded, " shader(s) reloaded and ", relinked, " program(s) relinked in ",
+		std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count(), "ms.");
+}
+
+void Resources::reloadShaders()
+{
+	std::vector<ShaderHandle> shaders;
+	for(const auto& s : _shader_sources)
+		shaders.push_back(ShaderHandle{s.first});
+	reloadShaders(shaders);
+}
+
+size_t Resources::reloadModifiedShaders()
+{
+	std::vector<ShaderHandle> shaders;
+	for(const auto& f : watcher().poll())
+	{
+		Log::info("Resources: '", f, "' modified.");
+		for(auto s : _file_dependents[f])
+			if(std::find(shaders.begin(), shaders.end(), ShaderHandle{s}) == shaders.end())
+				shaders.push_back(ShaderHandle{s});
+	}
+	if(!shaders.empty())
+		reloadShaders(shaders);
+	return shaders.size();
 }
 
 bool Resources::isMesh(const std::string& name)
 {
-	auto it = _meshes.find(name);
-	return it != _meshes.end();
+	return _meshes.contains(_meshes.find(name));
 }
 	
-Mesh& Resources::getMesh(const std::string& name)
+Mesh& Resources::getMesh(const std::string& name) noexcept(false)
+{
+	return getMesh(_meshes.intern(name));
+}
+
+Mesh& Resources::getMesh(MeshHandle handle) noexcept(false)
 {
-	auto it = _meshes.find(name);
-	if(it != _meshes.end())
+	if(_meshes.contains(handle))
+		return *_meshes.get(handle);
+	
+	auto it = _evicted_meshes.find(handle.index);
+	if(it != _evicted_meshes.end())
 	{
-		return *it->second;
-	} else {
-		auto newMesh = new Mesh();
-		_meshes[name].reset(newMesh);
-		return *newMesh;
+		const EvictedMesh evicted = it->second;
+		_evicted_meshes.erase(it);
+		const std::string& name = _meshes[handle].name;
+		if(evicted.path.empty())
+			throw std::runtime_error(name + " mesh was evicted (see Resources::Budget) and can't be reloaded: it wasn't loaded from a file.");
+		
+		Log::info("Resources: Reloading evicted mesh '", name, "' from '", evicted.path, "'.");
+		// Also restores the other evicted meshes of the file, the ones still loaded are left untouched.
+		const auto meshes = evicted.program ? Mesh::load(evicted.path, *evicted.program) : Mesh::load(evicted.path);
+		for(auto m : meshes)
+			if(!m->getVAO())
+				m->createVAO();
+		if(!_meshes.contains(handle))
+			throw std::runtime_error(name + " mesh was evicted (see Resources::Budget) and couldn't be reloaded from '" + evicted.path + "'.");
+		return *_meshes.get(handle);
 	}
+	
+	return _meshes.getOrCreate(handle);
 }
 
 void Resources::clearMeshes()
 {
-	for(auto& p : _meshes)
-		p.second.release();
-	_meshes.clear();
+	// Names (and handles) stay valid.
+	size_t referenced = 0;
+	for(uint32_t i = 0; i < _meshes.size(); ++i)
+	{
+		const MeshHandle h{i};
+		if(_meshes[h].refcount > 0)
+			++referenced;
+		else
+			_meshes.destroy(h);
+	}
+	_evicted_meshes.clear(); // Cleared on purpose: not reloaded
+	if(referenced > 0)
+		Log::warn(referenced, " mesh(es) still referenced, not cleared.");
+}
+
+void Resources::update()
+{
+	++_frame;
+	_meshes.setTime(_frame);
+	_textures.setTime(_frame);
+	
+	if(WatchShaders)
+		reloadModifiedShaders();
+	
+	if(_frame % AccountingPeriod != 0)
+		return;
+	
+	updateMemoryUsage();
+	enforceBudget(Budget);
+}
+
+void Resources::updateMemoryUsage()
+{
+	for(auto& e : _meshes)
+		e.memory = e.resource ? computeMemoryUsage(*e.resource) : MemoryUsage{};
+	for(auto& e : _textures)
+		e.memory = e.resource ? computeMemoryUsage(*e.resource) : MemoryUsage{};
+}
+
+namespace
+{
+
+template<typename T>
+MemoryUsage sum(const Registry<T>& registry)
+{
+	MemoryUsage r;
+	for(const auto& e : registry)
+		r += e.memory;
+	return r;
+}
+
+struct Candidate
+{
+	uint64_t	last_used;
+	bool		is_mesh;
+	uint32_t	index;
+	MemoryUsage	memory;
+};
+
+template<typename T>
+void collect_candidates(const Registry<T>& registry, bool is_mesh, std::vector<Candidate>& candidates)
+{
+	uint32_t i = 0;
+	for(const auto& e : registry)
+	{
+		// Resources used during the current frame are kept (their users may still hold pointers to them).
+		if(e.resource && e.refcount == 0 && e.last_used < registry.getTime())
+			candidates.push_back(Candidate{e.last_used, is_mesh, i, e.memory});
+		++i;
+	}
 }
 
+}
+
+MemoryUsage Resources::getMemoryUsage(const Registry<Mesh>& registry)
+{
+	return sum(registry);
+}
+
+MemoryUsage Resources::getMemoryUsage(const Registry<Texture>& registry)
+{
+	return sum(registry);
+}
+
+size_t Resources::enforceBudget(const MemoryUsage& budget)
+{
+	MemoryUsage usage = getMemoryUsage(_meshes);
+	usage += getMemoryUsage(_textures);
+	auto over_budget = [&]() {
+		return (budget.cpu > 0 && usage.cpu > budget.cpu) || (budget.gpu > 0 && usage.gpu > budget.gpu);
+	};
+	
+	if(!over_budget())
+	{
+		_over_budget = false;
+		return 0;
+	}
+	
+	size_t evicted = 0;
+	MemoryUsage freed;
+	// Evicting a mesh releases its textures: they are candidates of the next round.
+	bool progress = true;
+	while(over_budget() && progress)
+	{
+		std::vector<Candidate> candidates;
+		collect_candidates(_meshes, true, candidates);
+		collect_candidates(_textures, false, candidates);
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& l, const Candidate& r) {
+			return l.last_used < r.last_used;
+		});
+		
+		progress = false;
+		for(const auto& c : candidates)
+		{
+			if(!over_budget())
+				break;
+			if(c.is_mesh)
+			{
+				const Mesh& m = *_meshes.get(MeshHandle{c.index});
+				_evicted_meshes[c.index] = EvictedMesh{m.getPath(), m.getMaterial().getShadingProgramPtr()};
+				_meshes.destroy(MeshHandle{c.index});
+			} else {
+				BindlessTextures::release(*_textures.get(TextureHandle{c.index}));
+				_textures.destroy(TextureHandle{c.index});
+			}
+			usage -= c.memory;
+			freed += c.memory;
+			++evicted;
+			progress = true;
+		}
+	}
+	
+	if(evicted > 0)
+		Log::info("Resources: Evicted ", evicted, " resource(s), freeing ", freed.cpu / 1024, " KiB (CPU) and ", freed.gpu / 1024, " KiB (GPU).");
+	if(over_budget() && !_over_budget)
+		Log::warn("Resources: Over budget (", usage.cpu / 1024, " KiB CPU, ", usage.gpu / 1024, " KiB GPU) but nothing left to evict.");
+	_over_budget = over_budget();
+	return evicted;
+}
+
+MemoryUsage Resources::computeMemoryUsage(const Mesh& mesh)
+{
+	MemoryUsage r;
+	r.cpu = mesh.getVertices().capacity() * sizeof(Mesh::Vertex) + mesh.getTriangles().capacity() * sizeof(Mesh::Triangle);
+	if(mesh.getVAO())
+		r.gpu = mesh.getVertices().size() * mesh.getVertexLayout().stride + mesh.getTriangles().size() * sizeof(Mesh::Triangle);
+	return r;
+}
+
+MemoryUsage Resources::computeMemoryUsage(const Texture& texture)
+{
+	MemoryUsage r;
+	if(!texture.isValid())
+		return r;
+	
+	GLenum target = texture.getType();
+	size_t faces = 1;
+	if(target == GL_TEXTURE_CUBE_MAP)
+	{
+		target = GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+		faces = 6;
+	}
+	
+	texture.bind();
+	for(GLint level = 0; level < 32; ++level)
+	{
+		GLint width = 0, height = 0, depth = 0, compressed = GL_FALSE;
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+		if(width == 0) // No more levels
+			break;
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &depth);
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+		
+		size_t bytes = 0;
+		if(compressed)
+		{
+			GLint size = 0;
+			glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			bytes = size;
+		} else {
+			GLint bits = 0;
+			for(GLenum component : {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE,
+									GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE})
+			{
+				GLint b = 0;
+				glGetTexLevelParameteriv(target, level, component, &b);
+				bits += b;
+			}
+			bytes = static_cast<size_t>(width) * height * std::max(depth, 1) * bits / 8;
+		}
+		r.gpu += faces * bytes;
+	}
+	texture.unbind();
+	
+	return r;
+}
@@ -2,42 +2,173 @@
 
 #include <unordered_map>
 #include <memory>
+#include <functional>
+#include <type_traits>
 
 #include <Texture.hpp>
 #include <Shader.hpp>
+#include <Shaders.hpp>
 
 #include <Graphics/Mesh.hpp>
+#include <Core/Registry.hpp>
 
 namespace Resources
 {
 
-extern std::unordered_map<std::string, std::unique_ptr<Texture>>	_textures;
-extern std::unordered_map<std::string, std::unique_ptr<Shader>>		_shaders;
-
-extern std::unordered_map<std::string, Program>						_programs;
-
-extern std::unordered_map<std::string, std::unique_ptr<Mesh>>		_meshes;
+using TextureHandle = Handle<Texture>;
+using ShaderHandle = Handle<Shader>;
+using ProgramHandle = Handle<Program>;
+using MeshHandle = Handle<Mesh>;
+
+using TextureRef = Ref<Texture>;
+using MeshRef = Ref<Mesh>;
+
+extern Registry<Texture>	_textures;
+extern Registry<Shader>		_shaders;
+extern Registry<Program>	_programs;
+extern Registry<Mesh>		_meshes;
+
+/**
+ * Handles are obtained once from a name (typically at load time, or in a static variable),
+ * then lookups through them are a simple array indexing instead of hashing the name.
+**/
+inline TextureHandle	getTextureHandle(const std::string& name)	{ return _textures.intern(name); }
+inline ShaderHandle		getShaderHandle(const std::string& name)	{ return _shaders.intern(name); }
+inline ProgramHandle	getProgramHandle(const std::string& name)	{ return _programs.intern(name); }
+inline MeshHandle		getMeshHandle(const std::string& name)		{ return _meshes.intern(name); }
+
+/**
+ * Meshes and textures without any reference (see Ref) are evicted, least recently used first,
+ * when the memory used by the meshes and textures exceeds the budget.
+ * Evicted meshes are reloaded from their file by getMesh().
+ * A zero budget disables the eviction.
+**/
+extern MemoryUsage	Budget;
+/// Number of frames between two memory accountings (and budget checks).
+constexpr uint64_t	AccountingPeriod = 30;
+
+/**
+ * Advances the frame counter used for the LRU eviction, reloads the modified shaders (see WatchShaders).
+ * Periodically updates the memory accounting and enforces the Budget.
+ * Called once per frame by Application.
+**/
+void update();
+
+/**
+ * Recomputes the memory usage of every mesh and texture (the GL objects are queried).
+**/
+void updateMemoryUsage();
+
+/**
+ * Evicts unreferenced meshes and textures (least recently used first) until the budget is met.
+ * @return Number of evicted resources.
+**/
+size_t enforceBudget(const MemoryUsage& budget);
+
+/// @return Total memory used by each type of resource, as of the last accounting
+MemoryUsage getMemoryUsage(const Registry<Mesh>& registry);
+MemoryUsage getMemoryUsage(const Registry<Texture>& registry);
+
+MemoryUsage computeMemoryUsage(const Mesh& mesh);
+MemoryUsage computeMemoryUsage(const Texture& texture);
 
 Shader& getShader(const std::string& name) noexcept(false);
+Shader& getShader(ShaderHandle handle) noexcept(false);
 
 template<typename ShaderType>
 inline ShaderType& getShader(const std::string& name);
 
+template<typename ShaderType>
+inline ShaderType& getShader(ShaderHandle handle);
+
 Texture& getTexture(const std::string& name) noexcept(false);
+Texture& getTexture(TextureHandle handle) noexcept(false);
 
 template<typename T>
 inline T& getTexture(const std::string& name);
 
-Program& getProgram(const std::string& name);
+template<typename T>
+inline T& getTexture(TextureHandle handle);
 
+Program& getProgram(const std::string& name);
+inline Program& getProgram(ProgramHandle handle) { return _programs.getOrCreate(handle); }
+
+/**
+ * Reloads shaders from their files and relinks the programs using them
+ * (only shaders loaded through load() and programs loaded through loadProgram() are concerned).
+ * A shader failing to compile (or a program failing to link) is reported and the previous one is kept in use.
+ * Shaders and programs are replaced in place (references to them stay valid), with the values of their uniforms.
+**/
+void reloadShaders(const std::vector<ShaderHandle>& shaders);
+/// Reloads all shaders.
 void reloadShaders();
+inline void reloadShader(ShaderHandle handle) { reloadShaders({handle}); }
+
+/**
+ * When true, update() reloads the shaders whose files (including their '#pragma include' dependencies) were modified.
+**/
+extern bool WatchShaders;
+
+/**
+ * Reloads the shaders depending on modified files.
+ * @return Number of reloaded shaders.
+**/
+size_t reloadModifiedShaders();
+
+/**
+ * Used by load(): remembers how to reload the shader and watches its files.
+ * @param factory Creates an empty shader of the type of handle
+ * @param replace Moves a reloaded shader (created by factory) into the existing one, which keeps its address
+**/
+void trackShader(ShaderHandle handle, const std::string& path, std::function<Shader*()> factory,
+				 std::function<void(Shader&, Shader&&)> replace);
+/// Used by loadProgram(): remembers the shaders of the program.
+void trackProgram(ProgramHandle handle, std::vector<ShaderHandle> shaders);
+/// @return true if the shader was loaded through load() (it may not be compiled, see compileShader()).
+bool isLoaded(ShaderHandle handle);
+
+/**
+ * Compiles a shader loaded through load() if it isn't already.
+ * @return false on compilation error.
+**/
+bool compileShader(ShaderHandle handle);
+
+/**
+ * Links program from shaders loaded through load(), or loads it from the ProgramCache.
+ * Shaders are compiled only on a cache miss.
+ * @return false on error.
+**/
+bool buildProgram(Program& program, const std::vector<ShaderHandle>& shaders);
+
+/**
+ * Same as buildProgram() for the program of a ComputeShader.
+**/
+bool buildComputeShader(ShaderHandle handle);
+
+/**
+ * Queried from the program: ComputeShader::getWorkgroupSize() is only set when the shader is compiled,
+ * which is skipped when the program comes from the ProgramCache. To be used for all dispatches.
+**/
+glm::ivec3 getWorkgroupSize(const ComputeShader& cs);
+
+/// @return Number of workgroups of size covering count invocations.
+inline GLuint groupCount(size_t count, int size) { return static_cast<GLuint>((count + size - 1) / size); }
 
 bool isMesh(const std::string& name);
 
+/**
+ * Destroys all unreferenced meshes.
+**/
 void clearMeshes();
 
-Mesh& getMesh(const std::string& name);
-inline std::unique_ptr<Mesh>& getMeshPtr(const std::string& name) { return _meshes[name]; }
+/**
+ * A mesh evicted to meet the Budget is reloaded (synchronously) from the file it was loaded from.
+ * Other missing meshes are created empty: placeholders filled later by Mesh::finalize().
+ * @throw std::runtime_error if the mesh was evicted but can't be reloaded (not loaded from a file, or the file is gone).
+**/
+Mesh& getMesh(const std::string& name) noexcept(false);
+Mesh& getMesh(MeshHandle handle) noexcept(false);
+inline std::unique_ptr<Mesh>& getMeshPtr(const std::string& name) { return _meshes[_meshes.intern(name)].resource; }
 
 template<typename ShaderType>
 inline ShaderType& load(const std::string& path);
@@ -6,29 +6,25 @@ namespace Resources
 template<typename ShaderType>
 inline ShaderType& getShader(const std::string& name)
 {
-	auto it = _shaders.find(name);
-	if(it != _shaders.end())
-	{
-		return *static_cast<ShaderType*>(it->second.get());
-	} else {
-		auto newShader = new ShaderType();
-		_shaders[name].reset(newShader);
-		return *newShader;
-	}
+	return _shaders.getOrCreate<ShaderType>(_shaders.intern(name));
+} 
+
+template<typename ShaderType>
+inline ShaderType& getShader(ShaderHandle handle)
+{
+	return _shaders.getOrCreate<ShaderType>(handle);
 } 
 
 template<typename T>
 inline T& getTexture(const std::string& name)
 {
-	auto it = _textures.find(name);
-	if(it != _textures.end())
-	{
-		return *static_cast<T*>(it->second.get());
-	} else {
-		auto newTexture = new T();
-		_textures[name].reset(newTexture);
-		return *newTexture;
-	}
+	return _textures.getOrCreate<T>(_textures.intern(name));
+} 
+
+template<typename T>
+inline T& getTexture(TextureHandle handle)
+{
+	return _textures.getOrCreate<T>(handle);
 } 
 
 template<typename ShaderType>
@@ -40,14 +36,21 @@ ShaderType& load(const std::string& path)
 template<typename ShaderType>
 ShaderType& load(const std::string& name, const std::string& path)
 {
-	auto& s = Resources::getShader<ShaderType>(name);
-	if(s) return s; // Already loaded.
+	const auto handle = getShaderHandle(name);
+	auto& s = Resources::getShader<ShaderType>(handle);
+	if(isLoaded(handle)) return s; // Already loaded.
+	trackShader(handle, path, []() -> Shader* { return new ShaderType(); },
+		[](Shader& s, Shader&& r) { static_cast<ShaderType&>(s) = std::move(static_cast<ShaderType&>(r)); });
 	s.loadFromFile(path);
-	s.compile();
-	if(!s)
+	// Compute shaders are programs by themselves, other shaders are only compiled
+	// if loadProgram() doesn't find the program in the ProgramCache.
+	if constexpr(std::is_base_of<ComputeShader, ShaderType>::value)
 	{
-		std::cerr << "Error compiling '" << path << "'. Exiting..." << std::endl;
-		exit(1);
+		if(!buildComputeShader(handle))
+		{
+			std::cerr << "Error compiling '" << path << "'. Exiting..." << std::endl;
+			exit(1);
+		}
 	}
 	return s;
 }
@@ -57,9 +60,9 @@ Program& loadProgram(const std::string& name, ShaderTypes& ... shaders)
 {
 	auto& p = Resources::getProgram(name);
 	if(p) return p; // Already loaded.
-	p.attach_chain(shaders...);
-	p.link();
-	if(!p)
+	const std::vector<ShaderHandle> handles{_shaders.find(&static_cast<const Shader&>(shaders))...};
+	trackProgram(getProgramHandle(name), handles);
+	if(!buildProgram(p, handles))
 	{
 		std::cerr << "Error linking GLSL program. Exiting..." << std::endl;
 		exit(1);
@@ -1,11 +1,16 @@
 #include <Scene.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 #include <Meta.hpp>
 #include <ComponentValidation.hpp>
 
 #include <Resources.hpp>
+#include <ThreadPool.hpp>
 
 #include <SpotLight.hpp>
+#include <DirectionalLight.hpp>
 
 Scene::~Scene()
 {
@@ -14,48 +19,171 @@ Scene::~Scene()
 void Scene::init()
 {
 	_pointLightBuffer.init();
-	_pointLightBuffer.bind(1);
+	updatePointLightBuffer(); // Can't be empty to be bound
+	_spotLightBuffer.init();
+	_directionalLightBuffer.init();
+	_shadowAtlas.init();
+	_modelMatrices.init();
 }
 	
-void Scene::updateLights()
+void Scene::updateLights(const Camera& c)
 {
-	// Updates GPU Buffer
-	size_t sl = 0;
+	// Resolution of the shadow maps, proportional to the size of the lights on screen
+	std::vector<SpotLight*> lights;
+	std::vector<ShadowAtlas::Request> requests;
+	const float tan_half_fov = std::tan(0.5f * glm::radians(c.getFoV()));
 	for(auto& it : ComponentIterator<SpotLight>{})
 	{
-		it.getGPUBuffer().bind(sl++ + 2);
-		if(it.dynamic) // Update Shadow maps (only if asked to)
+		it.updateMatrices();
+		const float distance = glm::distance(c.getPosition(), it.getGlobalPosition());
+		const float coverage = distance <= it.getRange() ? 1.0f : std::min(1.0f, it.getRange() / (distance * tan_half_fov));
+		const size_t max = std::min(_shadowAtlas.getMaxTileSize(), it.getResolution() >> it.downsampling);
+		lights.push_back(&it);
+		requests.push_back({ShadowAtlas::tileSize(coverage * max, it.getShadowTile().size, max), coverage});
+	}
+	// Cascades always cover the whole screen: fixed resolution, more important than any SpotLight.
+	std::vector<DirectionalLight*> directional_lights;
+	for(auto& it : ComponentIterator<DirectionalLight>{})
+	{
+		directional_lights.push_back(&it);
+		for(size_t i = 0; i < it.getCascadeCount(); ++i)
+			requests.push_back({std::min<size_t>(it.resolution, _shadowAtlas.getMaxTileSize()), 2.0f});
+	}
+	const auto tiles = _shadowAtlas.allocate(requests);
+	
+	// Only the outdated shadow maps are redrawn
+	_shadowMapUpdates = 0;
+	std::vector<const MeshRenderer*> casters;
+	_spotLightsData.clear();
+	for(size_t i = 0; i < lights.size(); ++i)
+	{
+		if(tiles[i].size == 0)
 		{
-			it.updateMatrices();
-			it.drawShadowMap(ComponentIterator<MeshRenderer>{});
+			lights[i]->setShadowTile(_shadowAtlas, tiles[i]);
+		} else {
+			ShadowAtlas::cull(lights[i]->getMatrix(), casters);
+			const size_t hash = ShadowAtlas::hash(lights[i]->getMatrix(), casters);
+			if(lights[i]->isShadowMapOutdated(tiles[i], hash))
+			{
+				lights[i]->drawShadowMap(_shadowAtlas, tiles[i], hash, casters);
+				++_shadowMapUpdates;
+			}
 		}
+		_spotLightsData.push_back(lights[i]->getGPUData());
 	}
+	
+	_directionalLightsData.clear();
+	if(!directional_lights.empty())
+	{
+		// Bounds of all the casters, the cascades are extended towards the light to include them.
+		AABB<glm::vec3> bounds{glm::vec3{0.0f}, glm::vec3{0.0f}};
+		bool first = true;
+		for(const auto& it : ComponentIterator<MeshRenderer>{})
+		{
+			if(first)
+				bounds = it.getAABB();
+			else
+				bounds += it.getAABB();
+			first = false;
+		}
+		
+		size_t t = lights.size();
+		for(auto* light : directional_lights)
+		{
+			light->updateCascades(c, bounds, &tiles[t]);
+			for(size_t i = 0; i < light->getCascadeCount(); ++i, ++t)
+			{
+				if(tiles[t].size == 0)
+				{
+					light->setShadowTile(_shadowAtlas, i, tiles[t]);
+				} else {
+					const auto& vp = light->getCascade(i).VPMatrix;
+					ShadowAtlas::cull(vp, casters);
+					const size_t hash = ShadowAtlas::hash(vp, casters);
+					if(light->isShadowMapOutdated(i, tiles[t], hash))
+					{
+						light->drawShadowMap(_shadowAtlas, i, tiles[t], hash, casters);
+						++_shadowMapUpdates;
+					}
+				}
+			}
+			_directionalLightsData.push_back(light->getGPUData());
+		}
+	}
+	
+	if(_spotLightsData.empty()) // Can't be empty to be bound
+		_spotLightsData.push_back({});
+	_spotLightBuffer.data(_spotLightsData.data(), _spotLightsData.size() * sizeof(SpotLight::GPUData), Buffer::Usage::DynamicDraw);
+	if(_directionalLightsData.empty())
+		_directionalLightsData.push_back({});
+	_directionalLightBuffer.data(_directionalLightsData.data(), _directionalLightsData.size() * sizeof(DirectionalLight::GPUData), Buffer::Usage::DynamicDraw);
 }
 
-void Scene::update()
+void Scene::setShadowMapFormat(ShadowAtlas::Format format)
+{
+	_shadowAtlas.setFormat(format);
+	for(auto& it : ComponentIterator<SpotLight>{})
+		it.invalidateShadowMap();
+	for(auto& it : ComponentIterator<DirectionalLight>{})
+		it.invalidateShadowMap();
+}
+
+void Scene::updateLightClusters(const Camera& c, size_t width, size_t height)
+{
+	_lightClusters.build(_pointLights, c.getViewMatrix(), c.getProjectionMatrix(), width, height, &ThreadPool::get());
+	_lightClusters.upload();
+	_pointLightBuffer.bind(PointLightsBinding);
+}
+
+void Scene::updateModelMatrices()
+{
+	_modelMatricesData.resize(std::max<size_t>(1, impl::components<MeshRenderer>.size()));
+	for(const auto& it : ComponentIterator<MeshRenderer>{})
+		_modelMatricesData[get_id(it)] = it.getTransformation().getGlobalMatrix() * it.getMesh().getPositionDecodeMatrix();
+	_modelMatrices.data(_modelMatricesData.data(), _modelMatricesData.size() * sizeof(glm::mat4), Buffer::Usage::StreamDraw);
+	_modelMatrices.bind(ModelMatricesBinding);
+}
+
+void Scene::update(const Camera& c)
 {
 	for_each<deletion_pass_wrapper, ComponentTypes>{}();
 	
-	updateLights();
+	updateLights(c);
 	if(_dirtyPointLights)
 		updatePointLightBuffer();
 }
 
-void Scene::occlusion_query()
+void Scene::updateOcclusionCulling(const Texture2D& depth, size_t width, size_t height, const Camera& c)
 {
 	if(!UseOcclusionCulling) return;
+	
+	_hiz.update(depth, width, height, c.getProjectionMatrix() * c.getViewMatrix());
+}
 
-	static auto& shader = Resources::getProgram("AABB");
-	shader.use();
-	for(auto& it : ComponentIterator<MeshRenderer>{})
+void Scene::render_occluders(const Camera& c)
+{
+	static_assert(sizeof(Mesh::Triangle) == 3 * sizeof(uint32_t) && sizeof(Mesh::Index) == sizeof(uint32_t),
+				  "OcclusionRasterizer reads the triangles as 32 bits indices.");
+	
+	_occlusionRasterizer.begin(c.getProjectionMatrix() * c.getViewMatrix());
+	for(const auto& it : ComponentIterator<MeshRenderer>{})
 	{
-		it.occlusion_query();
+		if(!it.occluder || !it.isVisible(c.getFrustum()))
+			continue;
+		const auto& mesh = it.getMesh();
+		if(mesh.getTriangles().empty())
+			continue;
+		_occlusionRasterizer.addOccluder(it.getTransformation().getGlobalMatrix(),
+										 &mesh.getVertices()[0].position, sizeof(Mesh::Vertex),
+										 &mesh.getTriangles()[0].vertices[0], mesh.getTriangles().size());
 	}
-	shader.useNone();
+	_occlusionRasterizer.render(&ThreadPool::get());
 }
 
-unsigned int Scene::draw(const Camera& c) const
+unsigned int Scene::draw(const Camera& c)
 {
+	updateModelMatrices();
+	
 	unsigned int draw_calls = 0;
 	if(_skybox)
 	{
@@ -63,16 +191,30 @@ unsigned int Scene::draw(const Camera& c) const
 		++draw_calls;
 	}
 	
+	if(UseOcclusionCulling)
+		_hiz.fetch();
+	if(UseSoftwareOcclusionCulling)
+		render_occluders(c);
+	
+	_drawList.clear();
 	for(const auto& it : ComponentIterator<MeshRenderer>{})
+		if((!UseOcclusionCulling || _hiz.isVisible(get_id(it))) &&
+		   (!UseFrustumCulling || it.isVisible(c.getFrustum())) &&
+		   (!UseSoftwareOcclusionCulling || it.occluder || _occlusionRasterizer.isVisible(it.getAABB())))
+			_drawList.push_back(&it);
+	
+	// Identical materials are shared: their address is a cheap sort key.
+	std::sort(_drawList.begin(), _drawList.end(), [](const MeshRenderer* l, const MeshRenderer* r) {
+		const auto& lm = l->getMaterial();
+		const auto& rm = r->getMaterial();
+		return std::make_pair(lm.getShadingProgramPtr(), &lm) < std::make_pair(rm.getShadingProgramPtr(), &rm);
+	});
+	
+	_materialState.reset(); // The skybox (and anything before) changed the program
+	for(auto it : _drawList)
 	{
-		if(UseOcclusionCulling)
-		{
-			it.draw_occlusion_culled();
-			++draw_calls;
-		} else if(!UseFrustumCulling || it.isVisible(c.getFrustum())) {
-			it.draw();
-			++draw_calls;
-		}
+		it->draw(_materialState);
+		++draw_calls;
 	}
 	
 	return draw_calls;
@@ -5,10 +5,14 @@
 #include <PointLight.hpp>
 #include <Skybox.hpp>
 #include <Camera.hpp>
+#include <HiZ.hpp>
+#include <OcclusionRasterizer.hpp>
+#include <LightClusters.hpp>
+#include <ShadowAtlas.hpp>
 
 #include <ComponentTypes.hpp>
 
-using ComponentTypes = TList<Transformation, MeshRenderer, SpotLight, CollisionBox>;
+using ComponentTypes = TList<Transformation, MeshRenderer, SpotLight, DirectionalLight, CollisionBox>;
 
 /**
  * @todo Octree
@@ -23,27 +27,91 @@ public:
 	
 	void init();
 	
-	inline const UniformBuffer& getPointLightBuffer() const { return _pointLightBuffer; }
-	inline std::vector<PointLight>& getPointLights();
+	inline const ShaderStorage& getPointLightBuffer() const { return _pointLightBuffer; }
+	inline std::vector<PointLight>& getPointLights();	///< Marks the point lights as modified
+	inline size_t getPointLightCount() const { return _pointLights.size(); }
 	inline void updatePointLightBuffer();
 
-	void updateLights();
-	void update();
-	void occlusion_query();
-	/// @return The number of draw calls generated.
-	unsigned int draw(const Camera& c) const;
+	/**
+	 * Allocates the tiles of the ShadowAtlas according to the size of the SpotLights on the screen of c
+	 * (and a fixed resolution for the cascades of the DirectionalLights, fitted to the view of c),
+	 * redraws the outdated shadow maps and uploads the lights.
+	**/
+	void updateLights(const Camera& c);
+	inline const ShadowAtlas& getShadowAtlas() const { return _shadowAtlas; }
+	/// Changes the format of the ShadowAtlas, all shadow maps will be redrawn.
+	void setShadowMapFormat(ShadowAtlas::Format format);
+	inline const ShaderStorage& getSpotLightBuffer() const { return _spotLightBuffer; }
+	inline const ShaderStorage& getDirectionalLightBuffer() const { return _directionalLightBuffer; }
+	/// @return Number of shadow maps drawn by the last updateLights()
+	inline size_t getShadowMapUpdates() const { return _shadowMapUpdates; }
+	/**
+	 * Assigns the point lights to the clusters of the view of c (see LightClusters) and uploads them.
+	 * @param width, height Resolution of the render
+	**/
+	void updateLightClusters(const Camera& c, size_t width, size_t height);
+	inline const LightClusters& getLightClusters() const { return _lightClusters; }
+	/**
+	 * Uploads the model matrices of all MeshRenderers to the ModelMatrices shader storage block,
+	 * indexed by ComponentID (see model_matrix.glsl).
+	**/
+	void updateModelMatrices();
+	void update(const Camera& c);
+	/**
+	 * Tests the MeshRenderers against the depth of the frame that was just rendered,
+	 * the results will be used by the next calls to draw() (see HiZ).
+	 * @param depth Depth buffer of the G-Buffer, rendered with c.
+	**/
+	void updateOcclusionCulling(const Texture2D& depth, size_t width, size_t height, const Camera& c);
+	inline const HiZ& getHiZ() const { return _hiz; }
+	/// @return Depth of the occluders of the last draw() (see UseSoftwareOcclusionCulling)
+	inline const OcclusionRasterizer& getOcclusionRasterizer() const { return _occlusionRasterizer; }
+	/**
+	 * Draws the visible MeshRenderers sorted by program and material,
+	 * redundant program, subroutine and material changes are skipped.
+	 * @return The number of draw calls generated.
+	**/
+	unsigned int draw(const Camera& c);
+	/// @return State of the last draw(), with its statistics.
+	inline const Material::BindingState& getMaterialState() const { return _materialState; }
 	
 	inline Skybox& getSkybox() { return _skybox; }
 	
 	bool UseFrustumCulling = true;
 	bool UseOcclusionCulling = false;
+	/// MeshRenderers marked as occluder are rasterized on the CPU, the others are tested against them (same frame).
+	bool UseSoftwareOcclusionCulling = false;
+	
+	static constexpr GLuint ModelMatricesBinding = 0; ///< Shader storage binding of the ModelMatrices block
+	static constexpr GLuint PointLightsBinding = 3; ///< Shader storage binding of the PointLights block
+	static constexpr GLuint SpotLightsBinding = 6; ///< Shader storage binding of the SpotLights block
+	static constexpr GLuint DirectionalLightsBinding = 7; ///< Shader storage binding of the DirectionalLights block
 	
 private:
 	bool							_dirtyPointLights = true;
 	std::vector<PointLight>			_pointLights;
-	UniformBuffer					_pointLightBuffer;
+	ShaderStorage					_pointLightBuffer;
+	LightClusters					_lightClusters;
+	
+	ShadowAtlas						_shadowAtlas;
+	std::vector<SpotLight::GPUData>	_spotLightsData;
+	ShaderStorage					_spotLightBuffer;
+	std::vector<DirectionalLight::GPUData>	_directionalLightsData;
+	ShaderStorage					_directionalLightBuffer;
+	size_t							_shadowMapUpdates = 0;
+	
+	std::vector<glm::mat4>			_modelMatricesData;
+	ShaderStorage					_modelMatrices;
+	
+	std::vector<const MeshRenderer*>	_drawList;
+	Material::BindingState			_materialState;
+	
+	HiZ								_hiz;
+	OcclusionRasterizer				_occlusionRasterizer;
 	
 	Skybox							_skybox;
+	
+	void render_occluders(const Camera& c);
 };
 
 inline std::vector<PointLight>& Scene::getPointLights()
@@ -54,6 +122,10 @@ inline std::vector<PointLight>& Scene::getPointLights()
 
 inline void Scene::updatePointLightBuffer()
 {
-	_pointLightBuffer.data(_pointLights.data(), _pointLights.size() * sizeof(PointLight), Buffer::Usage::DynamicDraw);
+	static const PointLight disabled{glm::vec3{0.0f}, 0.0f, glm::vec3{0.0f}, -1.0f};
+	if(_pointLights.empty())
+		_pointLightBuffer.data(&disabled, sizeof(PointLight), Buffer::Usage::DynamicDraw);
+	else
+		_pointLightBuffer.data(_pointLights.data(), _pointLights.size() * sizeof(PointLight), Buffer::Usage::DynamicDraw);
 	_dirtyPointLights = false;
 }
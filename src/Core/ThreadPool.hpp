@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+
+/**
+ * Fixed set of worker threads consuming a FIFO of tasks.
+ * GL calls are not allowed in tasks (the context is only current on the main thread).
+**/
+class ThreadPool
+{
+public:
+	/**
+	 * @param threadCount Number of workers (at least 1)
+	**/
+	explicit ThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency()));
+	ThreadPool(const ThreadPool&) =delete;
+	ThreadPool& operator=(const ThreadPool&) =delete;
+	/// Waits for the queued tasks to complete.
+	~ThreadPool();
+	
+	inline size_t getThreadCount() const { return _workers.size(); }
+	
+	/**
+	 * Queues f for execution on a worker.
+	 * @return Future of the result of f (rethrows its exceptions).
+	**/
+	template<typename F>
+	auto submit(F&& f) -> std::future<decltype(f())>;
+	
+	/**
+	 * Calls f(i) for each i in [0, count[, on the workers and the calling thread,
+	 * then returns when all calls completed.
+	 * If f throws, the remaining indices are skipped and the first exception is rethrown
+	 * on the calling thread, once no call of f is running anymore.
+	 * Can be called from a task of this pool (the calling thread does all the work if needed).
+	**/
+	template<typename F>
+	void parallel_for(size_t count, F&& f);
+	
+	/// @return Pool shared by the engine
+	static ThreadPool& get();
+	
+private:
+	std::vector<std::thread>			_workers;
+	std::deque<std::function<void()>>	_tasks;
+	std::mutex							_mutex;
+	std::condition_variable				_condition;
+	bool								_stop = false;
+	
+	void worker_loop();
+};
+
+template<typename F>
+auto ThreadPool::submit(F&& f) -> std::future<decltype(f())>
+{
+	using R = decltype(f());
+	// std::function has to be copyable, std::packaged_task isn't.
+	auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+	auto future = task->get_future();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.emplace_back([task]() { (*task)(); });
+	}
+	_condition.notify_one();
+	return future;
+}
+
+template<typename F>
+void ThreadPool::parallel_for(size_t count, F&& f)
+{
+	if(count == 0)
+		return;
+	
+	// Helpers may start after all the work is done (or never if called from a busy worker):
+	// they only share this state, f is never called once all indices are taken.
+	struct State
+	{
+		std::atomic<size_t>		next{0};
+		std::atomic<bool>		failed{false};
+		size_t					done = 0;		///< Claimed indices, called or skipped
+		std::exception_ptr		exception;		///< First one thrown by f
+		std::mutex				mutex;
+		std::condition_variable	condition;
+	};
+	auto state = std::make_shared<State>();
+	auto run = [state, count, &f]() {
+		size_t local_done = 0;
+		for(size_t i = state->next++; i < count; i = state->next++)
+		{
+			// Every claimed index is counted, even skipped or throwing, or the caller would wait forever.
+			if(!state->failed)
+			{
+				try
+				{
+					f(i);
+				} catch(...) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					if(!state->exception)
+						state->exception = std::current_exception();
+					state->failed = true;
+				}
+			}
+			++local_done;
+		}
+		if(local_done > 0)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->done += local_done;
+			if(state->done == count)
+				state->condition.notify_all();
+		}
+	};
+	
+	const size_t helpers = std::min(count - 1, getThreadCount());
+	for(size_t i = 0; i < helpers; ++i)
+		submit(run);
+	run();
+	
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->condition.wait(lock, [&] { return state->done == count; });
+	if(state->exception)
+		std::rethrow_exception(state->exception);
+}
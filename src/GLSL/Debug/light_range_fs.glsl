@@ -20,17 +20,13 @@ in layout(location = 4) vec2 texcoord;
 in layout(location = 5) float range;
 
 out layout(location = 0) vec4 colorMaterialOut;
-out layout(location = 1) vec4 worldPositionOut;
-out layout(location = 2) vec4 worldNormalOut;
+out layout(location = 1) vec2 normalOut;
+out layout(location = 2) vec2 materialOut;
 
 uniform float R = 0.0;
 uniform float F0 = 0.1;
 
-vec2 encode_normal(vec3 n)
-{
-    vec2 enc = normalize(n.xy) * (sqrt(-n.z * 0.5 + 0.5));
-    return enc * 0.5 + 0.5;
-}
+#pragma include ../octahedral.glsl
 
 void main()
 {
@@ -44,6 +40,6 @@ void main()
 	}
 	
 	colorMaterialOut = vec4((0.5 + 0.5 * dot(n, normalize(vec3(1.0)))) * color, 0.0);
-	worldPositionOut = vec4(p, gl_FragDepth);
-	worldNormalOut = vec4(encode_normal(n), 1.0, 1.0);
+	normalOut = octahedral_encode(n);
+	materialOut = vec2(1.0, 1.0);
 }
@@ -6,9 +6,9 @@ struct LightStruct
 	vec4		color;
 };
 
-layout(std140, binding = 0) uniform LightBlock
+layout(std430, binding = 3) readonly buffer PointLights
 {
-	LightStruct	Lights[1024];
+	LightStruct	Lights[];
 };
 
 uniform mat4 ModelMatrix = mat4(1.0);
@@ -1,25 +1,39 @@
 #version 430 core
+#extension GL_ARB_bindless_texture : enable
 
-#pragma include ../encode_normal.glsl
+#pragma include ../octahedral.glsl
 
 #define Samples9
 
+// Material textures as bindless handles in the MaterialBlock, when supported (see BindlessTextures).
+// Comment out to use texture units.
+#define BINDLESS_MATERIAL
+#if defined(BINDLESS_MATERIAL) && !defined(GL_ARB_bindless_texture)
+#undef BINDLESS_MATERIAL
+#endif
+
 layout(std140) uniform Camera {
 	mat4 ViewMatrix;
 	mat4 ProjectionMatrix;
 };
 
-uniform mat4 ModelMatrix = mat4(1.0);
-
-uniform vec3 Color = vec3(1.0);
-
-uniform float R = 0.4;
-uniform float F0 = 0.1;
-
-uniform float BumpScale = 0.1;
+// See Material. Block members can't have default values, the loaders set them (see apply_material in Mesh.cpp).
+layout(std140, binding = 16) uniform MaterialBlock
+{
+	vec3	Color;
+	float	R;
+	float	F0;
+	float	BumpScale;
+#ifdef BINDLESS_MATERIAL
+	sampler2D	Texture;
+	sampler2D	NormalMap;
+#endif
+};
 
+#ifndef BINDLESS_MATERIAL
 uniform layout(binding = 0) sampler2D Texture;
 uniform layout(binding = 1) sampler2D NormalMap;
+#endif
 uniform layout(binding = 2) samplerCube EnvMap;
 
 subroutine vec4 color();
@@ -32,9 +46,10 @@ in layout(location = 0) vec3 world_position;
 in layout(location = 1) vec3 world_normal;
 in layout(location = 2) vec2 texcoord;
 
-out layout(location = 0) vec4 colorMatOut;
-out layout(location = 1) vec4 worldPositionOut;
-out layout(location = 2) vec4 worldNormalOut;
+// See DeferredRenderer::initGBuffer. The position is reconstructed from the depth buffer.
+out layout(location = 0) vec4 colorMatOut;		// RGBA8
+out layout(location = 1) vec2 normalOut;		// RG16F
+out layout(location = 2) vec2 materialOut;		// RG8
 
 mat3 tangent_space(vec3 n)
 {
@@ -105,12 +120,8 @@ void main(void)
 
 	if(!gl_FrontFacing) n = -n;
 
-	worldNormalOut.xy = encode_normal(n);
-	worldNormalOut.z = F0;
-	worldNormalOut.w = R;
-	
-	worldPositionOut.xyz = world_position;
-	worldPositionOut.w = gl_FragCoord.z;
+	normalOut = octahedral_encode(n);
+	materialOut = vec2(F0, R);
 	
 	colorMatOut.rgb = c.rgb;
 	colorMatOut.w = 1.0;
@@ -21,19 +21,15 @@ in layout(location = 1) vec3 world_normal;
 in layout(location = 2) vec2 texcoord;
 
 out layout(location = 0) vec4 colorMatOut;
-out layout(location = 1) vec4 worldPositionOut;
-out layout(location = 2) vec4 worldNormalOut;
+out layout(location = 1) vec2 normalOut;
+out layout(location = 2) vec2 materialOut;
 
-vec2 encode_normal(vec3 n)
-{
-    vec2 enc = normalize(n.xy) * (sqrt(-n.z * 0.5 + 0.5));
-    return enc * 0.5 + 0.5;
-}
+#pragma include ../octahedral.glsl
 
 float mix_tex(float t, float p)
 {
 	// Add some perturbation
-	t += dFdx(worldPositionOut.x) * dFdx(worldPositionOut.y);
+	t += dFdx(world_position.x) * dFdx(world_position.y);
 	
 	if(t < p - 0.5)
 		return 0.0;
@@ -73,13 +69,8 @@ void main(void)
 				perturb_normal(normalize(world_normal), texcoord) : 
 				normalize(world_normal);
 	
-	worldNormalOut.xy = encode_normal(n);
-	
-	worldNormalOut.z = F0;
-	worldNormalOut.w = R;
-	
-	worldPositionOut.xyz = world_position;
-	worldPositionOut.w = gl_FragCoord.z;
+	normalOut = octahedral_encode(n);
+	materialOut = vec2(F0, R);
 	
 	float t = mix_tex(world_position.y, 2.0);
 	colorMatOut.rgb = mix(texture(Texture0, texcoord).rgb, texture(Texture1, texcoord).rgb, t);
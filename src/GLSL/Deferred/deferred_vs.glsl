@@ -1,4 +1,6 @@
 #version 430 core
+#pragma include ../octahedral.glsl
+#pragma include ../model_matrix.glsl
 
 layout(std140) uniform Camera
 {
@@ -6,7 +8,7 @@ layout(std140) uniform Camera
 	mat4 ProjectionMatrix;
 };
 
-uniform mat4 ModelMatrix = mat4(1.0);
+uniform bool OctahedralNormals = false; // See Mesh::VertexFormat
 
 in layout(location = 0) vec3 in_position;
 in layout(location = 1) vec3 in_normal;
@@ -18,10 +20,11 @@ out layout(location = 2) vec2 texcoord;
 
 void main(void)
 {
-	vec4 P = ModelMatrix * vec4(in_position, 1.f);
+	mat4 M = model_matrix();
+	vec4 P = M * vec4(in_position, 1.f);
     gl_Position =  ProjectionMatrix * ViewMatrix * P;
 	
 	world_position = P.xyz / P.w;
-	world_normal = mat3(ModelMatrix) * in_normal;
+	world_normal = mat3(M) * (OctahedralNormals ? octahedral_decode(in_normal.xy) : in_normal);
 	texcoord = in_texcoord;
 }
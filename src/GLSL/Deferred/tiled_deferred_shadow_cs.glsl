@@ -1,23 +1,24 @@
 #version 430
 #pragma include ../cook_torrance.glsl
-#pragma include ../encode_normal.glsl
+#pragma include ../octahedral.glsl
 
-#define SHADOWBLOCKCOUNT		10
 #define CUBESHADOWBLOCKCOUNT	3
-// 2 + SHADOWBLOCKCOUNT
 #define CUBESHADOWBLOCKOFFSET	12
 
 #define WORKGROUP_SIZE 16
+#define DEPTH_CELLS		32		// Bits of the depth mask of a workgroup
+#define MAX_TILE_LIGHTS	1024	// Lights kept by a workgroup, falls back to the cluster lists beyond
 
 /*************
- * How input data is laid down :
+ * How input data is laid down (see DeferredRenderer::initGBuffer):
  * ColorMaterial.xyz	=> Color
  * ColorMaterial.w		=> if > 0 : Non transparent
- * PositionDepth.xyz	=> World Position
- * PositionDepth.w		=> Depth
- * Normal.xy			=> Compressed World Normal
- * Normal.z				=> Fresnel Reflectance (F0)
- * Normal.w				=> Roughness (R)
+ * Normal.xy			=> Octahedral World Normal
+ * Material.x			=> Fresnel Reflectance (F0)
+ * Material.y			=> Roughness (R)
+ * Depth				=> Window depth, World Position is reconstructed from it
+ * Output: HDR lit color to LitColor, thresholded color to BloomColor (if Bloom > 0),
+ * tone mapped by post_composite_cs.glsl
 **************/
 
 struct LightStruct
@@ -26,17 +27,52 @@ struct LightStruct
 	vec4		color;
 };
 
-layout(std140, binding = 1) uniform LightBlock
+// Clustered point lights, see Scene and LightClusters.
+layout(std430, binding = 3) readonly buffer PointLights
 {
-	LightStruct	Lights[1024];
+	LightStruct	Lights[];
 };
 
-layout(std140, binding = 2) uniform ShadowBlock
+layout(std430, binding = 4) readonly buffer ClusterBlock
+{
+	uvec2		Clusters[];			// Offset in ClusterLights, light count
+};
+
+layout(std430, binding = 5) readonly buffer ClusterLightBlock
+{
+	uint		ClusterLights[];	// Indices in Lights
+};
+
+struct ShadowStruct
 {
 	vec4		position_range;
 	vec4		color;
 	mat4 		depthMVP;
-} Shadows[SHADOWBLOCKCOUNT];
+	vec4		atlas_rect;		// Tile of the shadow map in ShadowAtlas (offset, scale), no shadow if empty
+};
+
+// Shadow casting SpotLights, see Scene::updateLights
+layout(std430, binding = 6) readonly buffer SpotLights
+{
+	ShadowStruct	Shadows[];
+};
+
+#define MAX_CASCADES 4
+
+struct DirectionalStruct
+{
+	vec4		direction;					// w: Number of cascades
+	vec4		color;
+	vec4		splits;						// View space far distance of each cascade
+	mat4		depthMVP[MAX_CASCADES];
+	vec4		atlas_rect[MAX_CASCADES];
+};
+
+// DirectionalLights with cascaded shadow maps, see DirectionalLight
+layout(std430, binding = 7) readonly buffer DirectionalLights
+{
+	DirectionalStruct	Directionals[];
+};
 
 layout(std140, binding = CUBESHADOWBLOCKOFFSET) uniform CubeShadowBlock
 {
@@ -44,88 +80,112 @@ layout(std140, binding = CUBESHADOWBLOCKOFFSET) uniform CubeShadowBlock
 	vec4		color;
 } CubeShadows[CUBESHADOWBLOCKCOUNT];
 
-uniform float	Time = 0.0f;
-
-uniform unsigned int LightCount = 0;
+// Parameters of the pass, see DeferredRenderer::LightPassParameters
+layout(std140, binding = 1) uniform LightPassBlock
+{
+	mat4		InvViewProjection;
+	mat4		InvProjection;
+	vec3		CameraPosition;
+	uint		DirectionalLightCount;
+	vec3		Ambiant;
+	float		Bloom;
+	float		MinVariance;
+	float		AtmosphericDensity;
+	float		AOThreshold;
+	float		AORadius;
+	float		ClusterNear;
+	float		ClusterFar;
+	int			AOSamples;
+	int			VolumeSamples;
+	uint		ShadowCount;
+	uint		CubeShadowCount;
+	uint		ClusterTilesX;
+	uint		ClusterTilesY;
+	uint		ClusterSlices;
+	uint		ClusterTileSize;
+};
 
-uniform unsigned int ShadowCount = 0;
-uniform unsigned int CubeShadowCount = 0;
-uniform float	MinVariance = 0.0000001;
+uniform float	Time = 0.0f;
 uniform float	DepthBias = 0.01; // In LINEAR space!
 uniform float	ShadowClamp = 0.8;
-uniform int		VolumeSamples = 16;
-uniform float	AtmosphericDensity = 0.005;
-
-uniform float	Bloom = 1.0;
-
-uniform float	Gamma = 2.2;
-uniform float	Exposure = 5.0;
-uniform vec3	Ambiant = vec3(0.06);
 
-uniform int		AOSamples = 8;
-uniform float	AOThreshold = 1.0f;
-uniform float	AORadius = 10.0f;
+layout(binding = 0, rgba8) uniform readonly image2D ColorMaterial;
+layout(binding = 1, rg16f) uniform readonly image2D Normal;
+layout(binding = 2, rg8) uniform readonly image2D Material;
+layout(binding = 3, rgba16f) uniform writeonly image2D LitColor;
+layout(binding = 4, rgba16f) uniform writeonly image2D BloomColor;
 
-uniform vec3	CameraPosition;
-
-layout(binding = 0, rgba32f) uniform image2D ColorMaterial;
-layout(binding = 1, rgba32f) uniform readonly image2D PositionDepth;
-layout(binding = 2, rgba32f) uniform image2D Normal;
-layout(binding = 3, rgba32f) uniform image2D Other;
-
-layout(binding = 3) uniform sampler2D ShadowMaps[SHADOWBLOCKCOUNT];
+layout(binding = 0) uniform sampler2D Depth;
+layout(binding = 3) uniform sampler2D ShadowAtlas;
 layout(binding = CUBESHADOWBLOCKOFFSET) uniform samplerCube CubeShadowMaps[CUBESHADOWBLOCKCOUNT];
 
-// Bounding Box
-shared int bbmin_x;
-shared int bbmin_y;
-shared int bbmin_z;
-shared int bbmax_x;
-shared int bbmax_y;
-shared int bbmax_z;
+const int volume_tile_indexes[9] = {4, 3, 6, 8, 5, 9, 1, 7, 2};
+shared vec3 vol_lights[WORKGROUP_SIZE * WORKGROUP_SIZE]; // Sum of the contributions of all lights
+
+// 2.5D culling of the clustered point lights: a workgroup lies in a single cluster tile (ClusterTileSize is a
+// multiple of WORKGROUP_SIZE), only the slices containing its pixels are read and their lights are kept if they
+// cover a cell of the depth mask of the pixels, between their depth bounds.
+shared uint		tile_min_depth;		// floatBitsToUint of view depths (positive: same order as the floats)
+shared uint		tile_max_depth;
+shared uint		tile_depth_mask;	// DEPTH_CELLS cells between the depth bounds, set if containing a pixel
+shared uint		tile_slices;		// Slices containing a pixel (ClusterSlices <= 32)
+shared uint		tile_light_count;
+shared uvec2	tile_segments[32];	// Lights of each slice in tile_lights (begin, end), ~0u if it overflowed
+shared uint		tile_lights[MAX_TILE_LIGHTS];
 
-// Lights
-shared int local_lights_count; // = 0;
-shared int local_lights[1024];
-shared int lit;
+float square(float f)
+{
+	return f * f;
+}
 
-const int volume_tile_indexes[9] = {4, 3, 6, 8, 5, 9, 1, 7, 2};
-shared float vol_lights[SHADOWBLOCKCOUNT][WORKGROUP_SIZE * WORKGROUP_SIZE];
-shared float vol_cube_lights[CUBESHADOWBLOCKCOUNT][WORKGROUP_SIZE * WORKGROUP_SIZE];
+// View space distance (along -z) of a point of window depth depth
+float view_depth(float depth)
+{
+	vec4 p = InvProjection * vec4(0.0, 0.0, 2.0 * depth - 1.0, 1.0);
+	return -p.z / p.w;
+}
 
-void add_light(int l)
+// Same as LightClusters::getSlice
+uint cluster_slice(float depth)
 {
-	int idx = atomicAdd(local_lights_count, 1);
-	local_lights[idx] = l;
+	return (depth <= ClusterNear) ? 0u :
+		uint(clamp(floor(log(depth / ClusterNear) / log(ClusterFar / ClusterNear) * ClusterSlices), 0.0, float(ClusterSlices - 1u)));
 }
 
-float square(float f)
+uint cluster_index(uvec2 pixel, uint slice)
 {
-	return f * f;
+	uvec2 tile = min(pixel / ClusterTileSize, uvec2(ClusterTilesX, ClusterTilesY) - 1u);
+	return (slice * ClusterTilesY + tile.y) * ClusterTilesX + tile.x;
+}
+
+// Cells of the depth mask covered by [near, far], the mask divides [min_depth, max_depth] in DEPTH_CELLS cells.
+uint depth_cells(float near, float far, float min_depth, float max_depth)
+{
+	if(far < min_depth || near > max_depth)
+		return 0u;
+	float cell = max((max_depth - min_depth) / DEPTH_CELLS, 1e-6);
+	uint first = uint(clamp((near - min_depth) / cell, 0.0, DEPTH_CELLS - 1.0));
+	uint last = uint(clamp((far - min_depth) / cell, 0.0, DEPTH_CELLS - 1.0));
+	return (last == 31u ? 0xFFFFFFFFu : (1u << (last + 1u)) - 1u) & ~((1u << first) - 1u);
 }
 
-bool sphereAABBIntersect(vec3 min, vec3 max, vec3 center, float radius)
+vec3 world_position(ivec2 pixel, ivec2 image_size)
 {
-    float r = radius * radius;
-    if(center.x < min.x) r -= square(center.x - min.x);
-    else if(center.x > max.x) r -= square(center.x - max.x);
-    if(center.y < min.y) r -= square(center.y - min.y);
-    else if(center.y > max.y) r -= square(center.y - max.y);
-    if(center.z < min.z) r -= square(center.z - min.z);
-    else if(center.z > max.z) r -= square(center.z - max.z);
-    return r > 0;
+	float depth = texelFetch(Depth, pixel, 0).r;
+	vec4 p = InvViewProjection * vec4(2.0 * (vec2(pixel) + 0.5) / vec2(image_size) - 1.0, 2.0 * depth - 1.0, 1.0);
+	return p.xyz / p.w;
 }
 
 #pragma include ../poisson_samples.glsl
-float ambiantOcclusion(vec3 p, vec3 n, uvec2 pix, float depth)
+float ambiantOcclusion(vec3 p, vec3 n, uvec2 pix, float depth, ivec2 image_size)
 {
 	float ao = 0.0;
 	
     for (int i = 0; i < AOSamples; ++i)
     {
 		// Get Sample
-        ivec2 samplePixel = ivec2(pix + (poisson16[i] * (AORadius / depth)));
-        vec3 samplePos = imageLoad(PositionDepth, samplePixel).xyz;
+        ivec2 samplePixel = clamp(ivec2(pix + (poisson16[i] * (AORadius / depth))), ivec2(0), image_size - 1);
+        vec3 samplePos = world_position(samplePixel, image_size);
         vec3 sampleDir = normalize(samplePos - p);
 
 		// Compute relevant values
@@ -140,11 +200,6 @@ float ambiantOcclusion(vec3 p, vec3 n, uvec2 pix, float depth)
 	return 1.0 - ao / max(AOSamples, 1);
 }
 
-vec3 exposureToneMapping(vec3 c, float e)
-{
-	return vec3(1.0) - exp(-c * e);
-}
-
 float VSM(float dist, vec2 moments)
 {
 	float d = dist - moments.x;
@@ -157,8 +212,35 @@ float VSM(float dist, vec2 moments)
 	return 1.0;
 }
 
-const int highValue = 2147483646;
-const float boxfactor = 10000.0f; // Minimize the impact of the use of int for bounding boxes
+// rect: Tile of the shadow map in the atlas (offset, scale)
+// sc: Shadow coordinates in the tile, in [0, 1]
+float atlas_visibility(vec4 rect, vec3 sc)
+{
+	if(rect.z == 0.0)
+		return 1.0;
+	// Stays half a texel away from the borders to avoid filtering with the neighbouring tiles
+	vec2 margin = 0.5 / (rect.zw * vec2(textureSize(ShadowAtlas, 0)));
+	vec2 moments = textureLod(ShadowAtlas, rect.xy + clamp(sc.xy, margin, 1.0 - margin) * rect.zw, 0.0).xy;
+	return VSM(sc.z, moments);
+}
+
+float shadow_visibility(int shadow, vec3 sc)
+{
+	return atlas_visibility(Shadows[shadow].atlas_rect, sc);
+}
+
+// Cascade selected by the view space depth of the pixel, no shadow beyond the last one
+float directional_visibility(uint light, vec3 p, float depth)
+{
+	int cascades = int(Directionals[light].direction.w);
+	for(int c = 0; c < cascades; ++c)
+		if(depth <= Directionals[light].splits[c])
+		{
+			vec4 sc = Directionals[light].depthMVP[c] * vec4(p, 1.0);
+			return atlas_visibility(Directionals[light].atlas_rect[c], sc.xyz / sc.w);
+		}
+	return 1.0;
+}
 
 #pragma include ../random3.glsl
 float nothing(vec3 p) { return 1.0f; }
@@ -176,104 +258,102 @@ void main(void)
 	
 	bool isVisible = pixel.x >= 0 && pixel.y >= 0 && pixel.x < image_size.x && pixel.y < image_size.y;
 	vec4 colmat = vec4(0.0);
-	vec4 position = vec4(0.0);
+	vec3 position = vec3(0.0);
 	
-	// Initialize bounding boxes
-	if(local_pixel == uvec2(0, 0))
-	{
-		local_lights_count = 0;
-		
-		bbmin_x = highValue;
-		bbmin_y = highValue;
-		bbmin_z = highValue;
-		bbmax_x = -highValue;
-		bbmax_y = -highValue;
-		bbmax_z = -highValue;
-		lit = 0;
-	}
-
 	// Initialize volume light samples
-	for(int i = 0; i < SHADOWBLOCKCOUNT; ++i)
-		vol_lights[i][gl_LocalInvocationIndex] = 0;
-	for(int i = 0; i < CUBESHADOWBLOCKCOUNT; ++i)
-		vol_cube_lights[i][gl_LocalInvocationIndex] = 0;
-
-	barrier();
+	vol_lights[gl_LocalInvocationIndex] = vec3(0.0);
 		
-	// Compute Bounding Box
 	if(isVisible)
 	{
-		position = imageLoad(PositionDepth, ivec2(pixel));
-		isVisible = isVisible && position.w >= 0.0 && position.w <= 1.0;
-		if(isVisible)
-		{
-			colmat = imageLoad(ColorMaterial, ivec2(pixel));
-			
-			if(colmat.w > 0.0)
-			{
-				ivec3 scaledp = ivec3(boxfactor * position + 1.0);
-				ivec3 scaledm = ivec3(boxfactor * position - 1.0);
-				
-				atomicMin(bbmin_x, scaledm.x);
-				atomicMin(bbmin_y, scaledm.y);
-				atomicMin(bbmin_z, scaledm.z);
-				atomicMax(bbmax_x, scaledp.x);
-				atomicMax(bbmax_y, scaledp.y);
-				atomicMax(bbmax_z, scaledp.z);
-				
-				lit = 1;
-			}
-		}
+		position = world_position(ivec2(pixel), image_size);
+		colmat = imageLoad(ColorMaterial, ivec2(pixel));
+	}
+	
+	// Depth bounds, depth mask and slices of the lit pixels of the workgroup
+	bool lit = isVisible && colmat.w > 0.0;
+	float pixel_depth = lit ? view_depth(texelFetch(Depth, ivec2(pixel), 0).r) : 0.0;
+	uint slice = cluster_slice(pixel_depth);
+	if(gl_LocalInvocationIndex == 0)
+	{
+		tile_min_depth = floatBitsToUint(3.402823e38);
+		tile_max_depth = 0u;
+		tile_depth_mask = 0u;
+		tile_slices = 0u;
+		tile_light_count = 0u;
+	}
+	barrier();
+	if(lit)
+	{
+		atomicMin(tile_min_depth, floatBitsToUint(pixel_depth));
+		atomicMax(tile_max_depth, floatBitsToUint(pixel_depth));
+		atomicOr(tile_slices, 1u << slice);
 	}
 	barrier();
+	float min_depth = uintBitsToFloat(tile_min_depth);
+	float max_depth = uintBitsToFloat(tile_max_depth);
+	if(lit)
+		atomicOr(tile_depth_mask, depth_cells(pixel_depth, pixel_depth, min_depth, max_depth));
+	barrier();
 	
-	// Construct boundingbox
-	if(lit > 0)
+	// Lights of the occupied clusters covering the depth mask, by slice. Same branches for the whole workgroup.
+	vec4 far_point = InvViewProjection * vec4(0.0, 0.0, 1.0, 1.0);
+	vec3 forward = normalize(far_point.xyz / far_point.w - CameraPosition); // View depth: along the center ray
+	uvec2 workgroup_tile = min(gl_WorkGroupID.xy * WORKGROUP_SIZE / ClusterTileSize, uvec2(ClusterTilesX, ClusterTilesY) - 1u);
+	for(uint s = 0u; s < ClusterSlices; ++s)
 	{
-		// FIXME: Problem here!! Wrong min/max, or sphereAABBIntersect bug!
-		vec3 min_bbox = (vec3(bbmin_x, bbmin_y, bbmin_z) - 1.0) / boxfactor;
-		vec3 max_bbox = (vec3(bbmax_x, bbmax_y, bbmax_z) + 1.0) / boxfactor;
-
-		// Test lights
-		for(uint i = gl_LocalInvocationIndex; i < LightCount; i += gl_WorkGroupSize.x * gl_WorkGroupSize.y)
+		if((tile_slices & (1u << s)) == 0u)
+			continue;
+		uvec2 cluster = Clusters[(s * ClusterTilesY + workgroup_tile.y) * ClusterTilesX + workgroup_tile.x];
+		uint begin = tile_light_count;
+		barrier();
+		for(uint i = cluster.x + gl_LocalInvocationIndex; i < cluster.x + cluster.y; i += WORKGROUP_SIZE * WORKGROUP_SIZE)
 		{
-			if(sphereAABBIntersect(min_bbox, max_bbox, Lights[i].position.xyz, Lights[i].position.w))
-				add_light(int(i));
+			uint l = ClusterLights[i];
+			float range = max(Lights[l].position.w, 0.01);
+			float d = dot(Lights[l].position.xyz - CameraPosition, forward);
+			if((depth_cells(d - range, d + range, min_depth, max_depth) & tile_depth_mask) != 0u)
+			{
+				uint slot = atomicAdd(tile_light_count, 1u);
+				if(slot < MAX_TILE_LIGHTS)
+					tile_lights[slot] = l;
+			}
 		}
+		barrier();
+		if(gl_LocalInvocationIndex == 0)
+			tile_segments[s] = tile_light_count <= MAX_TILE_LIGHTS ? uvec2(begin, tile_light_count) : uvec2(~0u);
 	}
-	
 	barrier();
 	
 	//Compute lights' contributions
 	vec4 ColorOut;
-	float depth;
+	float depth = length(CameraPosition - position);
 	if(isVisible)
 	{
 		vec3 color = colmat.xyz;
 		ColorOut = vec4(Ambiant * color, colmat.w);
-		if(colmat.w > 0.0 && lit > 0)
+		if(colmat.w > 0.0)
 		{
-			vec4 data = imageLoad(Normal, ivec2(pixel));
-			vec3 normal = normalize(decode_normal(data.xy));
+			vec3 normal = octahedral_decode(imageLoad(Normal, ivec2(pixel)).xy);
+			vec4 data = vec4(0.0, 0.0, imageLoad(Material, ivec2(pixel)).xy); // z: F0, w: R
 		
 			vec3 V = normalize(CameraPosition - position.xyz);
-			depth = length(CameraPosition - position.xyz);
 			
-			ColorOut *= ambiantOcclusion(position.xyz, normal, pixel, depth);
+			ColorOut *= ambiantOcclusion(position.xyz, normal, pixel, depth, image_size);
 			
-			// Simple Point Lights
-			for(int l2 = 0; l2 < local_lights_count; ++l2)
+			// Simple Point Lights, from the cluster of the pixel (culled by the workgroup if it didn't overflow)
+			uvec2 segment = tile_segments[slice];
+			bool culled = segment.x != ~0u;
+			uvec2 cluster = culled ? uvec2(segment.x, segment.y - segment.x) : Clusters[cluster_index(pixel, slice)];
+			for(uint l2 = cluster.x; l2 < cluster.x + cluster.y; ++l2)
 			{
-				if(Lights[local_lights[l2]].color.w < 0.0)
-					continue;
-				float sqRad = max(Lights[local_lights[l2]].position.w, 0.01);
+				LightStruct light = Lights[culled ? tile_lights[l2] : ClusterLights[l2]];
+				float sqRad = max(light.position.w, 0.01);
 				sqRad *= sqRad;
-				float d = dot(position.xyz - Lights[local_lights[l2]].position.xyz,
-							position.xyz - Lights[local_lights[l2]].position.xyz);
+				float d = dot(position.xyz - light.position.xyz, position.xyz - light.position.xyz);
 				if(d < sqRad)
 					ColorOut.rgb += (1.0 - d/sqRad) * (1.0 - d/sqRad) *
 						cookTorrance(position.xyz, normal, V, color,
-							Lights[local_lights[l2]].position.xyz, Lights[local_lights[l2]].color.rgb,
+							light.position.xyz, light.color.rgb,
 							data.w, data.z);
 			}
 			
@@ -289,8 +369,7 @@ void main(void)
 					(sc.y >= 0 && sc.y <= 1.f) && 
 					r < 0.25 && sc.z > 0.0)
 				{
-					vec2 moments = texture2D(ShadowMaps[shadow], sc.xy).xy;
-					float visibility = VSM(sc.z, moments);
+					float visibility = shadow_visibility(shadow, sc.xyz);
 					
 					float att = (!spotlight) ? 1.0 :
 							max(0.0, (1.0 - square(length(Shadows[shadow].position_range.xyz - position.xyz)/Shadows[shadow].position_range.w)));
@@ -302,6 +381,13 @@ void main(void)
 				}
 			}
 			
+			// Directional lights (Cascaded Shadow Maps)
+			for(uint l = 0; l < DirectionalLightCount; ++l)
+				ColorOut.rgb += directional_visibility(l, position.xyz, pixel_depth) *
+					cookTorrance(position.xyz, normal, V, color,
+						position.xyz - Directionals[l].direction.xyz, Directionals[l].color.rgb,
+						data.w, data.z);
+			
 			// Shadow casting Omnidirectional lights
 			for(int shadow = 0; shadow < CubeShadowCount; ++shadow)
 			{
@@ -326,12 +412,13 @@ void main(void)
 		// Ray march for volumetric lighting
 		if(VolumeSamples > 0)
 		{
+			vec3 vol = vec3(0.0);
 			for(int shadow = 0; shadow < ShadowCount; ++shadow)
 			{
 				vec3 d = (position.xyz - CameraPosition) / VolumeSamples;
 				// Starting point is slitghly moved to avoid visible patterns (banding)
 				vec3 p = CameraPosition - volume_tile_indexes[local_pixel.x % 3 + 3 * (local_pixel.y % 3)] / 9.0 * d;
-				vol_lights[shadow][gl_LocalInvocationIndex] = 0.0;
+				float samples = 0.0;
 				bool spotlight = Shadows[shadow].position_range.w > 0.0;
 				for(int i = 0; i < VolumeSamples; ++i)
 				{
@@ -342,16 +429,16 @@ void main(void)
 									(sc.x - 0.5) * (sc.x - 0.5) + (sc.y - 0.5) * (sc.y - 0.5); // Spot Light
 					if(!((sc.x >= 0 && sc.x <= 1.f) && (sc.y >= 0 && sc.y <= 1.f) && r < 0.25) || sc.z < 0.0)
 						continue;
-					vec2 moments = texture2D(ShadowMaps[shadow], sc.xy).xy;
-					vol_lights[shadow][gl_LocalInvocationIndex] += VSM(sc.z, moments) * ATMOSPHERIC_FUNC(p);
+					samples += shadow_visibility(shadow, sc.xyz) * ATMOSPHERIC_FUNC(p);
 				}
+				vol += samples * Shadows[shadow].color.rgb;
 			}
 			
 			for(int shadow = 0; shadow < CubeShadowCount; ++shadow)
 			{
 				vec3 d = (position.xyz - CameraPosition) / VolumeSamples;
 				vec3 p = CameraPosition - volume_tile_indexes[local_pixel.x % 3 + 3 * (local_pixel.y % 3)] / 9.0 * d ;
-				vol_cube_lights[shadow][gl_LocalInvocationIndex] = 0.0;
+				float samples = 0.0;
 				for(int i = 0; i < VolumeSamples; ++i)
 				{
 					p += d;
@@ -360,10 +447,11 @@ void main(void)
 						continue;
 					vec3 direction = normalize(p - CubeShadows[shadow].position_range.xyz);
 					vec2 moments = texture(CubeShadowMaps[shadow], direction).xy;
-					vol_cube_lights[shadow][gl_LocalInvocationIndex] += 
-						((dist < moments.x + DepthBias) ? 1.0 : 0.0) * ATMOSPHERIC_FUNC(p);
+					samples += ((dist < moments.x + DepthBias) ? 1.0 : 0.0) * ATMOSPHERIC_FUNC(p);
 				}
+				vol += samples * CubeShadows[shadow].color.rgb;
 			}
+			vol_lights[gl_LocalInvocationIndex] = vol;
 		}
 	}
 	
@@ -389,44 +477,19 @@ void main(void)
 				(m.x * p.y), p.y, (p.x * p.y)
 			);
 
-			for(int shadow = 0; shadow < ShadowCount; ++shadow)
-			{
-				mat3 values = mat3(
-					vol_lights[shadow][i - WORKGROUP_SIZE - 1], vol_lights[shadow][i - WORKGROUP_SIZE], vol_lights[shadow][i - WORKGROUP_SIZE + 1],
-					vol_lights[shadow][i - 1],                  vol_lights[shadow][i],                  vol_lights[shadow][i + 1],
-					vol_lights[shadow][i + WORKGROUP_SIZE - 1], vol_lights[shadow][i + WORKGROUP_SIZE], vol_lights[shadow][i + WORKGROUP_SIZE + 1]
-				);
-				mat3 tmp = matrixCompMult(pixels, values);
-				float vol = gathered_pixels * (dot(tmp[0], vec3(1.0)) + dot(tmp[1], vec3(1.0)) + dot(tmp[2], vec3(1.0)));
-				ColorOut.rgb += (depth * AtmosphericDensity * vol / VolumeSamples) * Shadows[shadow].color.rgb;
-			}
-			
-			for(int shadow = 0; shadow < CubeShadowCount; ++shadow)
-			{
-				mat3 values = mat3(
-					vol_cube_lights[shadow][i - WORKGROUP_SIZE - 1], vol_cube_lights[shadow][i - WORKGROUP_SIZE], vol_cube_lights[shadow][i - WORKGROUP_SIZE + 1],
-					vol_cube_lights[shadow][i - 1],                  vol_cube_lights[shadow][i],                  vol_cube_lights[shadow][i + 1],
-					vol_cube_lights[shadow][i + WORKGROUP_SIZE - 1], vol_cube_lights[shadow][i + WORKGROUP_SIZE], vol_cube_lights[shadow][i + WORKGROUP_SIZE + 1]
-				);
-				mat3 tmp = matrixCompMult(pixels, values);
-				float vol = gathered_pixels * (dot(tmp[0], vec3(1.0)) + dot(tmp[1], vec3(1.0)) + dot(tmp[2], vec3(1.0)));
-				ColorOut.rgb += (depth * AtmosphericDensity * vol / VolumeSamples) * CubeShadows[shadow].color.rgb;
-			}
+			vec3 vol = vec3(0.0);
+			for(int y = -1; y <= 1; ++y)
+				for(int x = -1; x <= 1; ++x)
+					if(pixels[y + 1][x + 1] > 0.0)
+						vol += vol_lights[int(i) + y * WORKGROUP_SIZE + x];
+			vol *= gathered_pixels;
+			ColorOut.rgb += (depth * AtmosphericDensity / VolumeSamples) * vol;
 		}
 		
-		// Delay Tone Mapping and Gamma Correction if using Bloom
+		// Storing thresholded color for Bloom
 		if(Bloom > 0.0) 
-		{
-			// Storing thresholded color for Bloom
-			imageStore(Normal, ivec2(pixel), (dot(ColorOut.rgb, vec3(0.2126, 0.7152, 0.0722)) > Bloom) ? ColorOut : vec4(0.0));
-		} else if(Exposure > 0.0) { 
-			// Tone Mapping
-			ColorOut.rgb = exposureToneMapping(ColorOut.rgb, Exposure);
-
-			// Gamma correction (Deactivated for now)
-			//ColorOut.rgb = pow(ColorOut.rgb, vec3(1.0 / Gamma));
-		}
+			imageStore(BloomColor, ivec2(pixel), (dot(ColorOut.rgb, vec3(0.2126, 0.7152, 0.0722)) > Bloom) ? ColorOut : vec4(0.0));
 		
-		imageStore(ColorMaterial, ivec2(pixel), ColorOut);
+		imageStore(LitColor, ivec2(pixel), ColorOut);
 	}
 }
@@ -84,7 +84,7 @@ vec3 basic_normal()
 subroutine(normal)
 vec3 normal_mapping()
 {
-	vec3 map = normalize(texture(NormalMap, texcoord).xyz);
+	vec3 map = texture(NormalMap, texcoord).xyz; // Z is reconstructed (may come from a two channels texture)
 	map = map * 2.0 - 1.0;
     map.z = sqrt(1.0 - dot( map.xy, map.xy ) );
     map.y = -map.y;
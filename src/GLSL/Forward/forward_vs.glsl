@@ -1,4 +1,5 @@
 #version 430 core
+#pragma include ../octahedral.glsl
 
 const int CASCADE_COUNT = 3;
 
@@ -9,6 +10,7 @@ layout(std140) uniform Camera
 };
 
 uniform mat4 ModelMatrix = mat4(1.0);
+uniform bool OctahedralNormals = false; // See Mesh::VertexFormat
 uniform mat4 LightMatrix[CASCADE_COUNT];
 
 in layout(location = 0) vec3 in_position;
@@ -27,7 +29,7 @@ void main(void)
     gl_Position =  ProjectionMatrix * ViewMatrix * P;
 	
 	world_position = P.xyz / P.w;
-	world_normal = mat3(ModelMatrix) * in_normal;
+	world_normal = mat3(ModelMatrix) * (OctahedralNormals ? octahedral_decode(in_normal.xy) : in_normal);
 	texcoord = in_texcoord;
 	
     for(int i = 0; i < CASCADE_COUNT; i++)
@@ -1,8 +1,10 @@
 #version 430 core
+#pragma include ../octahedral.glsl
 
 uniform mat4 ProjectionMatrix;
 uniform mat4 ViewMatrix;
 uniform mat4 ModelMatrix = mat4(1.0);
+uniform bool OctahedralNormals = false; // See Mesh::VertexFormat
 
 in layout(location = 0) vec3 in_position;
 in layout(location = 1) vec3 in_normal;
@@ -18,6 +20,6 @@ void main(void)
     gl_Position =  ProjectionMatrix * ViewMatrix * P;
 	
 	world_position = (ProjectionMatrix * ViewMatrix * P).xyz;//P.xyz / P.w;
-	world_normal = mat3(ModelMatrix) * in_normal;
+	world_normal = mat3(ModelMatrix) * (OctahedralNormals ? octahedral_decode(in_normal.xy) : in_normal);
 	texcoord = in_texcoord;
 }
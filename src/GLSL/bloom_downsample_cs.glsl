@@ -0,0 +1,23 @@
+#version 430
+
+// Downsampling step of the bloom chain (see DeferredRenderer::renderBloom): Level to Level + 1.
+
+#pragma include dual_filter.glsl
+
+#define WORKGROUP_SIZE 16
+
+layout(binding = 0) uniform sampler2D Bloom;
+layout(binding = 0, rgba16f) uniform writeonly image2D Destination; // Level + 1 of Bloom
+
+uniform int Level = 0;
+
+layout (local_size_x = WORKGROUP_SIZE, local_size_y = WORKGROUP_SIZE) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(Destination);
+	if(pixel.x >= size.x || pixel.y >= size.y)
+		return;
+	
+	imageStore(Destination, pixel, dual_downsample(Bloom, (vec2(pixel) + 0.5) / vec2(size), Level));
+}
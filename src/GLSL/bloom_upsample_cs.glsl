@@ -0,0 +1,25 @@
+#version 430
+
+// Upsampling step of the bloom chain (see DeferredRenderer::renderBloom):
+// Level + 1 is added to the downsampled content of Level.
+
+#pragma include dual_filter.glsl
+
+#define WORKGROUP_SIZE 16
+
+layout(binding = 0) uniform sampler2D Bloom;
+layout(binding = 0, rgba16f) uniform image2D Destination; // Level of Bloom
+
+uniform int Level = 0;
+
+layout (local_size_x = WORKGROUP_SIZE, local_size_y = WORKGROUP_SIZE) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(Destination);
+	if(pixel.x >= size.x || pixel.y >= size.y)
+		return;
+	
+	vec4 upsampled = dual_upsample(Bloom, (vec2(pixel) + 0.5) / vec2(size), Level + 1);
+	imageStore(Destination, pixel, imageLoad(Destination, pixel) + upsampled);
+}
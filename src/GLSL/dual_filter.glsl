@@ -0,0 +1,30 @@
+// Dual filtering (Bjorge, Bandwidth-Efficient Rendering, SIGGRAPH 2015):
+// bilinear taps between the texels approximate a wide gaussian with a few fetches per level.
+// The sampler has to clamp to the edges.
+
+// Filtered value of the texel at uv of level lod + 1, from level lod (5 taps)
+vec4 dual_downsample(sampler2D s, vec2 uv, int lod)
+{
+	vec2 o = 1.0 / vec2(textureSize(s, lod));
+	vec4 color = 4.0 * textureLod(s, uv, float(lod));
+	color += textureLod(s, uv + vec2(-o.x, -o.y), float(lod));
+	color += textureLod(s, uv + vec2( o.x, -o.y), float(lod));
+	color += textureLod(s, uv + vec2(-o.x,  o.y), float(lod));
+	color += textureLod(s, uv + vec2( o.x,  o.y), float(lod));
+	return color / 8.0;
+}
+
+// Filtered value at uv of level lod, for the level above it (tent, 8 taps)
+vec4 dual_upsample(sampler2D s, vec2 uv, int lod)
+{
+	vec2 o = 1.0 / vec2(textureSize(s, lod));
+	vec4 color = textureLod(s, uv + vec2(-o.x, 0.0), float(lod));
+	color += textureLod(s, uv + vec2( o.x, 0.0), float(lod));
+	color += textureLod(s, uv + vec2(0.0, -o.y), float(lod));
+	color += textureLod(s, uv + vec2(0.0,  o.y), float(lod));
+	color += 2.0 * textureLod(s, uv + 0.5 * vec2(-o.x, -o.y), float(lod));
+	color += 2.0 * textureLod(s, uv + 0.5 * vec2( o.x, -o.y), float(lod));
+	color += 2.0 * textureLod(s, uv + 0.5 * vec2(-o.x,  o.y), float(lod));
+	color += 2.0 * textureLod(s, uv + 0.5 * vec2( o.x,  o.y), float(lod));
+	return color / 12.0;
+}
@@ -8,6 +8,7 @@
 
 #version 430 core
 
+// Tone mapped color, luma in alpha (see post_composite_cs.glsl)
 layout (binding = 0) uniform sampler2D u_colorTexture; 
 
 uniform vec2 u_texelStep;
@@ -30,7 +31,8 @@ out vec4 fragColor;
 
 void main(void)
 {
-    vec3 rgbM = texture(u_colorTexture, texcoords).rgb;
+    vec4 rgbaM = texture(u_colorTexture, texcoords);
+    vec3 rgbM = rgbaM.rgb;
 
 	// Possibility to toggle FXAA on and off.
 	if (u_fxaaOn == 0)
@@ -41,20 +43,15 @@ void main(void)
 	}
 
 	// Sampling neighbour texels. Offsets are adapted to OpenGL texture coordinates. 
-	vec3 rgbNW = textureOffset(u_colorTexture, texcoords, ivec2(-1, 1)).rgb;
-    vec3 rgbNE = textureOffset(u_colorTexture, texcoords, ivec2(1, 1)).rgb;
-    vec3 rgbSW = textureOffset(u_colorTexture, texcoords, ivec2(-1, -1)).rgb;
-    vec3 rgbSE = textureOffset(u_colorTexture, texcoords, ivec2(1, -1)).rgb;
+	// Luma computed by the previous pass
+	float lumaNW = textureOffset(u_colorTexture, texcoords, ivec2(-1, 1)).a;
+	float lumaNE = textureOffset(u_colorTexture, texcoords, ivec2(1, 1)).a;
+	float lumaSW = textureOffset(u_colorTexture, texcoords, ivec2(-1, -1)).a;
+	float lumaSE = textureOffset(u_colorTexture, texcoords, ivec2(1, -1)).a;
+	float lumaM = rgbaM.a;
 
 	// see http://en.wikipedia.org/wiki/Grayscale
 	const vec3 toLuma = vec3(0.299, 0.587, 0.114);
-	
-	// Convert from RGB to luma.
-	float lumaNW = dot(rgbNW, toLuma);
-	float lumaNE = dot(rgbNE, toLuma);
-	float lumaSW = dot(rgbSW, toLuma);
-	float lumaSE = dot(rgbSE, toLuma);
-	float lumaM = dot(rgbM, toLuma);
 
 	// Gather minimum and maximum luma.
 	float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
@@ -0,0 +1,59 @@
+#version 430 core
+
+// Separable gaussian blur in a single dispatch (see blur() in Blur.hpp):
+// each workgroup loads its tile and a border of kernel_radius texels in shared memory once,
+// blurs the rows (including the ones of the borders above and below the tile), then the columns.
+// Out of place: no race between the workgroups reading the borders of their neighbours.
+
+#pragma include gaussian_blur_9.glsl
+
+#define WORKGROUP_SIZE 16
+#define CACHE_SIZE (WORKGROUP_SIZE + 2 * kernel_radius)
+
+layout(binding = 0) uniform sampler2D Source;
+layout(binding = 0) uniform writeonly image2D Destination; // Format given by the application
+
+uniform int		Level = 0;
+// Blurred region (origin, size), texels outside of it are neither read nor written.
+uniform vec4	Region;
+
+shared vec4 texels[CACHE_SIZE][CACHE_SIZE];
+shared vec4 rows[CACHE_SIZE][WORKGROUP_SIZE];
+
+layout (local_size_x = WORKGROUP_SIZE, local_size_y = WORKGROUP_SIZE) in;
+void main(void)
+{
+	ivec2 origin = ivec2(Region.xy);
+	ivec2 last = origin + ivec2(Region.zw) - 1;
+	ivec2 corner = origin + ivec2(gl_WorkGroupID.xy) * WORKGROUP_SIZE - kernel_radius;
+	ivec2 local = ivec2(gl_LocalInvocationID.xy);
+	
+	// Tile and its borders, clamped to the region
+	for(int y = local.y; y < CACHE_SIZE; y += WORKGROUP_SIZE)
+		for(int x = local.x; x < CACHE_SIZE; x += WORKGROUP_SIZE)
+			texels[y][x] = texelFetch(Source, clamp(corner + ivec2(x, y), origin, last), Level);
+	
+	barrier();
+	
+	// Horizontal pass
+	for(int y = local.y; y < CACHE_SIZE; y += WORKGROUP_SIZE)
+	{
+		int x = local.x + kernel_radius;
+		vec4 color = texels[y][x] * weight[0];
+		for(int i = 1; i <= kernel_radius; i++)
+			color += (texels[y][x - offset[i]] + texels[y][x + offset[i]]) * weight[i];
+		rows[y][local.x] = color;
+	}
+	
+	barrier();
+	
+	// Vertical pass
+	int y = local.y + kernel_radius;
+	vec4 color = rows[y][local.x] * weight[0];
+	for(int i = 1; i <= kernel_radius; i++)
+		color += (rows[y - offset[i]][local.x] + rows[y + offset[i]][local.x]) * weight[i];
+	
+	ivec2 pixel = origin + ivec2(gl_GlobalInvocationID.xy);
+	if(all(lessThanEqual(pixel, last)))
+		imageStore(Destination, pixel, color);
+}
@@ -1,6 +0,0 @@
-#version 430 core
-
-#pragma include gaussian_blur_9.glsl
-
-#define VERTICAL_PASS
-#pragma include gaussian_blur.glsl
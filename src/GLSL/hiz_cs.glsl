@@ -0,0 +1,39 @@
+#version 430
+
+// Builds one level of the Hi-Z pyramid (farthest depth), see HiZ.
+// Level 0 is copied from the depth buffer of the G-Buffer.
+// Texels of the last column/row of an odd sized level are folded in the last texel of the next one,
+// so that the texel of level L covering pixel p is always min(p >> L, size(L) - 1).
+
+#define WORKGROUP_SIZE 16
+
+layout(binding = 0) uniform sampler2D Depth;
+layout(binding = 1, r32f) uniform readonly image2D Previous;
+layout(binding = 2, r32f) uniform writeonly image2D Level;
+
+uniform int		LevelIndex = 0;
+
+layout (local_size_x = WORKGROUP_SIZE, local_size_y = WORKGROUP_SIZE) in;
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(Level);
+	if(texel.x >= size.x || texel.y >= size.y)
+		return;
+	
+	float depth = 0.0;
+	if(LevelIndex == 0)
+	{
+		depth = texelFetch(Depth, texel, 0).r;
+	} else {
+		ivec2 prev_size = imageSize(Previous);
+		ivec2 first = 2 * texel;
+		// Includes the folded column/row
+		ivec2 last = ivec2(texel.x == size.x - 1 ? prev_size.x - 1 : first.x + 1,
+		                   texel.y == size.y - 1 ? prev_size.y - 1 : first.y + 1);
+		for(int y = first.y; y <= last.y; ++y)
+			for(int x = first.x; x <= last.x; ++x)
+				depth = max(depth, imageLoad(Previous, ivec2(x, y)).r);
+	}
+	imageStore(Level, texel, vec4(depth));
+}
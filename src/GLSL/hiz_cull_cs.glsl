@@ -0,0 +1,81 @@
+#version 430
+
+// Tests world space AABBs against the Hi-Z pyramid (see HiZ).
+// ViewProjection has to be the one used to render the depth of the pyramid.
+
+#define WORKGROUP_SIZE 64
+
+layout(std430, binding = 1) readonly buffer Bounds
+{
+	vec4	AABBs[];	// min, max
+};
+
+layout(std430, binding = 2) writeonly buffer Visibility
+{
+	uint	Visible[];
+};
+
+uniform sampler2D	HiZ;
+uniform mat4		ViewProjection;
+uniform uint		Count = 0;
+uniform int			Levels = 1;
+
+layout (local_size_x = WORKGROUP_SIZE) in;
+void main()
+{
+	uint idx = gl_GlobalInvocationID.x;
+	if(idx >= Count)
+		return;
+	
+	vec3 bmin = AABBs[2 * idx].xyz;
+	vec3 bmax = AABBs[2 * idx + 1].xyz;
+	if(any(greaterThan(bmin, bmax))) // Unused slot
+	{
+		Visible[idx] = 0;
+		return;
+	}
+	
+	vec3 smin = vec3(1.0);
+	vec3 smax = vec3(0.0);
+	for(int i = 0; i < 8; ++i)
+	{
+		vec3 corner = vec3((i & 1) == 0 ? bmin.x : bmax.x,
+		                   (i & 2) == 0 ? bmin.y : bmax.y,
+		                   (i & 4) == 0 ? bmin.z : bmax.z);
+		vec4 p = ViewProjection * vec4(corner, 1.0);
+		if(p.w <= 0.0) // Crosses the near plane: can't be occluded
+		{
+			Visible[idx] = 1;
+			return;
+		}
+		p.xyz = 0.5 * (p.xyz / p.w) + 0.5;
+		smin = min(smin, p.xyz);
+		smax = max(smax, p.xyz);
+	}
+	
+	// Out of the screen: frustum culling will take care of it
+	if(any(lessThan(smax.xy, vec2(0.0))) || any(greaterThan(smin.xy, vec2(1.0))))
+	{
+		Visible[idx] = 1;
+		return;
+	}
+	
+	ivec2 size = textureSize(HiZ, 0);
+	ivec2 pmin = clamp(ivec2(floor(clamp(smin.xy, 0.0, 1.0) * vec2(size))), ivec2(0), size - 1);
+	ivec2 pmax = clamp(ivec2(floor(clamp(smax.xy, 0.0, 1.0) * vec2(size))), ivec2(0), size - 1);
+	
+	// Smallest level where the rectangle covers at most 2x2 texels
+	int level = 0;
+	while(level < Levels - 1 && any(greaterThan((pmax >> level) - (pmin >> level), ivec2(1))))
+		++level;
+	
+	ivec2 level_size = textureSize(HiZ, level);
+	ivec2 tmin = min(pmin >> level, level_size - 1);
+	ivec2 tmax = min(pmax >> level, level_size - 1);
+	float depth = 0.0;
+	for(int y = tmin.y; y <= tmax.y; ++y)
+		for(int x = tmin.x; x <= tmax.x; ++x)
+			depth = max(depth, texelFetch(HiZ, ivec2(x, y), level).r);
+	
+	Visible[idx] = smin.z <= depth ? 1 : 0;
+}
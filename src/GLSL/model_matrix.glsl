@@ -0,0 +1,16 @@
+// Model matrices of the MeshRenderers, see Scene::updateModelMatrices.
+// ModelIndex is set per draw (see Material::setModelIndex), ModelMatrix is
+// used instead when it is negative (draws not issued by a MeshRenderer).
+
+layout(std430, binding = 0) readonly buffer ModelMatrices
+{
+	mat4 ModelMatricesData[];
+};
+
+uniform mat4 ModelMatrix = mat4(1.0);
+uniform int ModelIndex = -1;
+
+mat4 model_matrix()
+{
+	return ModelIndex < 0 ? ModelMatrix : ModelMatricesData[ModelIndex];
+}
@@ -0,0 +1,43 @@
+#version 430
+
+// Last pass of the post process chain (see DeferredRenderer::renderComposite), fused:
+// last upsampling step of the bloom, blend, tone mapping and luma of the FXAA.
+
+#pragma include dual_filter.glsl
+
+#define WORKGROUP_SIZE 16
+
+layout(binding = 0) uniform sampler2D Color;	// HDR
+layout(binding = 1) uniform sampler2D Bloom;
+layout(binding = 0, rgba8) uniform writeonly image2D Output; // Tone mapped color, luma in alpha
+
+uniform float	Exposure = 2.0;
+uniform int		BloomLevel = 0;			// Top of the upsampled bloom chain, 0: No bloom
+uniform float	BloomIntensity = 1.0;
+
+uniform float	Gamma = 2.2;
+
+vec3 exposureToneMapping(vec3 c, float e)
+{
+	return vec3(1.0) - exp(-c * e);
+}
+
+layout (local_size_x = WORKGROUP_SIZE, local_size_y = WORKGROUP_SIZE) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(Output);
+	if(pixel.x >= size.x || pixel.y >= size.y)
+		return;
+	
+	vec3 color = texelFetch(Color, pixel, 0).rgb;
+	if(BloomLevel > 0)
+		color += BloomIntensity * dual_upsample(Bloom, (vec2(pixel) + 0.5) / vec2(size), BloomLevel).rgb;
+	color = exposureToneMapping(color, Exposure);
+	
+	// Gamma correction (Deactivated for now)
+	//color = pow(color, vec3(1.0 / Gamma));
+	
+	// Same weights as fxaa_fs.glsl
+	imageStore(Output, pixel, vec4(color, dot(color, vec3(0.299, 0.587, 0.114))));
+}
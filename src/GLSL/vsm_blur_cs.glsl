@@ -0,0 +1,37 @@
+#version 430
+
+// One pass of the separable blur of a variance shadow map tile, see ShadowAtlas::blur.
+// Reads the moments from Source and writes them to another texture:
+// no in place blur, so no race between the workgroups.
+
+#pragma include gaussian_blur_9.glsl
+
+#define WORKGROUP_SIZE 16
+
+layout(binding = 0) uniform sampler2D Source;
+layout(binding = 0) uniform writeonly image2D Destination; // RG16F or RG32F
+
+uniform vec4	SourceRegion;			// Origin (xy) and size (zw) of the tile in Source, in texels
+uniform vec2	DestinationOrigin;
+uniform vec2	Direction = vec2(1.0, 0.0);
+
+layout (local_size_x = WORKGROUP_SIZE, local_size_y = WORKGROUP_SIZE) in;
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = ivec2(SourceRegion.zw);
+	if(texel.x >= size.x || texel.y >= size.y)
+		return;
+
+	ivec2 origin = ivec2(SourceRegion.xy);
+	ivec2 dir = ivec2(Direction);
+	vec2 moments = weight[0] * texelFetch(Source, origin + texel, 0).xy;
+	for(int i = 1; i <= kernel_radius; ++i)
+	{
+		// Clamped to the tile: the neighbouring tiles belong to other lights.
+		moments += weight[i] * texelFetch(Source, origin + clamp(texel - offset[i] * dir, ivec2(0), size - 1), 0).xy;
+		moments += weight[i] * texelFetch(Source, origin + clamp(texel + offset[i] * dir, ivec2(0), size - 1), 0).xy;
+	}
+
+	imageStore(Destination, ivec2(DestinationOrigin) + texel, vec4(moments, 0.0, 1.0));
+}
@@ -0,0 +1,94 @@
+#include <BindlessTextures.hpp>
+
+#include <cstring>
+#include <unordered_map>
+
+#include <Log.hpp>
+
+namespace BindlessTextures
+{
+
+namespace
+{
+
+std::unordered_map<GLuint, GLuint64>				_handles;	///< By texture name
+std::unordered_map<const Texture*, const Texture*>	_deferred;	///< Placeholders (the name of a texture may change until it is ready)
+size_t												_generation = 0;
+
+GLuint64 resident_handle(const Texture& t)
+{
+	auto it = _handles.find(t.getName());
+	if(it != _handles.end())
+		return it->second;
+	
+	const GLuint64 handle = glGetTextureHandleARB(t.getName());
+	if(handle == 0)
+	{
+		Log::error("BindlessTextures: Could not get the handle of texture ", t.getName(), ".");
+		return 0;
+	}
+	glMakeTextureHandleResidentARB(handle);
+	_handles[t.getName()] = handle;
+	return handle;
+}
+
+}
+
+bool isSupported()
+{
+	static int bindless = -1;
+	if(bindless < 0)
+	{
+		bindless = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for(GLint i = 0; i < count; ++i)
+			if(std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_ARB_bindless_texture") == 0)
+				bindless = 1;
+	}
+	return bindless == 1;
+}
+
+GLuint64 getHandle(const Texture& t)
+{
+	if(!isSupported())
+		return 0;
+	
+	auto it = _deferred.find(&t);
+	return resident_handle(it != _deferred.end() ? *it->second : t);
+}
+
+void defer(const Texture& t, const Texture& placeholder)
+{
+	if(_handles.count(t.getName()) > 0)
+		Log::warn("BindlessTextures: Texture ", t.getName(), " already has a handle, it can't be specified anymore.");
+	_deferred[&t] = &placeholder;
+}
+
+void ready(const Texture& t)
+{
+	if(_deferred.erase(&t) > 0)
+		++_generation;
+}
+
+void release(const Texture& t)
+{
+	_deferred.erase(&t);
+	auto it = _handles.find(t.getName());
+	if(it == _handles.end())
+		return;
+	glMakeTextureHandleNonResidentARB(it->second);
+	_handles.erase(it);
+}
+
+size_t getGeneration()
+{
+	return _generation;
+}
+
+size_t getResidentCount()
+{
+	return _handles.size();
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <Texture.hpp>
+
+/**
+ * Resident handles of textures (ARB_bindless_texture), used by Material to store its
+ * textures in the MaterialBlock instead of binding them to texture units on each use.
+ * Shaders opt in by declaring their material samplers in the block (see deferred_fs.glsl).
+ *
+ * Creating a handle makes the texture immutable: textures that will be (re)specified
+ * later (e.g. streamed by AsyncLoader) have to be deferred to a placeholder until they are ready.
+ * Handles have to be released before the texture is destroyed.
+**/
+namespace BindlessTextures
+{
+
+/// @return true if the driver supports ARB_bindless_texture
+bool isSupported();
+
+/**
+ * @return Resident handle of t (of its placeholder if t isn't ready), created if needed.
+ *         0 if bindless textures aren't supported.
+**/
+GLuint64 getHandle(const Texture& t);
+
+/**
+ * The handle of placeholder will be used for t until ready(t).
+**/
+void defer(const Texture& t, const Texture& placeholder);
+
+/**
+ * t won't be specified anymore, the handles of deferred textures are updated.
+**/
+void ready(const Texture& t);
+
+/**
+ * Makes the handle of t non resident and forgets it. Has to be called before its destruction.
+**/
+void release(const Texture& t);
+
+/**
+ * Incremented whenever a handle returned by getHandle may have changed (see ready()).
+ * Used by materials to know when to update their handles.
+**/
+size_t getGeneration();
+
+/// @return Number of resident handles
+size_t getResidentCount();
+
+}
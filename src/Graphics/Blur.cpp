@@ -1,68 +1,40 @@
 #include <Blur.hpp>
 
+#include <algorithm>
+
 #include <Resources.hpp>
 
-void blur(const Texture2D& t, size_t resx, size_t resy, unsigned int level)
+namespace
 {
-	assert(resx > 0);
-	if(resy == 0)
-		resy = resx;
-	
-	resx /= std::pow(2.0, level);
-	resy /= std::pow(2.0, level);
-	
-	ComputeShader& GaussianBlurH = Resources::getShader<ComputeShader>("GaussianBlurH");
-	if(!GaussianBlurH)
-	{
-		GaussianBlurH.loadFromFile("src/GLSL/gaussian_blur_h_cs.glsl");
-		GaussianBlurH.compile();
-	}
-	ComputeShader& GaussianBlurV = Resources::getShader<ComputeShader>("GaussianBlurV");
-	if(!GaussianBlurV)
-	{
-		GaussianBlurV.loadFromFile("src/GLSL/gaussian_blur_v_cs.glsl");
-		GaussianBlurV.compile();
-	}
-	
-	t.bindImage(0, level, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-	GaussianBlurH.getProgram().setUniform("Texture", (int) 0);
-	GaussianBlurH.compute(resx / GaussianBlurH.getWorkgroupSize().x + 1, resy, 1);
-	GaussianBlurH.memoryBarrier();
-	GaussianBlurV.getProgram().setUniform("Texture", (int) 0);
-	GaussianBlurV.compute(resx, resy / GaussianBlurV.getWorkgroupSize().y + 1, 1);
-	GaussianBlurV.memoryBarrier();
+
+/**
+ * @return Compute shader of handle, loaded from path on first use (possibly from the ProgramCache).
+**/
+ComputeShader& get_shader(Resources::ShaderHandle handle, const std::string& path)
+{
+	if(!Resources::isLoaded(handle))
+		return Resources::load<ComputeShader>(Resources::_shaders[handle].name, path);
+	return Resources::getShader<ComputeShader>(handle);
+}
+
 }
 
-void blur(const CubeMap& t, size_t resx, size_t resy, unsigned int level)
+void blur(const Texture2D& source, const Texture2D& destination, GLenum format, size_t resx, size_t resy, unsigned int level)
 {
 	assert(resx > 0);
 	if(resy == 0)
 		resy = resx;
 	
-	resx /= std::pow(2.0, level);
-	resy /= std::pow(2.0, level);
+	resx = std::max<size_t>(1, resx >> level);
+	resy = std::max<size_t>(1, resy >> level);
 	
-	ComputeShader& GaussianBlurH = Resources::getShader<ComputeShader>("GaussianBlurH");
-	if(!GaussianBlurH)
-	{
-		GaussianBlurH.loadFromFile("src/GLSL/gaussian_blur_h_cs.glsl");
-		GaussianBlurH.compile();
-	}
-	ComputeShader& GaussianBlurV = Resources::getShader<ComputeShader>("GaussianBlurV");
-	if(!GaussianBlurV)
-	{
-		GaussianBlurV.loadFromFile("src/GLSL/gaussian_blur_v_cs.glsl");
-		GaussianBlurV.compile();
-	}
+	static const auto GaussianBlurHandle = Resources::getShaderHandle("GaussianBlur");
+	ComputeShader& GaussianBlur = get_shader(GaussianBlurHandle, "src/GLSL/gaussian_blur_cs.glsl");
+	const glm::ivec3 size = Resources::getWorkgroupSize(GaussianBlur);
 	
-	for(int i = 0; i < 6; ++i)
-	{
-		t.bindImage(0, level, GL_FALSE, i, GL_READ_WRITE, GL_RGBA32F);
-		GaussianBlurH.getProgram().setUniform("Texture", (int) 0);
-		GaussianBlurH.compute(resx / GaussianBlurH.getWorkgroupSize().x + 1, resy, 1);
-		GaussianBlurH.memoryBarrier();
-		GaussianBlurV.getProgram().setUniform("Texture", (int) 0);
-		GaussianBlurV.compute(resx, resy / GaussianBlurV.getWorkgroupSize().y + 1, 1);
-		GaussianBlurV.memoryBarrier();
-	}
+	source.bind(0);
+	destination.bindImage(0, level, GL_FALSE, 0, GL_WRITE_ONLY, format);
+	GaussianBlur.getProgram().setUniform("Level", static_cast<int>(level));
+	GaussianBlur.getProgram().setUniform("Region", glm::vec4{0.0f, 0.0f, resx, resy});
+	GaussianBlur.compute(Resources::groupCount(resx, size.x), Resources::groupCount(resy, size.y), 1);
 }
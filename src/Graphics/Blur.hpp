@@ -1,11 +1,12 @@
 #pragma once
 
 #include <Texture2D.hpp>
-#include <CubeMap.hpp>
-
-void blur(const Texture2D& t, size_t resx, size_t resy = 0, unsigned int level = 0);
 
 /**
- * This is very wrong, it just blur each face separatly.
+ * Gaussian blur (9 taps) of a level of source to the same level of destination, in a single dispatch:
+ * each workgroup reads its tile (and borders) once into shared memory, see gaussian_blur_cs.glsl.
+ * @param format Internal format of destination
+ * No memory barrier is issued: the caller synchronizes the reads of destination (see RenderGraph).
+ * @param resx, resy Resolution of the level 0
 **/
-void blur(const CubeMap& t, size_t resx, size_t resy = 0, unsigned int level = 0);
+void blur(const Texture2D& source, const Texture2D& destination, GLenum format, size_t resx, size_t resy = 0, unsigned int level = 0);
@@ -33,10 +33,14 @@ public:
 	void reset();
 	
 	inline float getFoV()                         const { return _fov; }
+	inline float getRatio()                       const { return _ratio; }
+	inline float getNear()                        const { return _near; }
+	inline float getFar()                         const { return _far; }
 	inline const glm::mat4& getViewMatrix()       const { return _viewMatrix; }
 	inline const glm::mat4& getProjectionMatrix() const { return _projection; }
 	inline const glm::mat4& getInvProjection()    const { return _invProjection; }
 	inline const glm::mat4& getInvViewMatrix()    const { return _invViewMatrix; }
+	inline const glm::mat4& getInvViewProjection() const { return _invViewProjection; }
 	inline auto& getGPUBuffer()                         { return _cameraBuffer; }
 	inline const auto& getGPUBuffer()             const { return _cameraBuffer; }
 	
@@ -0,0 +1,163 @@
+#include <DirectionalLight.hpp>
+
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp> // glm::lookAt, glm::ortho
+
+DirectionalLight::DirectionalLight() :
+	_entity(get_owner<DirectionalLight>(*this))
+{
+}
+
+DirectionalLight::DirectionalLight(const nlohmann::json& json) :
+	dynamic(json["dynamic"]),
+	cascadeCount(json["cascades"]),
+	splitLambda(json["lambda"]),
+	shadowDistance(json["distance"]),
+	resolution(json["resolution"]),
+	_entity(get_owner<DirectionalLight>(*this)),
+	_color(vec3(json["color"]))
+{
+}
+
+nlohmann::json DirectionalLight::json() const
+{
+	return {
+		{"color", tojson(getColor())},
+		{"cascades", cascadeCount},
+		{"lambda", splitLambda},
+		{"distance", shadowDistance},
+		{"resolution", resolution},
+		{"dynamic", dynamic}
+	};
+}
+
+glm::vec3 DirectionalLight::getDirection() const
+{
+	return glm::normalize(glm::vec3{getTransformation().getRotation() * glm::vec4(0, 0, 1, 1)});
+}
+
+DirectionalLight::GPUData DirectionalLight::getGPUData() const
+{
+	GPUData data;
+	data.direction = glm::vec4{getDirection(), static_cast<float>(getCascadeCount())};
+	data.color = glm::vec4{getColor(), 0.0f};
+	data.splits = glm::vec4{0.0f};
+	for(size_t i = 0; i < MaxCascades; ++i)
+	{
+		const bool used = i < getCascadeCount();
+		data.splits[i] = used ? _cascades[i].split : 0.0f;
+		data.depthMVP[i] = _cascades[i].biasedVPMatrix;
+		data.atlas_rect[i] = used ? _cascades[i].rect : glm::vec4{0.0f};
+	}
+	return data;
+}
+
+void DirectionalLight::updateCascades(const Camera& c, const AABB<glm::vec3>& casters, const ShadowAtlas::Tile* tiles)
+{
+	const size_t count = getCascadeCount();
+	const float z_near = c.getNear();
+	const float z_far = shadowDistance > z_near ? std::min(shadowDistance, c.getFar()) : c.getFar();
+	const float tan_y = std::tan(0.5f * glm::radians(c.getFoV()));
+	const float tan_x = tan_y * c.getRatio();
+
+	const glm::vec3 direction = getDirection();
+	glm::vec3 up{0, 1, 0};
+	if(glm::cross(direction, up) == glm::vec3(0.0))
+		up = {0, 0, 1};
+	// Light space without translation: the centers of the cascades are snapped in it.
+	const glm::mat4 rotation = glm::lookAt(glm::vec3{0.0f}, direction, up);
+	const glm::mat4 inv_rotation = glm::transpose(rotation);
+
+	float slice_near = z_near;
+	for(size_t i = 0; i < count; ++i)
+	{
+		// Practical split scheme: blend of the logarithmic and uniform splits
+		const float t = static_cast<float>(i + 1) / count;
+		const float slice_far = splitLambda * z_near * std::pow(z_far / z_near, t) + (1.0f - splitLambda) * (z_near + (z_far - z_near) * t);
+
+		// Bounding sphere of the slice, its radius is rounded to avoid tiny variations of the projection.
+		glm::vec3 corners[8];
+		glm::vec3 center{0.0f};
+		for(int j = 0; j < 8; ++j)
+		{
+			const float d = (j & 4) ? slice_far : slice_near;
+			const glm::vec4 p{((j & 1) ? d : -d) * tan_x, ((j & 2) ? d : -d) * tan_y, -d, 1.0f};
+			corners[j] = glm::vec3{c.getInvViewMatrix() * p};
+			center += corners[j] / 8.0f;
+		}
+		float radius = 0.0f;
+		for(const auto& p : corners)
+			radius = std::max(radius, glm::distance(center, p));
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// Moves the center by whole texels of the shadow map (also along the direction: keeps the depths,
+		// and so the hash, constant for small camera movements)
+		const float size = static_cast<float>(tiles[i].size > 0 ? tiles[i].size : resolution);
+		const float texel = 2.0f * radius / size;
+		glm::vec4 light_center = rotation * glm::vec4{center, 1.0f};
+		light_center.x = std::floor(light_center.x / texel) * texel;
+		light_center.y = std::floor(light_center.y / texel) * texel;
+		light_center.z = std::floor(light_center.z / texel) * texel;
+		center = glm::vec3{inv_rotation * light_center};
+
+		// Casters between the light and the slice still have to be in the shadow map.
+		float back = radius;
+		for(const auto& p : casters.getBounds())
+			back = std::max(back, glm::dot(center - p, direction));
+
+		const glm::vec3 eye = center - back * direction;
+		auto& cascade = _cascades[i];
+		cascade.split = slice_far;
+		cascade.VPMatrix = glm::ortho(-radius, radius, -radius, radius, 0.0f, back + radius) * glm::lookAt(eye, center, up);
+		cascade.biasedVPMatrix = ShadowAtlas::BiasMatrix * cascade.VPMatrix;
+
+		slice_near = slice_far;
+	}
+}
+
+void DirectionalLight::invalidateShadowMap()
+{
+	for(auto& cascade : _cascades)
+	{
+		cascade.hash = 0;
+		cascade.tile = ShadowAtlas::Tile{};
+	}
+}
+
+void DirectionalLight::setShadowTile(const ShadowAtlas& atlas, size_t i, const ShadowAtlas::Tile& tile)
+{
+	_cascades[i].tile = tile;
+	_cascades[i].rect = tile.size > 0 ? atlas.getRect(tile) : glm::vec4{0.0f};
+}
+
+void DirectionalLight::drawShadowMap(const ShadowAtlas& atlas, size_t i, const ShadowAtlas::Tile& tile, size_t hash, const std::vector<const MeshRenderer*>& casters)
+{
+	auto& cascade = _cascades[i];
+	setShadowTile(atlas, i, tile);
+	cascade.hash = hash;
+
+	cascade.timing.begin(Query::Target::TimeElapsed);
+	atlas.draw(tile, cascade.VPMatrix, casters);
+	cascade.timing.end();
+	cascade.timingPending = true;
+}
+
+void DirectionalLight::updateShadowMapTime()
+{
+	for(auto& cascade : _cascades)
+	{
+		if(!cascade.timingPending)
+			continue;
+		cascade.lastTiming = cascade.timing.get<GLuint64>();
+		cascade.timingPending = false;
+	}
+}
+
+GLuint64 DirectionalLight::getShadowMapTime() const
+{
+	GLuint64 total = 0;
+	for(size_t i = 0; i < getCascadeCount(); ++i)
+		total += _cascades[i].lastTiming;
+	return total;
+}
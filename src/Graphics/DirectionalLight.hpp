@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <MeshRenderer.hpp>
+#include <ShadowAtlas.hpp>
+#include <Camera.hpp>
+#include <Query.hpp>
+#include <serialization.hpp>
+
+/**
+ * DirectionalLight
+ *
+ * Light infinitely far away (sun), shining along the Z axis of its Transformation.
+ * Its shadows use Cascaded Shadow Maps: the view frustum of the camera is divided in
+ * cascadeCount slices (see updateCascades()), each one covered by an orthographic
+ * variance shadow map in a tile of the ShadowAtlas of the Scene.
+ * The projection of a cascade only moves by whole texels and its size is constant
+ * while the camera rotates, so its shadow map doesn't shimmer and, like the ones of
+ * the SpotLights, is only redrawn when its hash changes (see ShadowAtlas::hash()).
+**/
+class DirectionalLight
+{
+public:
+	static constexpr size_t MaxCascades = 4;
+
+	struct GPUData
+	{
+		glm::vec4	direction;						///< w: Number of cascades
+		glm::vec4	color;
+		glm::vec4	splits;							///< View space far distance of each cascade
+		glm::mat4	depthMVP[MaxCascades];			///< Biased ViewProjection matrix of each cascade
+		glm::vec4	atlas_rect[MaxCascades];		///< See ShadowAtlas::getRect() (no shadow if empty)
+	};
+
+	struct Cascade
+	{
+		float				split = 0.0f;			///< View space far distance of the slice
+		glm::mat4			VPMatrix{1.0f};
+		glm::mat4			biasedVPMatrix{1.0f};
+		ShadowAtlas::Tile	tile;					///< Of the last drawShadowMap()
+		glm::vec4			rect{0.0f};				///< Of tile, see ShadowAtlas::getRect()
+		size_t				hash = 0;				///< Of the last drawShadowMap()
+		Query				timing;
+		bool				timingPending = false;
+		GLuint64			lastTiming = 0;
+	};
+
+	// Public attributes
+	bool			dynamic = false;		///< Redraws the shadow maps each frame, even if nothing moved (e.g. animated meshes)
+	size_t			cascadeCount = 3;		///< In [1, MaxCascades]
+	float			splitLambda = 0.75f;	///< Blend between the uniform (0) and logarithmic (1) splits of the view frustum
+	float			shadowDistance = 0.0f;	///< Shadows are limited to this distance from the camera (0: far plane of the camera)
+	unsigned int	resolution = 1024;		///< Resolution of the shadow map of each cascade
+
+	DirectionalLight();
+	DirectionalLight(const nlohmann::json& json);
+	~DirectionalLight() =default;
+
+	nlohmann::json json() const;
+
+	inline glm::vec3& getColor() { return _color; }
+	inline const glm::vec3& getColor() const { return _color; }
+	inline void setColor(const glm::vec3& col) { _color = col; }
+
+	/// @return World space direction of the light
+	glm::vec3 getDirection() const;
+
+	inline size_t getCascadeCount() const { return std::min(std::max<size_t>(cascadeCount, 1), MaxCascades); }
+	inline const Cascade& getCascade(size_t i) const { return _cascades[i]; }
+
+	/// @return DirectionalLight's data structured for GPU use.
+	GPUData getGPUData() const;
+
+	/**
+	 * Splits the view frustum of c in getCascadeCount() slices and fits an orthographic projection
+	 * around the bounding sphere of each slice (constant size whatever the orientation of the camera),
+	 * with its center snapped to the texels of its shadow map.
+	 * @param casters Bounds of all the shadow casters, extends the projections towards the light.
+	 * @param tiles Tiles allocated to each cascade, used to snap the projections.
+	**/
+	void updateCascades(const Camera& c, const AABB<glm::vec3>& casters, const ShadowAtlas::Tile* tiles);
+
+	/// @return true if the shadow map of cascade i has to be redrawn, hash being the ShadowAtlas::hash() of its casters.
+	inline bool isShadowMapOutdated(size_t i, const ShadowAtlas::Tile& tile, size_t hash) const
+	{
+		return dynamic || tile != _cascades[i].tile || hash != _cascades[i].hash;
+	}
+
+	/// Forces the next update of the shadow maps.
+	void invalidateShadowMap();
+
+	/**
+	 * Assigns a tile of the atlas to cascade i, without drawing it.
+	**/
+	void setShadowTile(const ShadowAtlas& atlas, size_t i, const ShadowAtlas::Tile& tile);
+
+	/**
+	 * Draws casters to the shadow map of cascade i, in tile of atlas.
+	 * @param casters MeshRenderers in the frustum of the cascade (see ShadowAtlas::cull())
+	 * @param hash ShadowAtlas::hash() of casters
+	**/
+	void drawShadowMap(const ShadowAtlas& atlas, size_t i, const ShadowAtlas::Tile& tile, size_t hash, const std::vector<const MeshRenderer*>& casters);
+
+	/// Fetches the results of the timer queries of the last drawShadowMap() calls, once per frame.
+	void updateShadowMapTime();
+
+	/// @return GPU time of the last drawShadowMap() of all the cascades, in ns.
+	GLuint64 getShadowMapTime() const;
+
+protected:
+	EntityID							_entity = invalid_entity;
+
+	glm::vec3							_color = glm::vec3(1.f);
+	std::array<Cascade, MaxCascades>	_cascades;
+
+	inline const Transformation& getTransformation() const { return entities[_entity].get<Transformation>(); }
+};
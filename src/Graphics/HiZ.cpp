@@ -0,0 +1,129 @@
+#include <HiZ.hpp>
+
+#include <Resources.hpp>
+#include <ComponentIterator.hpp>
+#include <MeshRenderer.hpp>
+
+HiZ::~HiZ()
+{
+	if(_fence != nullptr)
+		glDeleteSync(_fence);
+}
+
+void HiZ::update(const Texture2D& depth, size_t width, size_t height, const glm::mat4& viewProjection)
+{
+	if(_fence != nullptr) // Previous results still not available: skip this frame
+		return;
+	
+	if(width != _width || height != _height)
+		create_pyramid(width, height);
+	
+	build_pyramid(depth);
+	cull(viewProjection);
+	_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void HiZ::fetch()
+{
+	if(_fence == nullptr)
+		return;
+	
+	const GLenum status = glClientWaitSync(_fence, 0, 0);
+	if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return;
+	glDeleteSync(_fence);
+	_fence = nullptr;
+	
+	_visibility.resize(_pending);
+	_visibilityBuffer.bind();
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _pending * sizeof(GLuint), _visibility.data());
+}
+
+size_t HiZ::getOccludedCount() const
+{
+	size_t count = 0;
+	for(ComponentID id = 0; id < _visibility.size(); ++id)
+		if(_visibility[id] == 0 && is_valid<MeshRenderer>(id))
+			++count;
+	return count;
+}
+
+void HiZ::create_pyramid(size_t width, size_t height)
+{
+	_width = width;
+	_height = height;
+	_levels = 1;
+	while((std::max(width, height) >> _levels) > 0)
+		++_levels;
+	
+	_pyramid = Texture2D();
+	_pyramid.setPixelType(Texture::PixelType::Float);
+	_pyramid.create(nullptr, width, height, GL_R32F, GL_RED, false);
+	_pyramid.bind();
+	for(size_t l = 1; l < _levels; ++l)
+		glTexImage2D(GL_TEXTURE_2D, l, GL_R32F, std::max<GLsizei>(1, width >> l), std::max<GLsizei>(1, height >> l), 0, GL_RED, GL_FLOAT, nullptr);
+	_pyramid.set(Texture::Parameter::BaseLevel, 0);
+	_pyramid.set(Texture::Parameter::MaxLevel, _levels - 1);
+	_pyramid.set(Texture::Parameter::MinFilter, GL_NEAREST_MIPMAP_NEAREST);
+	_pyramid.set(Texture::Parameter::MagFilter, GL_NEAREST);
+	_pyramid.set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
+	_pyramid.set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
+	_pyramid.unbind();
+}
+
+void HiZ::build_pyramid(const Texture2D& depth)
+{
+	static const auto HiZBuildHandle = Resources::getShaderHandle("HiZBuild");
+	ComputeShader& build = Resources::getShader<ComputeShader>(HiZBuildHandle);
+	
+	const glm::ivec3 size = Resources::getWorkgroupSize(build); // Not set by the ProgramCache
+	
+	depth.bind(0);
+	for(size_t l = 0; l < _levels; ++l)
+	{
+		if(l > 0)
+			_pyramid.bindImage(1, l - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		_pyramid.bindImage(2, l, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		build.getProgram().setUniform("LevelIndex", static_cast<int>(l));
+		const size_t w = std::max<size_t>(1, _width >> l);
+		const size_t h = std::max<size_t>(1, _height >> l);
+		build.compute(Resources::groupCount(w, size.x), Resources::groupCount(h, size.y), 1);
+		build.memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	build.memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void HiZ::cull(const glm::mat4& viewProjection)
+{
+	_pending = impl::components<MeshRenderer>.size();
+	_bounds.assign(2 * _pending, glm::vec4{1.0f, 1.0f, 1.0f, 0.0f});
+	for(size_t i = 0; i < _pending; ++i) // Unused slots: min > max
+		_bounds[2 * i + 1] = glm::vec4{0.0f};
+	for(const auto& it : ComponentIterator<MeshRenderer>{})
+	{
+		const auto aabb = it.getAABB();
+		_bounds[2 * get_id(it)] = glm::vec4{aabb.min, 0.0f};
+		_bounds[2 * get_id(it) + 1] = glm::vec4{aabb.max, 0.0f};
+	}
+	
+	if(!_boundsBuffer)
+	{
+		_boundsBuffer.init();
+		_visibilityBuffer.init();
+	}
+	_boundsBuffer.data(_bounds.data(), _bounds.size() * sizeof(glm::vec4), Buffer::Usage::StreamDraw);
+	_visibilityBuffer.data(nullptr, _pending * sizeof(GLuint), Buffer::Usage::StreamRead);
+	_boundsBuffer.bind(BoundsBinding);
+	_visibilityBuffer.bind(VisibilityBinding);
+	
+	static const auto HiZCullHandle = Resources::getShaderHandle("HiZCull");
+	ComputeShader& cull = Resources::getShader<ComputeShader>(HiZCullHandle);
+	
+	_pyramid.bind(0);
+	cull.getProgram().setUniform("HiZ", 0);
+	cull.getProgram().setUniform("ViewProjection", viewProjection);
+	cull.getProgram().setUniform("Count", static_cast<GLuint>(_pending));
+	cull.getProgram().setUniform("Levels", static_cast<int>(_levels));
+	cull.compute(Resources::groupCount(_pending, Resources::getWorkgroupSize(cull).x), 1, 1);
+	cull.memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+}
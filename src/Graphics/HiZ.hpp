@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Buffer.hpp>
+#include <Texture2D.hpp>
+#include <Component.hpp>
+
+/**
+ * Hierarchical-Z occlusion culling.
+ * A pyramid of the farthest depth is built from the depth of the G-Buffer (hiz_cs.glsl),
+ * then the AABBs of the MeshRenderers are tested against it in a compute pass (hiz_cull_cs.glsl),
+ * writing a visibility buffer indexed by ComponentID.
+ * The visibility buffer is read back without waiting for the GPU: results are used
+ * by the next frames (with at least one frame of latency), occluded objects are drawn
+ * until the first result is available.
+ * Uses the "HiZBuild" and "HiZCull" compute shaders (loaded by DeferredRenderer).
+**/
+class HiZ
+{
+public:
+	HiZ() =default;
+	~HiZ();
+	
+	/**
+	 * Builds the pyramid from depth (depth buffer of the G-Buffer) and tests the AABBs
+	 * of all the MeshRenderers against it.
+	 * @param viewProjection Matrices used to render depth.
+	**/
+	void update(const Texture2D& depth, size_t width, size_t height, const glm::mat4& viewProjection);
+	
+	/**
+	 * Copies the results of the last update() if they are available (doesn't wait for the GPU).
+	**/
+	void fetch();
+	
+	/// @return false if the MeshRenderer was occluded in the last available results.
+	inline bool isVisible(ComponentID id) const { return id >= _visibility.size() || _visibility[id] != 0; }
+	
+	/// @return Number of MeshRenderers occluded in the last available results.
+	size_t getOccludedCount() const;
+	
+	inline const Texture2D& getPyramid() const { return _pyramid; }
+	inline size_t getLevels() const { return _levels; }
+	
+	static constexpr GLuint BoundsBinding = 1;		///< Shader storage binding of the AABBs
+	static constexpr GLuint VisibilityBinding = 2;	///< Shader storage binding of the visibility buffer
+	
+private:
+	Texture2D				_pyramid;
+	size_t					_width = 0;
+	size_t					_height = 0;
+	size_t					_levels = 0;
+	
+	std::vector<glm::vec4>	_bounds;			///< min, max of each MeshRenderer
+	ShaderStorage			_boundsBuffer;
+	ShaderStorage			_visibilityBuffer;
+	std::vector<GLuint>		_visibility;		///< Last available results
+	size_t					_pending = 0;		///< Number of results of the last update()
+	GLsync					_fence = nullptr;	///< Signaled when the results of the last update() are available
+	
+	void create_pyramid(size_t width, size_t height);
+	void build_pyramid(const Texture2D& depth);
+	void cull(const glm::mat4& viewProjection);
+};
@@ -0,0 +1,220 @@
+#include <LightClusters.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <Clock.hpp>
+#include <ThreadPool.hpp>
+
+namespace
+{
+
+bool sphere_aabb_intersect(const glm::vec3& min, const glm::vec3& max, const glm::vec3& center, float radius)
+{
+	float r = radius * radius;
+	for(int i = 0; i < 3; ++i)
+	{
+		if(center[i] < min[i]) r -= (center[i] - min[i]) * (center[i] - min[i]);
+		else if(center[i] > max[i]) r -= (center[i] - max[i]) * (center[i] - max[i]);
+	}
+	return r > 0.0f;
+}
+
+size_t clamp_index(float v, size_t count)
+{
+	return static_cast<size_t>(std::min(std::max(v, 0.0f), static_cast<float>(count - 1)));
+}
+
+}
+
+size_t LightClusters::getSlice(float depth) const
+{
+	if(depth <= _near)
+		return 0;
+	return clamp_index(std::floor(std::log(depth / _near) / std::log(_far / _near) * DepthSlices), DepthSlices);
+}
+
+void LightClusters::update_grid(const glm::mat4& projection, size_t width, size_t height)
+{
+	const glm::uvec3 count{(width + TileSize - 1) / TileSize, (height + TileSize - 1) / TileSize, DepthSlices};
+	if(count == _count && projection == _projection && width == _width && height == _height)
+		return;
+
+	_count = count;
+	_width = width;
+	_height = height;
+	_projection = projection;
+	_near = projection[3][2] / (projection[2][2] - 1.0f);
+	_far = projection[3][2] / (projection[2][2] + 1.0f);
+	if(!std::isfinite(_far) || _far <= _near) // Infinite projection
+		_far = _near * 1e6f;
+
+	const glm::mat4 invProjection = glm::inverse(projection);
+	_bounds.resize(2 * _count.x * _count.y * _count.z);
+	for(size_t y = 0; y < _count.y; ++y)
+		for(size_t x = 0; x < _count.x; ++x)
+		{
+			// Rays from the camera through the corners of the tile
+			const glm::vec2 ndc_min{2.0f * (x * TileSize) / width - 1.0f, 2.0f * (y * TileSize) / height - 1.0f};
+			const glm::vec2 ndc_max{2.0f * std::min((x + 1) * TileSize, width) / width - 1.0f,
+									2.0f * std::min((y + 1) * TileSize, height) / height - 1.0f};
+			const std::array<glm::vec2, 4> corners{ndc_min, glm::vec2{ndc_max.x, ndc_min.y}, glm::vec2{ndc_min.x, ndc_max.y}, ndc_max};
+			std::array<glm::vec3, 4> rays;
+			for(size_t i = 0; i < 4; ++i)
+			{
+				const glm::vec4 p = invProjection * glm::vec4{corners[i], -1.0f, 1.0f};
+				rays[i] = glm::vec3{p} / p.w;
+				rays[i] /= -rays[i].z; // At a distance of 1
+			}
+
+			for(size_t z = 0; z < _count.z; ++z)
+			{
+				const float slice_near = _near * std::pow(_far / _near, static_cast<float>(z) / DepthSlices);
+				const float slice_far = _near * std::pow(_far / _near, static_cast<float>(z + 1) / DepthSlices);
+				glm::vec3 min{std::numeric_limits<float>::max()};
+				glm::vec3 max{std::numeric_limits<float>::lowest()};
+				for(const auto& r : rays)
+				{
+					min = glm::min(min, glm::min(slice_near * r, slice_far * r));
+					max = glm::max(max, glm::max(slice_near * r, slice_far * r));
+				}
+				const size_t idx = (z * _count.y + y) * _count.x + x;
+				_bounds[2 * idx] = min;
+				_bounds[2 * idx + 1] = max;
+			}
+		}
+}
+
+void LightClusters::assign(const PointLight& light, uint32_t index, const glm::mat4& view, size_t chunk)
+{
+	const glm::vec3 center{view * glm::vec4{light.position, 1.0f}};
+	const float r = light.range;
+	const float zmin = -center.z - r;
+	const float zmax = -center.z + r;
+	if(zmax < _near || zmin > _far)
+		return;
+
+	// Screen space bounds of the AABB of the sphere, clipped by the near plane
+	glm::vec2 ndc_min{std::numeric_limits<float>::max()};
+	glm::vec2 ndc_max{std::numeric_limits<float>::lowest()};
+	const float depths[2] = {std::max(zmin, _near), zmax};
+	for(int i = 0; i < 8; ++i)
+	{
+		const glm::vec3 corner{center.x + ((i & 1) ? r : -r), center.y + ((i & 2) ? r : -r), -depths[i >> 2]};
+		const glm::vec4 clip = _projection * glm::vec4{corner, 1.0f};
+		const glm::vec2 ndc = glm::vec2{clip} / clip.w;
+		ndc_min = glm::min(ndc_min, ndc);
+		ndc_max = glm::max(ndc_max, ndc);
+	}
+	if(ndc_max.x < -1.0f || ndc_max.y < -1.0f || ndc_min.x > 1.0f || ndc_min.y > 1.0f)
+		return;
+	// Tiles per NDC unit
+	const glm::vec2 scale = 0.5f * glm::vec2{static_cast<float>(_width), static_cast<float>(_height)} / static_cast<float>(TileSize);
+	const glm::uvec2 tile_min{clamp_index((ndc_min.x + 1.0f) * scale.x, _count.x), clamp_index((ndc_min.y + 1.0f) * scale.y, _count.y)};
+	const glm::uvec2 tile_max{clamp_index((ndc_max.x + 1.0f) * scale.x, _count.x), clamp_index((ndc_max.y + 1.0f) * scale.y, _count.y)};
+
+	const size_t slice_min = getSlice(zmin);
+	const size_t slice_max = getSlice(zmax);
+	auto& pairs = _chunkPairs[chunk];
+	auto& counts = _chunkCounts[chunk];
+	for(size_t z = slice_min; z <= slice_max; ++z)
+		for(size_t y = tile_min.y; y <= tile_max.y; ++y)
+			for(size_t x = tile_min.x; x <= tile_max.x; ++x)
+			{
+				const uint32_t idx = static_cast<uint32_t>((z * _count.y + y) * _count.x + x);
+				if(sphere_aabb_intersect(_bounds[2 * idx], _bounds[2 * idx + 1], center, r))
+				{
+					pairs.emplace_back(idx, index);
+					++counts[idx];
+				}
+			}
+}
+
+void LightClusters::build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+						  size_t width, size_t height, ThreadPool* pool)
+{
+	const auto start = Clock::now();
+
+	update_grid(projection, width, height);
+	const size_t cluster_count = _count.x * _count.y * _count.z;
+	if(cluster_count == 0)
+	{
+		_clusters.clear();
+		_indices.clear();
+		return;
+	}
+
+	// Each chunk of lights gathers its (cluster, light) pairs, they are then merged by cluster.
+	const size_t chunks = std::max<size_t>(1, std::min(lights.size() / 1024, pool ? pool->getThreadCount() + 1 : 1));
+	const size_t chunk_size = (lights.size() + chunks - 1) / chunks;
+	_chunkPairs.resize(chunks);
+	_chunkCounts.resize(chunks);
+	auto gather = [&](size_t c) {
+		_chunkPairs[c].clear();
+		_chunkCounts[c].assign(cluster_count, 0);
+		const size_t end = std::min(lights.size(), (c + 1) * chunk_size);
+		for(size_t i = c * chunk_size; i < end; ++i)
+			if(lights[i].info >= 0.0f)
+				assign(lights[i], static_cast<uint32_t>(i), view, c);
+	};
+	if(pool && chunks > 1)
+		pool->parallel_for(chunks, gather);
+	else
+		for(size_t c = 0; c < chunks; ++c)
+			gather(c);
+
+	// Offsets (prefix sum), the counts of the chunks become their write offsets in each cluster.
+	_clusters.resize(cluster_count);
+	uint32_t offset = 0;
+	for(size_t i = 0; i < cluster_count; ++i)
+	{
+		_clusters[i].offset = offset;
+		for(size_t c = 0; c < chunks; ++c)
+		{
+			const uint32_t count = _chunkCounts[c][i];
+			_chunkCounts[c][i] = offset;
+			offset += count;
+		}
+		_clusters[i].count = offset - _clusters[i].offset;
+	}
+
+	// Lights are in increasing order in each cluster.
+	_indices.resize(offset);
+	auto scatter = [&](size_t c) {
+		auto& offsets = _chunkCounts[c];
+		for(const auto& p : _chunkPairs[c])
+			_indices[offsets[p.first]++] = p.second;
+	};
+	if(pool && chunks > 1)
+		pool->parallel_for(chunks, scatter);
+	else
+		for(size_t c = 0; c < chunks; ++c)
+			scatter(c);
+
+	_buildTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void LightClusters::upload()
+{
+	if(!_clustersBuffer)
+	{
+		_clustersBuffer.init();
+		_indicesBuffer.init();
+	}
+	static_assert(sizeof(Cluster) == 2 * sizeof(GLuint), "Clusters are read as uvec2 by the shaders.");
+	// Never empty: zero sized buffers can't be bound.
+	static const Cluster empty_cluster;
+	static const uint32_t empty_index = 0;
+	if(_clusters.empty())
+		_clustersBuffer.data(&empty_cluster, sizeof(Cluster), Buffer::Usage::StreamDraw);
+	else
+		_clustersBuffer.data(_clusters.data(), _clusters.size() * sizeof(Cluster), Buffer::Usage::StreamDraw);
+	if(_indices.empty())
+		_indicesBuffer.data(&empty_index, sizeof(uint32_t), Buffer::Usage::StreamDraw);
+	else
+		_indicesBuffer.data(_indices.data(), _indices.size() * sizeof(uint32_t), Buffer::Usage::StreamDraw);
+	_clustersBuffer.bind(ClustersBinding);
+	_indicesBuffer.bind(ClusterLightsBinding);
+}
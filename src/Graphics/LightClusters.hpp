@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include <Buffer.hpp>
+#include <PointLight.hpp>
+
+class ThreadPool;
+
+/**
+ * Clustered light culling: the view frustum is divided in tiles of TileSize * TileSize pixels
+ * and DepthSlices exponential depth slices. build() assigns the point lights to the clusters
+ * they intersect on the CPU (workers of a ThreadPool), upload() copies the lists to shader storage
+ * buffers used by tiled_deferred_shadow_cs.glsl:
+ *  ClustersBinding:		uvec2 (offset, count) per cluster, index = (slice * y_count + y) * x_count + x
+ *  ClusterLightsBinding:	Light indices, by cluster
+ * The lights themselves are in the PointLights shader storage block (see Scene).
+ * The shader refines the lists of each workgroup with the depths of its pixels (2.5D culling): only the slices
+ * containing a pixel are read and lights outside of the occupied cells of the depth mask are skipped.
+ * Assumes a perspective projection.
+**/
+class LightClusters
+{
+public:
+	static constexpr size_t	TileSize = 64;
+	static constexpr size_t	DepthSlices = 32;
+
+	static constexpr GLuint	ClustersBinding = 4;
+	static constexpr GLuint	ClusterLightsBinding = 5;
+
+	struct Cluster
+	{
+		uint32_t	offset = 0;		///< In getLightIndices()
+		uint32_t	count = 0;
+	};
+
+	LightClusters() =default;
+
+	/**
+	 * Lights with a negative info are ignored.
+	 * @param pool Workers to use, can be null.
+	 * No GL calls: can be tested without a context.
+	**/
+	void build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+			   size_t width, size_t height, ThreadPool* pool = nullptr);
+
+	/// Uploads the result of the last build() and binds the buffers.
+	void upload();
+
+	inline const glm::uvec3&				getCount()			const { return _count; }		///< Clusters along each dimension
+	inline float							getNear()			const { return _near; }
+	inline float							getFar()			const { return _far; }
+	inline const std::vector<Cluster>&		getClusters()		const { return _clusters; }
+	inline const std::vector<uint32_t>&		getLightIndices()	const { return _indices; }
+	inline double							getBuildTime()		const { return _buildTime; }	///< Of the last build(), in ms
+
+	/// @return Depth slice of a view space distance (along -z), clamped.
+	size_t getSlice(float depth) const;
+
+private:
+	glm::uvec3					_count{0};
+	size_t						_width = 0;
+	size_t						_height = 0;
+	float						_near = 0.0f;
+	float						_far = 0.0f;
+	glm::mat4					_projection{0.0f};
+	std::vector<glm::vec3>		_bounds;		///< View space AABB (min, max) of each cluster
+
+	std::vector<Cluster>		_clusters;
+	std::vector<uint32_t>		_indices;
+	double						_buildTime = 0.0;
+
+	// Per chunk of lights (by task)
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>>	_chunkPairs;	///< (cluster, light)
+	std::vector<std::vector<uint32_t>>						_chunkCounts;	///< By cluster
+
+	ShaderStorage				_clustersBuffer;
+	ShaderStorage				_indicesBuffer;
+
+	void update_grid(const glm::mat4& projection, size_t width, size_t height);
+	void assign(const PointLight& light, uint32_t index, const glm::mat4& view, size_t chunk);
+};
@@ -1,8 +1,13 @@
 #include <Material.hpp>
 
+#include <algorithm>
+
+#include <BindlessTextures.hpp>
+
 Material::Material(const Program& P) :
 	_shadingProgram(&P)
 {
+	updateLocations();
 }
 	
 Material::Material(const Material& m)
@@ -12,37 +17,154 @@ Material::Material(const Material& m)
 		_uniforms.push_back(std::unique_ptr<GenericUniform>(u.get()->clone()));
 	_textureCount = m._textureCount;
 	_subroutines = m._subroutines;
+	_layout = m._layout; // The copy gets its own buffer
+	_hash = m._hash;
+	_hash_dirty = m._hash_dirty;
 }
 
 Material& Material::operator=(const Material& m)
 {
-	_shadingProgram = m._shadingProgram;
-	for(const auto& u : m._uniforms)
-		_uniforms.push_back(std::unique_ptr<GenericUniform>(u.get()->clone()));
-	_textureCount = m._textureCount;
-	_subroutines = m._subroutines;
-	
+	// Copy, then move: the previous uniforms are released (and the cached hash stays consistent with them).
+	Material copy(m);
+	*this = std::move(copy);
 	return *this;
 }
 
+size_t Material::_relink_count = 0;
+std::unordered_map<const Program*, size_t> Material::_program_generations;
+
 void Material::bind() const
-{	
+{
+	check_layout();
+	if(_layout && _layout->block_index != GL_INVALID_INDEX)
+	{
+		if(_block_dirty || (_layout->bindless && _block_generation != BindlessTextures::getGeneration()))
+			upload_block();
+		glBindBufferRange(GL_UNIFORM_BUFFER, BlockBinding, _block_buffer->getName(), 0, _layout->block_size);
+	}
+	
+	for(const auto& U : _uniforms)
+		if(static_cast<GLint>(U.get()->getLocation()) >= 0) // Not a member of the block
+			U.get()->bind(_shadingProgram->getName());
+}
+
+void Material::upload_block() const
+{
+	std::vector<char> data(_layout->block_size, 0);
 	for(const auto& U : _uniforms)
-		U.get()->bind(_shadingProgram->getName());
+	{
+		auto it = _layout->offsets.find(U.get()->getName());
+		if(it != _layout->offsets.end() && !U.get()->store(data.data() + it->second))
+			Log::warn("Material: Type of uniform '", U.get()->getName(), "' isn't supported in the ", BlockName, ".");
+	}
+	
+	if(!_block_buffer)
+	{
+		_block_buffer.reset(new UniformBuffer());
+		_block_buffer->init();
+	}
+	_block_buffer->data(data.data(), data.size(), Buffer::Usage::DynamicDraw);
+	_block_dirty = false;
+	_block_generation = BindlessTextures::getGeneration();
 }
 
 void Material::unbind() const
 {	
 	for(auto& U : _uniforms)
-		U.get()->unbind(_shadingProgram->getName());
+		if(static_cast<GLint>(U.get()->getLocation()) >= 0)
+			U.get()->unbind(_shadingProgram->getName());
+}
+
+namespace
+{
+
+/// Samplers can only be block members as bindless handles.
+bool is_sampler(GLenum type)
+{
+	switch(type)
+	{
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_CUBE_SHADOW:
+			return true;
+		default:
+			return false;
+	}
+}
+
 }
 
 void Material::updateLocations()
 {
+	if(_shadingProgram == nullptr)
+		return;
+	
+	_layout.reset(); // Queried again even if the program didn't change
+	refresh_layout();
+	modified(); // The program may have changed
+}
+
+void Material::refresh_layout() const
+{
+	_relinks = _relink_count;
+	if(_shadingProgram == nullptr || (_layout && _layout->program_generation == program_generation(_shadingProgram)))
+		return;
+	
+	const GLuint program = _shadingProgram->getName();
+	auto layout = std::make_shared<ProgramLayout>();
+	layout->program_generation = program_generation(_shadingProgram);
+	layout->model_index = getLocation("ModelIndex");
+	layout->octahedral_normals = getLocation("OctahedralNormals");
+	
+	layout->block_index = glGetUniformBlockIndex(program, BlockName);
+	if(layout->block_index != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(program, layout->block_index, BlockBinding);
+		glGetActiveUniformBlockiv(program, layout->block_index, GL_UNIFORM_BLOCK_DATA_SIZE, &layout->block_size);
+		
+		GLint count = 0;
+		glGetActiveUniformBlockiv(program, layout->block_index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &count);
+		std::vector<GLint> indices(count);
+		glGetActiveUniformBlockiv(program, layout->block_index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+		std::vector<GLint> offsets(count);
+		glGetActiveUniformsiv(program, count, reinterpret_cast<const GLuint*>(indices.data()), GL_UNIFORM_OFFSET, offsets.data());
+		std::vector<GLint> types(count);
+		glGetActiveUniformsiv(program, count, reinterpret_cast<const GLuint*>(indices.data()), GL_UNIFORM_TYPE, types.data());
+		
+		for(GLint i = 0; i < count; ++i)
+		{
+			char name[256];
+			GLsizei length = 0;
+			glGetActiveUniformName(program, indices[i], sizeof(name), &length, name);
+			layout->offsets[std::string(name, length)] = offsets[i];
+			if(is_sampler(types[i]))
+				layout->bindless = true;
+		}
+	}
+	_layout = layout;
+	_block_dirty = true; // Offsets and size may have changed
+	
 	for(auto& U : _uniforms)
 	{
 		U.get()->setLocation(getLocation(U.get()->getName()));
 	}
+	for(auto& s : _subroutines)
+		s.second.update(*_shadingProgram);
+}
+
+size_t Material::program_generation(const Program* p)
+{
+	auto it = _program_generations.find(p);
+	return it == _program_generations.end() ? 0 : it->second;
+}
+
+void Material::programRelinked(const Program& p)
+{
+	++_program_generations[&p];
+	++_relink_count;
 }
 	
 GLint Material::getLocation(const std::string& name) const
@@ -50,6 +172,105 @@ GLint Material::getLocation(const std::string& name) const
 	return _shadingProgram->getUniformLocation(name);
 }
 
+unsigned long long Material::compute_hash() const
+{
+	auto h = hash_rt(&_shadingProgram, sizeof(_shadingProgram));
+	
+	// Sum: Independent of the order of the uniforms
+	unsigned long long uniforms = 0;
+	for(const auto& U : _uniforms)
+		uniforms += U.get()->hash();
+	h = hash_rt(&uniforms, sizeof(uniforms), h);
+	
+	for(const auto& s : _subroutines)
+		for(const auto& a : s.second.activeSubroutines)
+		{
+			h = hash_rt(a.first.c_str(), a.first.size(), h);
+			h = hash_rt(a.second.c_str(), a.second.size(), h);
+		}
+	return h;
+}
+
+bool Material::operator==(const Material& m) const
+{
+	if(_shadingProgram != m._shadingProgram ||
+	   _uniforms.size() != m._uniforms.size() ||
+	   getHash() != m.getHash())
+		return false;
+	
+	for(const auto& U : _uniforms)
+	{
+		auto it = std::find_if(m._uniforms.begin(), m._uniforms.end(), 
+			[&](const std::unique_ptr<GenericUniform>& o) { return o.get()->getName() == U.get()->getName(); });
+		if(it == m._uniforms.end() || !U.get()->equals(*it->get()))
+			return false;
+	}
+	
+	if(_subroutines.size() != m._subroutines.size())
+		return false;
+	for(const auto& s : _subroutines)
+	{
+		auto it = m._subroutines.find(s.first);
+		if(it == m._subroutines.end() || it->second.activeSubroutines != s.second.activeSubroutines)
+			return false;
+	}
+	
+	return true;
+}
+
+namespace
+{
+
+/// Shared materials by hash. Not owning (released materials are pruned by later lookups).
+std::unordered_multimap<unsigned long long, std::weak_ptr<const Material>>	_shared_materials;
+
+}
+
+template<typename M>
+std::shared_ptr<const Material> Material::share_impl(M&& m)
+{
+	const auto h = m.getHash();
+	auto range = _shared_materials.equal_range(h);
+	for(auto it = range.first; it != range.second;)
+	{
+		if(auto shared = it->second.lock())
+		{
+			if(*shared == m)
+				return shared;
+			++it;
+		} else {
+			it = _shared_materials.erase(it);
+		}
+	}
+	
+	// Not make_shared: the weak_ptr would keep the memory of the material allocated.
+	std::shared_ptr<const Material> shared{new Material(std::forward<M>(m))};
+	_shared_materials.emplace(h, shared);
+	return shared;
+}
+
+std::shared_ptr<const Material> Material::share(const Material& m)
+{
+	return share_impl(m);
+}
+
+std::shared_ptr<const Material> Material::share(Material&& m)
+{
+	return share_impl(std::move(m));
+}
+
+size_t Material::getSharedCount()
+{
+	for(auto it = _shared_materials.begin(); it != _shared_materials.end();)
+	{
+		if(it->second.expired())
+			it = _shared_materials.erase(it);
+		else
+			++it;
+	}
+	return _shared_materials.size();
+}
+
 void Material::SubroutineState::update(const Program& p)
 {
 	GLsizei uniformCount;
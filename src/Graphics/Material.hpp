@@ -4,12 +4,14 @@
 #include <vector>
 #include <iostream>
 #include <memory>
+#include <unordered_map>
 
 #include <GL/gl3w.h>
 #include <GLFW/glfw3.h>
 
 #include <Uniform.hpp>
 #include <Shaders.hpp>
+#include <Buffer.hpp>
 #include <Texture2D.hpp>
 #include <Texture3D.hpp>
 
@@ -18,6 +20,13 @@
 /**
  * Material
  * Association of a Shader program and a set of Uniforms.
+ * Uniforms declared in the 'MaterialBlock' uniform block of the program are
+ * stored in a std140 buffer owned by the material, uploaded when modified and
+ * bound with a single glBindBufferRange. Other uniforms are set one by one.
+ * Textures declared in the block are stored as bindless handles (see BindlessTextures):
+ * they don't use texture units.
+ * Identical materials can be shared (see share()): users of a shared instance
+ * must copy it before any modification (copy-on-write, see MeshRenderer).
  * @see Program
  * @see Uniform
 **/
@@ -65,13 +74,36 @@ public:
 	
 	template<typename T>
 	inline Uniform<T>* searchUniform(const std::string&);
+	template<typename T>
+	inline const Uniform<T>* searchUniform(const std::string&) const;
 	
 	template<typename T>
 	inline void setUniform(const std::string& name, const T& value);
 	
 	inline void setSubroutine(ShaderType stage, const std::string& uniformName, const std::string& functionName);
 	
+	/**
+	 * Program, subroutines and material in use, tracked across consecutive calls to use(BindingState&)
+	 * to skip redundant state changes. Has to be reset whenever something else changes
+	 * the current program (GL also resets the subroutines on glUseProgram).
+	**/
+	struct BindingState
+	{
+		const Material*							material = nullptr;
+		const Program*							program = nullptr;
+		std::map<ShaderType, std::vector<GLuint>>	subroutines;	///< Active indices, by stage
+		
+		// Statistics, since the last reset
+		size_t	program_changes = 0;
+		size_t	subroutine_calls = 0;			///< glUniformSubroutinesuiv issued
+		size_t	skipped_subroutine_calls = 0;	///< Redundant glUniformSubroutinesuiv avoided
+		
+		inline void reset();
+	};
+	
 	inline void use() const;
+	/// Same as use(), only changes the state that differs from state.
+	inline void use(BindingState& state) const;
 	
 	inline void useNone() const;
 	
@@ -81,14 +113,93 @@ public:
 	
 	void updateLocations();
 	
+	/**
+	 * Has to be called when p is relinked in place (see Resources::reloadShaders()): the materials
+	 * using it query their locations, MaterialBlock layout and subroutine indices again on their next use.
+	**/
+	static void programRelinked(const Program& p);
+	
 	inline const std::vector<std::unique_ptr<GenericUniform>>& getUniforms() const { return _uniforms; }
+	
+	/**
+	 * Per draw data, set with cached locations (the program has to be in use).
+	 * @param index Index of the model matrix in the ModelMatrices shader storage block (see model_matrix.glsl)
+	 * @return false if the program doesn't use ModelIndex.
+	**/
+	inline bool setModelIndex(GLint index) const;
+	/// @see Mesh::VertexLayout::octahedralNormals
+	inline void setOctahedralNormals(bool value) const;
+	
+	/**
+	 * Hash of the content of the material (program, uniform values and subroutines),
+	 * independent of the order in which the uniforms were set. Cached.
+	**/
+	inline unsigned long long getHash() const;
+	
+	/// @return true if both materials use the same program, uniform values and subroutines.
+	bool operator==(const Material& m) const;
+	inline bool operator!=(const Material& m) const { return !(*this == m); }
+	
+	/**
+	 * Shared instances: identical materials (by content) collapse to a single immutable object,
+	 * alive as long as it is referenced. Main thread only.
+	 * @return Shared instance equal to m (m is copied, or moved, only if there is none).
+	**/
+	static std::shared_ptr<const Material> share(const Material& m);
+	static std::shared_ptr<const Material> share(Material&& m);
+	/// @return Number of shared instances alive.
+	static size_t getSharedCount();
+	
+	static constexpr const char*	BlockName = "MaterialBlock";
+	static constexpr GLuint			BlockBinding = 16;	///< Uniform buffer binding of the MaterialBlock
 
 private:
+	/**
+	 * Program dependent data, queried once per program.
+	**/
+	struct ProgramLayout
+	{
+		GLuint									block_index = GL_INVALID_INDEX;
+		GLint									block_size = 0;
+		std::unordered_map<std::string, GLint>	offsets;					///< Offsets of the members of the block
+		bool									bindless = false;			///< Textures are members of the block (see BindlessTextures)
+		GLint									model_index = -1;			///< Location of ModelIndex
+		GLint									octahedral_normals = -1;	///< Location of OctahedralNormals
+		size_t									program_generation = 0;		///< Of the program when queried, see programRelinked()
+	};
+	
 	const Program*	_shadingProgram = nullptr;
 	
 	std::vector<std::unique_ptr<GenericUniform>>	_uniforms;
 	GLuint 											_textureCount = 0;
 	
+	// Refreshed by use() and bind() after a relink of the program, even for const (shared) materials.
+	mutable std::shared_ptr<const ProgramLayout>	_layout;	///< Shared by the copies of this material
+	mutable size_t							_relinks = 0;		///< Value of _relink_count when _layout was last checked
+	mutable std::unique_ptr<UniformBuffer>	_block_buffer;		///< Created on first use
+	mutable bool							_block_dirty = true;
+	mutable size_t							_block_generation = 0;	///< @see BindlessTextures::getGeneration
+	
+	mutable unsigned long long				_hash = 0;
+	mutable bool							_hash_dirty = true;
+	
+	unsigned long long compute_hash() const;
+	inline void modified() { _block_dirty = true; _hash_dirty = true; }
+	
+	template<typename M>
+	static std::shared_ptr<const Material> share_impl(M&& m);
+	
+	void upload_block() const;
+	
+	static size_t										_relink_count;			///< Total calls to programRelinked()
+	static std::unordered_map<const Program*, size_t>	_program_generations;	///< Calls to programRelinked(), by program
+	
+	/// Cheap unless a program was relinked since the last check.
+	inline void check_layout() const { if(_relinks != _relink_count) refresh_layout(); }
+	void refresh_layout() const;
+	static size_t program_generation(const Program* p);
+	inline bool is_block_member(const std::string& name) const { return _layout && _layout->offsets.count(name) > 0; }
+	
 	class SubroutineState
 	{
 	public:
@@ -104,7 +215,7 @@ private:
 		void update(const Program& p);
 	};
 	
-	std::map<ShaderType, SubroutineState>	_subroutines;
+	mutable std::map<ShaderType, SubroutineState>	_subroutines;	///< Indices refreshed with _layout
 	
 	GLint getLocation(const std::string& name) const;
 };
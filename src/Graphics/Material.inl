@@ -42,20 +42,25 @@ inline void Material::setUniform(const std::string& name, const CubeMap& value)
 
 inline void Material::setUniform(const std::string& name, const Texture& value)
 {
-	GLint Location = getLocation(name);
-	
-	if(Location >= 0)
+	for(auto& U : _uniforms)
 	{
-		for(auto& U : _uniforms)
+		if(U.get()->getName() == name)
 		{
-			if(U.get()->getName() == name)
-			{
-				static_cast<Uniform<Texture>*>(U.get())->setValue(value);
-				return;
-			}
+			static_cast<Uniform<Texture>*>(U.get())->setValue(value);
+			modified();
+			return;
 		}
+	}
+	
+	GLint Location = getLocation(name);
+	if(Location >= 0)
+	{
 		_uniforms.push_back(std::unique_ptr<GenericUniform>(new Uniform<Texture>(name, Location, _textureCount, value)));
 		++_textureCount;
+		modified();
+	} else if(is_block_member(name)) { // Bindless, no texture unit
+		_uniforms.push_back(std::unique_ptr<GenericUniform>(new Uniform<Texture>(name, Location, 0, value)));
+		modified();
 	} else {
 		Log::error("Material: Uniform ", name, " not found.");
 	}
@@ -82,7 +87,21 @@ Uniform<T>* Material::searchUniform(const std::string& name)
 	for(const auto& u : _uniforms)
 	{
 		if(u.get()->getName() == name)
+		{
+			modified(); // The value can be changed through the returned pointer
 			return dynamic_cast<Uniform<T>*>(u.get());
+		}
+	}
+	return nullptr;
+}
+
+template<typename T>
+const Uniform<T>* Material::searchUniform(const std::string& name) const
+{
+	for(const auto& u : _uniforms)
+	{
+		if(u.get()->getName() == name)
+			return dynamic_cast<const Uniform<T>*>(u.get());
 	}
 	return nullptr;
 }
@@ -90,22 +109,24 @@ Uniform<T>* Material::searchUniform(const std::string& name)
 template<typename T>
 void Material::setUniform(const std::string& name, const T& value)
 {
-	GLint Location = getLocation(name);
-	
-	if(Location >= 0)
+	for(auto& U : _uniforms)
 	{
-		for(auto& U : _uniforms)
+		if(U.get()->getName() == name)
 		{
-			if(U.get()->getName() == name)
-			{
-				//static_cast<Uniform<T>*>(U.get())->setValue(value);
-				// In case the types differs... We better create a shinny new one.
-				U.reset(new Uniform<T>(name, Location, value));
-				
-				return;
-			}
+			//static_cast<Uniform<T>*>(U.get())->setValue(value);
+			// In case the types differs... We better create a shinny new one.
+			U.reset(new Uniform<T>(name, U.get()->getLocation(), value));
+			modified();
+			return;
 		}
+	}
+	
+	// Members of the MaterialBlock have no location (-1).
+	GLint Location = getLocation(name);
+	if(Location >= 0 || is_block_member(name))
+	{
 		_uniforms.push_back(std::unique_ptr<GenericUniform>(new Uniform<T>(name, Location, value)));
+		modified();
 	} else {
 		Log::error("Warning: Uniform '", name, "' not found (", __PRETTY_FUNCTION__, ").");
 	}
@@ -117,10 +138,22 @@ inline void Material::setSubroutine(ShaderType stage, const std::string& uniform
 	tmp.shadertype = stage;
 	tmp.activeSubroutines[uniformName] = functionName;
 	tmp.update(*_shadingProgram);
+	_hash_dirty = true;
+}
+
+inline unsigned long long Material::getHash() const
+{
+	if(_hash_dirty)
+	{
+		_hash = compute_hash();
+		_hash_dirty = false;
+	}
+	return _hash;
 }
 	
 inline void Material::use() const
 {
+	check_layout();
 	if(_shadingProgram != nullptr)
 		_shadingProgram->use();
 	
@@ -130,6 +163,64 @@ inline void Material::use() const
 	bind();
 }
 
+inline void Material::use(BindingState& state) const
+{
+	if(state.material == this)
+		return;
+	
+	check_layout();
+	if(state.program != _shadingProgram)
+	{
+		if(_shadingProgram != nullptr)
+			_shadingProgram->use();
+		state.program = _shadingProgram;
+		state.subroutines.clear(); // Reset by glUseProgram
+		++state.program_changes;
+	}
+	
+	for(const auto& s : _subroutines)
+	{
+		auto& active = state.subroutines[s.first];
+		if(active == s.second.activeIndices)
+		{
+			++state.skipped_subroutine_calls;
+		} else {
+			s.second.use();
+			active = s.second.activeIndices;
+			++state.subroutine_calls;
+		}
+	}
+	
+	bind();
+	state.material = this;
+}
+
+inline void Material::BindingState::reset()
+{
+	material = nullptr;
+	program = nullptr;
+	subroutines.clear();
+	program_changes = 0;
+	subroutine_calls = 0;
+	skipped_subroutine_calls = 0;
+}
+
+inline bool Material::setModelIndex(GLint index) const
+{
+	check_layout();
+	if(!_layout || _layout->model_index < 0)
+		return false;
+	::setUniform(_shadingProgram->getName(), _layout->model_index, index);
+	return true;
+}
+
+inline void Material::setOctahedralNormals(bool value) const
+{
+	check_layout();
+	if(_layout && _layout->octahedral_normals >= 0)
+		::setUniform(_shadingProgram->getName(), _layout->octahedral_normals, static_cast<int>(value));
+}
+
 inline void Material::useNone() const
 {
 	unbind();
@@ -2,19 +2,31 @@
 
 #include <iostream>
 #include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <tiny_obj_loader.h>
 
 #include <Context.hpp>
 
 #include <Resources.hpp>
+#include <MappedFile.hpp>
+#include <ThreadPool.hpp>
+#include <AsyncLoader.hpp>
+#include <hash.hpp>
 
 //////////////////////// Mesh::Triangle ///////////////////////////
 
 Mesh::Triangle::Triangle(size_t v1,
 						 size_t v2,
 						 size_t v3) :
-	vertices{v1, v2, v3}
+	vertices{static_cast<Index>(v1), static_cast<Index>(v2), static_cast<Index>(v3)}
 {
 }
 
@@ -46,10 +58,149 @@ glm::vec3 Mesh::resetPivot()
 	for(auto& v : _vertices)
 		v.position -= pivot;
 	computeBoundingBox();
+	_pivot += pivot;
 	
 	return pivot;
 }
 
+/////////////////////// Vertex Formats ////////////////////////////
+
+namespace
+{
+
+/**
+ * Octahedral normal encoding, see octahedral.glsl for decoding.
+ * @see "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.
+**/
+glm::i16vec2 octahedral_encode(glm::vec3 n)
+{
+	const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if(l1 <= 0.0f) // Degenerate normal
+		return glm::i16vec2{0};
+	n /= l1;
+	glm::vec2 p{n.x, n.y};
+	if(n.z < 0.0f)
+		p = glm::vec2{(1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+					  (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f)};
+	return glm::i16vec2{glm::packSnorm1x16(p.x), glm::packSnorm1x16(p.y)};
+}
+
+glm::u16vec2 half_encode(const glm::vec2& v)
+{
+	return glm::u16vec2{glm::packHalf1x16(v.x), glm::packHalf1x16(v.y)};
+}
+
+}
+
+Mesh::VertexFormat Mesh::LoadedVertexFormat = Mesh::VertexFormat::Quantized;
+
+const Mesh::VertexLayout& Mesh::VertexLayout::get(VertexFormat format)
+{
+	static const VertexLayout Layouts[3] = {
+		{
+			{
+				{0, 3, Type::Float, false, offsetof(struct Vertex, position)},
+				{1, 3, Type::Float, true, offsetof(struct Vertex, normal)},
+				{2, 2, Type::Float, false, offsetof(struct Vertex, texcoord)}
+			},
+			sizeof(Vertex),
+			false
+		},
+		{
+			{
+				{0, 3, Type::Float, false, offsetof(struct PackedVertex, position)},
+				{1, 2, Type::Short, true, offsetof(struct PackedVertex, normal)},
+				{2, 2, Type::HalfFloat, false, offsetof(struct PackedVertex, texcoord)}
+			},
+			sizeof(PackedVertex),
+			true
+		},
+		{
+			{
+				{0, 3, Type::UnsignedShort, true, offsetof(struct QuantizedVertex, position)},
+				{1, 2, Type::Short, true, offsetof(struct QuantizedVertex, normal)},
+				{2, 2, Type::HalfFloat, false, offsetof(struct QuantizedVertex, texcoord)}
+			},
+			sizeof(QuantizedVertex),
+			true
+		}
+	};
+	static_assert(sizeof(PackedVertex) == 20, "Unexpected PackedVertex size.");
+	static_assert(sizeof(QuantizedVertex) == 16, "Unexpected QuantizedVertex size.");
+	return Layouts[static_cast<size_t>(format)];
+}
+
+void Mesh::setVertexFormat(VertexFormat format)
+{
+	if(_vao)
+	{
+		Log::warn("Mesh::setVertexFormat: VAO of '", _name, "' already created, format unchanged.");
+		return;
+	}
+	_vertex_format = format;
+}
+
+void Mesh::setModelMatrix(const glm::mat4& modelMatrix) const
+{
+	setUniform("ModelMatrix", modelMatrix * _position_decode);
+	setUniform("OctahedralNormals", static_cast<int>(getVertexLayout().octahedralNormals));
+}
+
+void Mesh::setModelMatrix(const Program& program, const glm::mat4& modelMatrix) const
+{
+	program.setUniform("ModelMatrix", modelMatrix * _position_decode);
+	program.setUniform("OctahedralNormals", static_cast<int>(getVertexLayout().octahedralNormals));
+}
+
+/**
+ * Uploads vertices (_vertices.size() of them) to _vertex_buffer (bound) using the current vertex format.
+**/
+void Mesh::upload_vertices(const Vertex* vertices)
+{
+	switch(_vertex_format)
+	{
+		case VertexFormat::Float:
+		{
+			_position_decode = glm::mat4(1.0f);
+			_vertex_buffer.data(vertices, sizeof(Vertex) * _vertices.size(), Buffer::Usage::StaticDraw);
+			break;
+		}
+		case VertexFormat::Packed:
+		{
+			_position_decode = glm::mat4(1.0f);
+			std::vector<PackedVertex> packed(_vertices.size());
+			for(size_t i = 0; i < _vertices.size(); ++i)
+				packed[i] = PackedVertex{vertices[i].position,
+										 octahedral_encode(vertices[i].normal),
+										 half_encode(vertices[i].texcoord)};
+			_vertex_buffer.data(&packed[0], sizeof(PackedVertex) * packed.size(), Buffer::Usage::StaticDraw);
+			break;
+		}
+		case VertexFormat::Quantized:
+		{
+			// Uniform scale on all axes: the decoding matrix has to keep the normals untouched.
+			computeBoundingBox();
+			const glm::vec3 extent = _bbox.max - _bbox.min;
+			float scale = std::max(extent.x, std::max(extent.y, extent.z));
+			if(scale <= 0.0f) scale = 1.0f;
+			_position_decode = glm::scale(glm::translate(glm::mat4(1.0f), _bbox.min), glm::vec3{scale});
+			
+			std::vector<QuantizedVertex> packed(_vertices.size());
+			for(size_t i = 0; i < _vertices.size(); ++i)
+			{
+				const glm::vec3 q = (vertices[i].position - _bbox.min) / scale;
+				packed[i] = QuantizedVertex{glm::u16vec4{glm::packUnorm1x16(q.x), glm::packUnorm1x16(q.y), glm::packUnorm1x16(q.z), 0},
+											octahedral_encode(vertices[i].normal),
+											half_encode(vertices[i].texcoord)};
+			}
+			_vertex_buffer.data(&packed[0], sizeof(QuantizedVertex) * packed.size(), Buffer::Usage::StaticDraw);
+			break;
+		}
+	}
+}
+
+static_assert(sizeof(Mesh::Triangle) == 3 * sizeof(Mesh::Index), "Index buffer is uploaded directly from Mesh::_triangles.");
+
 void Mesh::createVAO()
 {
 	if(_vao)
@@ -60,16 +211,15 @@ void Mesh::createVAO()
 	
 	_vertex_buffer.init();
 	_vertex_buffer.bind();
-	
-	_vertex_buffer.data(&_vertices[0], sizeof(Vertex)*_vertices.size(), Buffer::Usage::StaticDraw);
+	upload_vertices(_vertices.data());
 
-    _vao.attribute(0, 3, Type::Float, false, sizeof(Vertex), offsetof(struct Vertex, position));
-    _vao.attribute(1, 3, Type::Float, true, sizeof(Vertex), offsetof(struct Vertex, normal));
-    _vao.attribute(2, 2, Type::Float, false, sizeof(Vertex), offsetof(struct Vertex, texcoord));
+	const VertexLayout& layout = getVertexLayout();
+	for(const auto& a : layout.attributes)
+		_vao.attribute(a.index, a.size, a.type, a.normalized, layout.stride, a.offset);
 
 	_index_buffer.init();
 	_index_buffer.bind();
-	_index_buffer.data(&_triangles[0], sizeof(size_t) * _triangles.size() * 3, Buffer::Usage::StaticDraw);
+	_index_buffer.data(&_triangles[0], sizeof(Index) * _triangles.size() * 3, Buffer::Usage::StaticDraw);
 	
 	_vao.unbind(); // Unbind first on purpose :)
 	_index_buffer.unbind();
@@ -79,9 +229,9 @@ void Mesh::createVAO()
 void Mesh::update()
 {
 	_vertex_buffer.bind();
-	_vertex_buffer.data(&_vertices[0], sizeof(Vertex)*_vertices.size(), Buffer::Usage::StaticDraw);
+	upload_vertices(_vertices.data());
 	_index_buffer.bind();
-	_index_buffer.data(&_triangles[0], sizeof(size_t) * _triangles.size() * 3, Buffer::Usage::StaticDraw);
+	_index_buffer.data(&_triangles[0], sizeof(Index) * _triangles.size() * 3, Buffer::Usage::StaticDraw);
 }
 
 void Mesh::draw() const
@@ -133,6 +283,510 @@ void Mesh::computeBoundingBox()
 	}
 }
 
+/////////////////////// Optimization //////////////////////////////
+
+namespace
+{
+
+static_assert(sizeof(Mesh::Vertex) == 8 * sizeof(float), "Vertex welding relies on Mesh::Vertex having no padding.");
+
+struct VertexHash
+{
+	size_t operator()(const Mesh::Vertex& v) const
+	{
+		// FNV-1a over the raw bytes
+		const auto* p = reinterpret_cast<const unsigned char*>(&v);
+		unsigned long long h = 14695981039346656037ULL;
+		for(size_t i = 0; i < sizeof(Mesh::Vertex); ++i)
+			h = (h ^ p[i]) * 1099511628211ULL;
+		return static_cast<size_t>(h);
+	}
+};
+
+struct VertexEqual
+{
+	bool operator()(const Mesh::Vertex& l, const Mesh::Vertex& r) const
+	{
+		return std::memcmp(&l, &r, sizeof(Mesh::Vertex)) == 0;
+	}
+};
+
+// Forsyth's scoring constants
+constexpr float CacheDecayPower = 1.5f;
+constexpr float LastTriScore = 0.75f;
+constexpr float ValenceBoostScale = 2.0f;
+constexpr float ValenceBoostPower = 0.5f;
+
+float vertex_score(int cachePosition, size_t remainingTriangles)
+{
+	if(remainingTriangles == 0)
+		return -1.0f; // Not used by any triangle anymore
+	
+	float score = 0.0f;
+	if(cachePosition >= 0)
+	{
+		// The three vertices of the last triangle get a fixed score, on purpose,
+		// so we don't favor the same triangle edge too much.
+		if(cachePosition < 3)
+			score = LastTriScore;
+		else
+			score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (Mesh::VertexCacheSize - 3), CacheDecayPower);
+	}
+	
+	// Boost vertices with only a few triangles left so they don't linger
+	score += ValenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -ValenceBoostPower);
+	return score;
+}
+
+}
+
+void Mesh::optimize()
+{
+	const size_t vertexCount = _vertices.size();
+	const float acmr = computeACMR();
+	
+	weldVertices();
+	optimizeVertexCache();
+	optimizeVertexFetch();
+	
+	Log::info(_name, ": ", vertexCount, " -> ", _vertices.size(), " vertices (",
+		vertexCount > 0 ? 100 * _vertices.size() / vertexCount : 100, "%), ACMR ", acmr, " -> ", computeACMR(), ".");
+}
+
+void Mesh::weldVertices()
+{
+	std::unordered_map<Vertex, size_t, VertexHash, VertexEqual> unique;
+	unique.reserve(_vertices.size());
+	
+	std::vector<size_t> remap(_vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(_vertices.size());
+	for(size_t i = 0; i < _vertices.size(); ++i)
+	{
+		const auto it = unique.emplace(_vertices[i], welded.size());
+		if(it.second)
+			welded.push_back(_vertices[i]);
+		remap[i] = it.first->second;
+	}
+	
+	for(auto& t : _triangles)
+		for(auto& v : t.vertices)
+			v = remap[v];
+	_vertices = std::move(welded);
+}
+
+void Mesh::optimizeVertexCache()
+{
+	constexpr size_t invalid = std::numeric_limits<size_t>::max();
+	const size_t vertexCount = _vertices.size();
+	const size_t triangleCount = _triangles.size();
+	if(triangleCount == 0)
+		return;
+	
+	// Vertex to triangles adjacency, the first 'remaining[v]' entries of each list
+	// are the triangles of v which have not been emitted yet.
+	std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+	for(const auto& t : _triangles)
+		for(auto v : t.vertices)
+			++adjacencyOffset[v + 1];
+	for(size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffset[v + 1] += adjacencyOffset[v];
+	std::vector<size_t> adjacency(adjacencyOffset.back());
+	std::vector<size_t> remaining(vertexCount, 0);
+	for(size_t t = 0; t < triangleCount; ++t)
+		for(auto v : _triangles[t].vertices)
+			adjacency[adjacencyOffset[v] + remaining[v]++] = t;
+	
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = vertex_score(-1, remaining[v]);
+	
+	std::vector<float> triangleScore(triangleCount, 0.0f);
+	std::vector<bool> emitted(triangleCount, false);
+	for(size_t t = 0; t < triangleCount; ++t)
+		for(auto v : _triangles[t].vertices)
+			triangleScore[t] += vertexScore[v];
+	
+	std::vector<Triangle> ordered;
+	ordered.reserve(triangleCount);
+	
+	// LRU cache, most recently used first. Holds up to 3 more entries during updates.
+	std::vector<size_t> cache, nextCache;
+	cache.reserve(VertexCacheSize + 3);
+	nextCache.reserve(VertexCacheSize + 3);
+	
+	size_t best = std::distance(triangleScore.begin(), std::max_element(triangleScore.begin(), triangleScore.end()));
+	size_t scanStart = 0;
+	while(ordered.size() < triangleCount)
+	{
+		if(best == invalid)
+		{
+			// None of the cached vertices have triangles left: Fall back to the best remaining triangle.
+			float bestScore = std::numeric_limits<float>::lowest();
+			while(emitted[scanStart])
+				++scanStart;
+			for(size_t t = scanStart; t < triangleCount; ++t)
+				if(!emitted[t] && triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+		}
+		
+		const auto& tri = _triangles[best];
+		emitted[best] = true;
+		ordered.push_back(tri);
+		
+		nextCache.clear();
+		for(auto v : tri.vertices)
+		{
+			if(std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+				nextCache.push_back(v);
+			// Move the emitted triangle out of the remaining part of the adjacency list
+			const auto begin = adjacency.begin() + adjacencyOffset[v];
+			const auto end = begin + remaining[v];
+			std::iter_swap(std::find(begin, end, best), end - 1);
+			--remaining[v];
+		}
+		for(auto v : cache)
+			if(v != tri.vertices[0] && v != tri.vertices[1] && v != tri.vertices[2])
+				nextCache.push_back(v);
+		
+		// Evicted vertices
+		for(size_t i = VertexCacheSize; i < nextCache.size(); ++i)
+		{
+			const auto v = nextCache[i];
+			cachePosition[v] = -1;
+			vertexScore[v] = vertex_score(-1, remaining[v]);
+		}
+		if(nextCache.size() > VertexCacheSize)
+			nextCache.resize(VertexCacheSize);
+		std::swap(cache, nextCache);
+		
+		for(size_t i = 0; i < cache.size(); ++i)
+		{
+			const auto v = cache[i];
+			cachePosition[v] = static_cast<int>(i);
+			vertexScore[v] = vertex_score(cachePosition[v], remaining[v]);
+		}
+		
+		// Update the scores of the triangles touching the cache and select the next one
+		best = invalid;
+		float bestScore = std::numeric_limits<float>::lowest();
+		for(auto v : cache)
+			for(size_t i = 0; i < remaining[v]; ++i)
+			{
+				const auto t = adjacency[adjacencyOffset[v] + i];
+				const auto& tv = _triangles[t].vertices;
+				triangleScore[t] = vertexScore[tv[0]] + vertexScore[tv[1]] + vertexScore[tv[2]];
+				if(triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+	}
+	
+	_triangles = std::move(ordered);
+}
+
+void Mesh::optimizeVertexFetch()
+{
+	constexpr size_t invalid = std::numeric_limits<size_t>::max();
+	std::vector<size_t> remap(_vertices.size(), invalid);
+	std::vector<Vertex> ordered;
+	ordered.reserve(_vertices.size());
+	for(auto& t : _triangles)
+		for(auto& v : t.vertices)
+		{
+			if(remap[v] == invalid)
+			{
+				remap[v] = ordered.size();
+				ordered.push_back(_vertices[v]);
+			}
+			v = remap[v];
+		}
+	_vertices = std::move(ordered);
+}
+
+float Mesh::computeACMR(size_t cacheSize) const
+{
+	if(_triangles.empty())
+		return 0.0f;
+	
+	// FIFO cache simulation: a vertex is still cached if less than cacheSize
+	// vertices were pushed since its own insertion.
+	std::vector<size_t> insertion(_vertices.size(), 0);
+	size_t timestamp = cacheSize + 1;
+	size_t misses = 0;
+	for(const auto& t : _triangles)
+		for(auto v : t.vertices)
+			if(timestamp - insertion[v] > cacheSize)
+			{
+				insertion[v] = timestamp++;
+				++misses;
+			}
+	return static_cast<float>(misses) / _triangles.size();
+}
+
+////////////////////// Cache //////////////////////////////////////
+
+namespace
+{
+
+struct CacheHeader
+{
+	char				magic[4];
+	uint32_t			version;
+	unsigned long long	source_hash;
+	uint32_t			vertex_size;
+	uint32_t			shape_count;
+};
+
+constexpr char		CacheMagic[4] = {'S', 'M', 'S', 'H'};
+constexpr size_t	CacheBlobAlignment = 16;
+
+/**
+ * Sequential, bounds checked, reads from a memory mapped cache file.
+**/
+struct CacheReader
+{
+	const char*	begin;
+	const char*	ptr;
+	const char*	end;
+	
+	template<typename T>
+	bool read(T& value)
+	{
+		if(static_cast<size_t>(end - ptr) < sizeof(T)) return false;
+		std::memcpy(&value, ptr, sizeof(T));
+		ptr += sizeof(T);
+		return true;
+	}
+	
+	bool read(std::string& str)
+	{
+		uint32_t size;
+		if(!read(size) || static_cast<size_t>(end - ptr) < size) return false;
+		str.assign(ptr, size);
+		ptr += size;
+		return true;
+	}
+	
+	/// @return Pointer to count elements of type T inside the mapping, nullptr if out of bounds.
+	template<typename T>
+	const T* blob(size_t count)
+	{
+		const size_t offset = ptr - begin;
+		ptr = begin + (offset + CacheBlobAlignment - 1) / CacheBlobAlignment * CacheBlobAlignment;
+		if(ptr > end || static_cast<size_t>(end - ptr) < count * sizeof(T)) return nullptr;
+		const T* r = reinterpret_cast<const T*>(ptr);
+		ptr += count * sizeof(T);
+		return r;
+	}
+};
+
+struct CacheWriter
+{
+	std::ofstream&	out;
+	
+	template<typename T>
+	void write(const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+	
+	void write(const std::string& str)
+	{
+		write(static_cast<uint32_t>(str.size()));
+		out.write(str.data(), str.size());
+	}
+	
+	void blob(const void* data, size_t size)
+	{
+		static const char padding[CacheBlobAlignment] = {0};
+		const size_t offset = static_cast<size_t>(out.tellp());
+		out.write(padding, (CacheBlobAlignment - offset % CacheBlobAlignment) % CacheBlobAlignment);
+		out.write(static_cast<const char*>(data), size);
+	}
+};
+
+/**
+ * @param hash Hash of the content of the file at path.
+ * @return false if the file could not be read.
+**/
+bool hash_file(const std::string& path, unsigned long long& hash)
+{
+	MappedFile file;
+	if(!file.open(path))
+		return false;
+	hash = hash_rt(file.data(), file.size());
+	return true;
+}
+
+/**
+ * Sets up material according to ref. Textures are streamed (see AsyncLoader::loadTexture).
+ * @param rep Directory of the OBJ file, texture paths are relative to it.
+**/
+void apply_material(Mesh& mesh, const Mesh::MaterialReference& ref, const std::string& rep)
+{
+	auto& material = mesh.getMaterial();
+	// Defaults (the material block of the shaders can't provide them)
+	material.setUniform("R", 0.4f);
+	material.setUniform("F0", 0.1f);
+	if(!ref.defined)
+	{
+		material.setUniform("Color", glm::vec3{1.0f});
+		material.setSubroutine(ShaderType::Fragment, "colorFunction", "uniform_color");
+		material.setSubroutine(ShaderType::Fragment, "normalFunction", "basic_normal");
+		return;
+	}
+	
+	if(!ref.diffuse_texture.empty())
+	{
+		auto& t = AsyncLoader::loadTexture(rep + ref.diffuse_texture);
+		mesh.addTextureReference(Resources::_textures.ref(Resources::getTextureHandle(rep + ref.diffuse_texture)));
+		material.setUniform("Texture", t);
+		material.setUniform("Color", glm::vec3{1.0});
+		material.setSubroutine(ShaderType::Fragment, "colorFunction", "texture_color");
+	} else {
+		material.setUniform("Color", ref.diffuse);
+		material.setSubroutine(ShaderType::Fragment, "colorFunction", "uniform_color");
+	}
+	
+	if(!ref.normal_texture.empty())
+	{
+		auto& t = AsyncLoader::loadTexture(rep + ref.normal_texture, TexturePipeline::Usage::Normal);
+		mesh.addTextureReference(Resources::_textures.ref(Resources::getTextureHandle(rep + ref.normal_texture)));
+		material.setUniform("NormalMap", t);
+		material.setSubroutine(ShaderType::Fragment, "normalFunction", "normal_mapping");
+	} else {
+		material.setSubroutine(ShaderType::Fragment, "normalFunction", "basic_normal");
+	}
+}
+
+}
+
+bool Mesh::load_cache(const std::string& cache_path, unsigned long long source_hash, Import& import)
+{
+	MappedFile file;
+	if(!file.open(cache_path))
+		return false;
+	
+	CacheReader in{file.data(), file.data(), file.data() + file.size()};
+	CacheHeader header;
+	if(!in.read(header) || std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0 ||
+		header.version != CacheVersion || header.vertex_size != sizeof(Vertex))
+	{
+		Log::info("Ignoring incompatible mesh cache '", cache_path, "'.");
+		return false;
+	}
+	if(header.source_hash != source_hash)
+	{
+		Log::info("Mesh cache '", cache_path, "' is out of date.");
+		return false;
+	}
+	
+	std::vector<std::unique_ptr<Mesh>> meshes(header.shape_count);
+	std::vector<MaterialReference> materials(header.shape_count);
+	for(size_t i = 0; i < meshes.size(); ++i)
+	{
+		std::string name;
+		uint8_t defined = 0;
+		BoundingBox bbox;
+		glm::vec3 pivot;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		const Vertex* vertices = nullptr;
+		const Index* indices = nullptr;
+		auto& material = materials[i];
+		if(in.read(name) && in.read(defined) && in.read(material.diffuse) &&
+			in.read(material.diffuse_texture) && in.read(material.normal_texture) &&
+			in.read(bbox.min) && in.read(bbox.max) && in.read(pivot) &&
+			in.read(vertex_count) && in.read(index_count))
+		{
+			vertices = in.blob<Vertex>(vertex_count);
+			indices = in.blob<Index>(index_count);
+		}
+		// Indices are used as is by the draw calls and the CPU side (occlusion rasterizer, picking...).
+		if(vertices == nullptr || indices == nullptr || index_count % 3 != 0 || index_count == 0 ||
+			std::any_of(indices, indices + index_count, [&](Index idx) { return idx >= vertex_count; }))
+		{
+			Log::error("Mesh cache '", cache_path, "' is corrupted.");
+			return false;
+		}
+		material.defined = defined != 0;
+		
+		// Copied: the CPU data is modifiable (resetPivot(), update()...) and outlives the mapping.
+		meshes[i].reset(new Mesh());
+		Mesh& m = *meshes[i];
+		m._name = name;
+		m._path = import.path;
+		m._vertices.assign(vertices, vertices + vertex_count);
+		const Triangle* triangles = reinterpret_cast<const Triangle*>(indices);
+		m._triangles.assign(triangles, triangles + index_count / 3);
+		m._bbox = bbox;
+		m._pivot = pivot;
+	}
+	
+	import.meshes = std::move(meshes);
+	import.materials = std::move(materials);
+	return true;
+}
+
+void Mesh::save_cache(const std::string& cache_path, unsigned long long source_hash,
+					  const std::vector<Mesh*>& meshes, const std::vector<MaterialReference>& materials)
+{
+	// Written to a temporary file first: an interrupted write must not leave a truncated cache behind.
+	const std::string tmp_path = cache_path + ".tmp";
+	{
+		std::ofstream file(tmp_path, std::ios::binary);
+		if(!file)
+		{
+			Log::warn("Could not write mesh cache '", cache_path, "'.");
+			return;
+		}
+		
+		CacheWriter out{file};
+		CacheHeader header;
+		std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+		header.version = CacheVersion;
+		header.source_hash = source_hash;
+		header.vertex_size = sizeof(Vertex);
+		header.shape_count = static_cast<uint32_t>(meshes.size());
+		out.write(header);
+		
+		for(size_t i = 0; i < meshes.size(); ++i)
+		{
+			const Mesh& m = *meshes[i];
+			out.write(m._name);
+			out.write(static_cast<uint8_t>(materials[i].defined));
+			out.write(materials[i].diffuse);
+			out.write(materials[i].diffuse_texture);
+			out.write(materials[i].normal_texture);
+			out.write(m._bbox.min);
+			out.write(m._bbox.max);
+			out.write(m._pivot);
+			out.write(static_cast<uint32_t>(m._vertices.size()));
+			out.write(static_cast<uint32_t>(3 * m._triangles.size()));
+			out.blob(m._vertices.data(), sizeof(Vertex) * m._vertices.size());
+			out.blob(m._triangles.data(), sizeof(Triangle) * m._triangles.size());
+		}
+		
+		if(!file)
+		{
+			Log::warn("Error while writing mesh cache '", cache_path, "'.");
+			file.close();
+			std::remove(tmp_path.c_str());
+			return;
+		}
+	}
+	std::remove(cache_path.c_str());
+	if(std::rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+		Log::warn("Could not write mesh cache '", cache_path, "'.");
+}
+
 ////////////////////// Static /////////////////////////////////////
 
 std::vector<Mesh*> Mesh::load(const std::string& path)
@@ -141,14 +795,38 @@ std::vector<Mesh*> Mesh::load(const std::string& path)
 }
 
 std::vector<Mesh*> Mesh::load(const std::string& path, const Program& p)
+{
+	auto i = import(path);
+	if(!i)
+		return {};
+	return finalize(*i, p);
+}
+
+std::unique_ptr<Mesh::Import> Mesh::import(const std::string& path)
 {
 	// TODO: Buggy as hell
-	std::vector<Mesh*> M;
+	std::unique_ptr<Import> r{new Import()};
 	std::string path_s = path;
 	std::replace(path_s.begin(), path_s.end(), '\\', '/');
-	std::string rep = path_s.substr(0, path_s.find_last_of('/') + 1);
+	r->path = path_s;
+	r->rep = path_s.substr(0, path_s.find_last_of('/') + 1);
+	const std::string& rep = r->rep;
 	std::string filename = path_s.substr(path_s.find_last_of('/') + 1, path_s.size());
 	Log::info("Loading ", path_s, "...");
+	
+	unsigned long long source_hash = 0;
+	if(!hash_file(path_s, source_hash))
+	{
+		Log::error("Could not open '", path_s, "'.");
+		return nullptr;
+	}
+	
+	const std::string cache_path = path_s + CacheExtension;
+	if(load_cache(cache_path, source_hash, *r))
+	{
+		Log::info("Loaded ", r->meshes.size(), " meshes from cache '", cache_path, "'.");
+		return r;
+	}
 
 	// OBJ Loading
 	tinyobj::attrib_t attrib;
@@ -162,23 +840,14 @@ std::vector<Mesh*> Mesh::load(const std::string& path, const Program& p)
 		Log::error(err);
 
 	if (!ret)
-		return M;
+		return nullptr;
 	
-	M.resize(shapes.size());
+	r->materials.resize(shapes.size());
+	r->meshes.resize(shapes.size());
 	for(size_t s = 0; s < shapes.size(); s++)
 	{
 		std::string name{filename};
 		name.append("::" + shapes[s].name + "[" + std::to_string(s) + "]");
-		if(Resources::isMesh(name))
-		{
-			M[s] = &Resources::getMesh(name);
-			continue;
-		}
-		
-		M[s] = &Resources::getMesh(name);
-		M[s]->_name = name;
-		M[s]->_path = path_s;
-		M[s]->getMaterial().setShadingProgram(p);
 		
 		if(!materials.empty())
 		{
@@ -192,69 +861,33 @@ std::vector<Mesh*> Mesh::load(const std::string& path, const Program& p)
 					break;
 				}
 			const auto& material = materials[shapes[s].mesh.material_ids[0]];
-					
-			if(!material.diffuse_texname.empty())
-			{
-				std::string texpath = rep;
-				texpath.append(material.diffuse_texname);
-				auto& t = Resources::getTexture<Texture2D>(texpath);
-				if(!t.isValid())
-				{
-					Log::info("Loading diffuse texture '", texpath, "'.");
-					t.load(texpath);
-				}
-				if(t.isValid())
-				{
-					M[s]->getMaterial().setUniform("Texture", t);
-					M[s]->getMaterial().setUniform("Color", glm::vec3{1.0});
-					M[s]->getMaterial().setSubroutine(ShaderType::Fragment, "colorFunction", "texture_color");
-				} else {
-					Log::error("Texture ", texpath, " is invalid.");
-				}
-			} else {
-				M[s]->getMaterial().setUniform("Color", glm::vec3{material.diffuse[0], material.diffuse[1], material.diffuse[2]});
-				M[s]->getMaterial().setSubroutine(ShaderType::Fragment, "colorFunction", "uniform_color");
-			}
 			
-			std::string normal_map;
-			if(!material.bump_texname.empty()) normal_map = material.bump_texname; // map_bump, bump
-			if(!material.normal_texname.empty()) normal_map = material.normal_texname;
-			
-			if(!normal_map.empty())
-			{
-				std::string texpath = rep;
-				texpath.append(normal_map);
-				auto& t = Resources::getTexture<Texture2D>(texpath);
-				if(!t.isValid())
-				{
-					Log::info("Loading normal texture '", texpath, "'.");
-					t.load(texpath);
-				}
-				if(t.isValid())
-				{
-					M[s]->getMaterial().setUniform("NormalMap", t);
-					M[s]->getMaterial().setSubroutine(ShaderType::Fragment, "normalFunction", "normal_mapping");
-				} else {
-					Log::error("Texture ", texpath, " is invalid.");
-				}
-			} else {
-				M[s]->getMaterial().setSubroutine(ShaderType::Fragment, "normalFunction", "basic_normal");
-			}
-		} else {
-			M[s]->getMaterial().setUniform("Color", glm::vec3{1.0f});
-			M[s]->getMaterial().setSubroutine(ShaderType::Fragment, "colorFunction", "uniform_color");
-			M[s]->getMaterial().setSubroutine(ShaderType::Fragment, "normalFunction", "basic_normal");
+			auto& ref = r->materials[s];
+			ref.defined = true;
+			ref.diffuse = glm::vec3{material.diffuse[0], material.diffuse[1], material.diffuse[2]};
+			ref.diffuse_texture = material.diffuse_texname;
+			if(!material.bump_texname.empty()) ref.normal_texture = material.bump_texname; // map_bump, bump
+			if(!material.normal_texname.empty()) ref.normal_texture = material.normal_texname;
 		}
 		
+		r->meshes[s].reset(new Mesh());
+		r->meshes[s]->_name = name;
+		r->meshes[s]->_path = path_s;
+	}
+	
+	// Shapes are independent: their conversion runs on the workers.
+	ThreadPool::get().parallel_for(shapes.size(), [&](size_t s) {
+		Mesh& m = *r->meshes[s];
+		const auto& shape = shapes[s].mesh;
 		const auto minmax = glm::vec3{
-			attrib.vertices[3 * shapes[s].mesh.indices[0].vertex_index + 0],
-			attrib.vertices[3 * shapes[s].mesh.indices[0].vertex_index + 1],
-			attrib.vertices[3 * shapes[s].mesh.indices[0].vertex_index + 2]
+			attrib.vertices[3 * shape.indices[0].vertex_index + 0],
+			attrib.vertices[3 * shape.indices[0].vertex_index + 1],
+			attrib.vertices[3 * shape.indices[0].vertex_index + 2]
 		};
 		auto min = minmax;
 		auto max = minmax;
-		M[s]->getVertices().reserve(shapes[s].mesh.indices.size());
-		for(const auto& i : shapes[s].mesh.indices)
+		m.getVertices().reserve(shape.indices.size());
+		for(const auto& i : shape.indices)
 		{
 			const glm::vec3 v{
 				attrib.vertices[3 * i.vertex_index + 0],
@@ -274,19 +907,19 @@ std::vector<Mesh*> Mesh::load(const std::string& path, const Program& p)
 					1.0f - attrib.texcoords[2 * i.texcoord_index + 1] // !
 				} : 
 				glm::vec2{0.0f};
-			M[s]->getVertices().emplace_back(v, n, t);
+			m.getVertices().emplace_back(v, n, t);
 			
 			min = glm::min(min, v);
 			max = glm::max(max, v);
 		}
 		
-		M[s]->setBoundingBox({min, max});
+		m.setBoundingBox({min, max});
 		
-		M[s]->getTriangles().reserve(shapes[s].mesh.num_face_vertices.size());
-		for(size_t i = 0; i < shapes[s].mesh.num_face_vertices.size(); ++i)
+		m.getTriangles().reserve(shape.num_face_vertices.size());
+		for(size_t i = 0; i < shape.num_face_vertices.size(); ++i)
 		{
-			assert(shapes[s].mesh.num_face_vertices[i] == 3);
-			M[s]->getTriangles().emplace_back(
+			assert(shape.num_face_vertices[i] == 3);
+			m.getTriangles().emplace_back(
 				3 * i + 0,
 				3 * i + 1,
 				3 * i + 2
@@ -294,8 +927,44 @@ std::vector<Mesh*> Mesh::load(const std::string& path, const Program& p)
 		}
 		
 		if(attrib.normals.empty())
-			M[s]->computeNormals();
-	}
+			m.computeNormals();
+		
+		// Normals have to be computed beforehand as they're part of the welding key.
+		m.optimize();
+		m.resetPivot();
+	});
 	
+	std::vector<Mesh*> meshes;
+	for(const auto& m : r->meshes)
+		meshes.push_back(m.get());
+	save_cache(cache_path, source_hash, meshes, r->materials);
+	
+	return r;
+}
+
+std::vector<Mesh*> Mesh::finalize(Import& import, const Program& p)
+{
+	std::vector<Mesh*> M(import.meshes.size());
+	for(size_t s = 0; s < import.meshes.size(); s++)
+	{
+		Mesh& imported = *import.meshes[s];
+		// Fills the mesh in place: it may already be referenced as a placeholder.
+		Mesh& m = Resources::_meshes.getOrCreate(Resources::getMeshHandle(imported.getName()));
+		M[s] = &m;
+		if(m._vao || !m._vertices.empty()) // Already loaded
+			continue;
+		
+		m._name = std::move(imported._name);
+		m._path = std::move(imported._path);
+		m._vertices = std::move(imported._vertices);
+		m._triangles = std::move(imported._triangles);
+		m._bbox = imported._bbox;
+		m._pivot = imported._pivot;
+		m.setVertexFormat(LoadedVertexFormat);
+		
+		m.getMaterial().setShadingProgram(p);
+		apply_material(m, import.materials[s], import.rep);
+	}
+	import.meshes.clear();
 	return M;
 }
@@ -3,10 +3,13 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <cstdint>
+#include <memory>
 
 #include <glm/glm.hpp>
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/type_ptr.hpp> // glm::value_ptr
+#include <glm/gtc/type_precision.hpp> // glm::i16vec2, glm::u16vec2...
 
 #include <Buffer.hpp>
 #include <VertexArray.hpp>
@@ -14,10 +17,13 @@
 #include <Material.hpp>
 #include <Transformation.hpp>
 #include <Log.hpp>
+#include <Registry.hpp>
 
 class Mesh
 {
 public:
+	using Index = GLuint; ///< Type of the indices as they will be passed to the GPU (IndexType::UInt)
+	
 	/**
 	 * Three indices of vertices forming a triangle.
 	**/
@@ -29,7 +35,7 @@ public:
 
 		Triangle(const Triangle& T) =default;
 
-		std::array<size_t, 3>	vertices;
+		std::array<Index, 3>	vertices;
 	};
 
 	/**
@@ -47,6 +53,62 @@ public:
 		glm::vec2	texcoord;
 	};
 	
+	/**
+	 * Memory layout of the vertices in the GPU buffer.
+	 * The CPU copy (_vertices) always uses Vertex.
+	**/
+	enum class VertexFormat
+	{
+		Float,			///< Vertex as is (32 bytes)
+		Packed,			///< Float position, octahedral snorm16 normal, half float texcoord (20 bytes)
+		Quantized		///< Same as Packed, with the position quantized to unorm16 relatively to the BoundingBox (16 bytes)
+	};
+	
+	/**
+	 * Vertex of VertexFormat::Packed.
+	**/
+	struct PackedVertex
+	{
+		glm::vec3		position;
+		glm::i16vec2	normal;		///< Octahedral encoding, snorm16
+		glm::u16vec2	texcoord;	///< Half float
+	};
+	
+	/**
+	 * Vertex of VertexFormat::Quantized.
+	**/
+	struct QuantizedVertex
+	{
+		glm::u16vec4	position;	///< unorm16 in the quantization box (w is padding)
+		glm::i16vec2	normal;		///< Octahedral encoding, snorm16
+		glm::u16vec2	texcoord;	///< Half float
+	};
+	
+	/**
+	 * Describes one vertex attribute, as expected by VertexArray::attribute.
+	**/
+	struct VertexAttribute
+	{
+		GLuint		index;
+		GLint		size;
+		Type		type;
+		bool		normalized;
+		size_t		offset;
+	};
+	
+	/**
+	 * Describes the layout of the vertex buffer.
+	 * Used by Mesh::createVAO and MeshBatch::createVAO.
+	**/
+	struct VertexLayout
+	{
+		std::vector<VertexAttribute>	attributes;
+		size_t							stride;
+		bool							octahedralNormals;	///< Normals have to be decoded in the vertex shader (see octahedral.glsl)
+		
+		static const VertexLayout& get(VertexFormat format);
+	};
+	
 	Mesh();
 
 	inline std::vector<Vertex>&			getVertices()		{ return _vertices; }			///< @return Array of Vertices
@@ -62,11 +124,75 @@ public:
 	inline const VertexArray& 			getVAO()			const { return _vao; }			///< @return VertexArray Object
 	inline const Buffer& 				getVertexBuffer()	const { return _vertex_buffer; }///< @return Vertex Buffer
 	inline const Buffer&				getIndexBuffer()	const { return _index_buffer; }	///< @return Index Buffer
+	inline VertexFormat					getVertexFormat()	const { return _vertex_format; }///< @return Layout of the GPU vertices
+	inline const VertexLayout&			getVertexLayout()	const { return VertexLayout::get(_vertex_format); }
+	/**
+	 * Transforms the vertex buffer positions to model space (identity unless the positions are quantized).
+	 * Has to be applied to the ModelMatrix.
+	**/
+	inline const glm::mat4&				getPositionDecodeMatrix() const { return _position_decode; }
 	
 	inline void	setName(const std::string& name) { _name = name; }
 	
+	/**
+	 * Keeps a texture used by the material of this mesh from being evicted while the mesh exists.
+	**/
+	inline void addTextureReference(Ref<Texture> texture) { _texture_refs.push_back(std::move(texture)); }
+	
+	/**
+	 * Selects the layout of the GPU vertices. Has to be called before createVAO().
+	**/
+	void setVertexFormat(VertexFormat format);
+	
+	/// VertexFormat of the meshes loaded from now on (see load(), AsyncLoader::loadMeshes()).
+	static VertexFormat LoadedVertexFormat;
+	
+	/**
+	 * Sets the ModelMatrix of the current program (and the uniforms used to decode the vertices).
+	 * @param modelMatrix Model to world transformation
+	**/
+	void setModelMatrix(const glm::mat4& modelMatrix) const;
+	void setModelMatrix(const Program& program, const glm::mat4& modelMatrix) const;
+	
 	void computeNormals();
+	
+	/**
+	 * Moves the vertices so the origin is at the center of the bottom of the bounding box.
+	 * @return Translation applied to the vertices (opposite).
+	**/
 	glm::vec3 resetPivot();
+	/// @return Sum of the translations removed by resetPivot() (Mesh::load resets the pivot of imported meshes).
+	inline const glm::vec3& getPivot() const { return _pivot; }
+
+	/**
+	 * Merges identical vertices, then reorders triangles (post-transform cache)
+	 * and vertices (pre-transform cache). Logs the resulting statistics.
+	**/
+	void optimize();
+
+	/**
+	 * Merges vertices sharing the same position, normal and texcoord.
+	**/
+	void weldVertices();
+
+	/**
+	 * Reorders triangles to maximize post-transform vertex cache hits (Tom Forsyth's algorithm).
+	 * @see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+	**/
+	void optimizeVertexCache();
+
+	/**
+	 * Reorders vertices by first use in the index buffer.
+	**/
+	void optimizeVertexFetch();
+
+	/**
+	 * @param cacheSize Size of the simulated FIFO vertex cache.
+	 * @return Average Cache Miss Ratio (transformed vertices per triangle, 3.0 is the worst case)
+	**/
+	float computeACMR(size_t cacheSize = VertexCacheSize) const;
+
+	static constexpr size_t VertexCacheSize = 32;
 	
 	void createVAO();
 	void update();
@@ -82,8 +208,56 @@ public:
 	}
 	inline const BoundingBox& getBoundingBox() const	{ return _bbox; }
 
+	/**
+	 * Loads all the shapes of an OBJ file (and its materials) and registers them to Resources.
+	 * Imported meshes are optimized and their pivot reset, then saved to a binary
+	 * cache (path + CacheExtension) reused by later loads as long as the source file doesn't change.
+	 * The cache is read through a memory mapping, its arrays copied once to the CPU data of the meshes.
+	 * Same as finalize(*import(path), p).
+	 * The returned meshes aren't referenced: hold a Ref (as MeshRenderer does) to keep them from being evicted
+	 * (see Resources::Budget), Resources::getMesh() reloads them otherwise.
+	**/
 	static std::vector<Mesh*> load(const std::string& path);
 	static std::vector<Mesh*> load(const std::string& path, const Program& p);
+	
+	static constexpr const char*	CacheExtension = ".smesh";
+	static constexpr uint32_t		CacheVersion = 1;		///< Has to be incremented on any change to the cache format.
+	
+	/**
+	 * Material of an imported shape, as described by the source file.
+	**/
+	struct MaterialReference
+	{
+		bool			defined = false;			///< false if the source file had no material
+		glm::vec3		diffuse = glm::vec3{1.0f};
+		std::string		diffuse_texture;			///< Relative to the directory of the source file
+		std::string		normal_texture;				///< Relative to the directory of the source file
+	};
+	
+	/**
+	 * CPU side result of a load, see import() and finalize().
+	**/
+	struct Import
+	{
+		std::string							path;
+		std::string							rep;		///< Directory of path
+		std::vector<std::unique_ptr<Mesh>>	meshes;		///< Not registered to Resources
+		std::vector<MaterialReference>		materials;
+	};
+	
+	/**
+	 * Reads a file (from its cache or the OBJ file itself).
+	 * Uses neither GL nor Resources: can be called from any thread.
+	 * @return nullptr on failure.
+	**/
+	static std::unique_ptr<Import> import(const std::string& path);
+	
+	/**
+	 * Moves the imported meshes to Resources (filling existing empty meshes in place) and sets up their materials.
+	 * Main thread only. Meshes still have to be uploaded (createVAO()).
+	 * @return Meshes in Resources.
+	**/
+	static std::vector<Mesh*> finalize(Import& import, const Program& p);
 
 protected:
 	std::string				_name;	///< Name
@@ -97,6 +271,21 @@ protected:
 	Buffer					_index_buffer;
 	
 	Material 				_material; ///< Base (default) Material for this mesh
+	std::vector<Ref<Texture>>	_texture_refs; ///< Textures used by _material
 	
 	BoundingBox				_bbox;
+	glm::vec3				_pivot = glm::vec3{0.0f};
+	
+	VertexFormat			_vertex_format = VertexFormat::Float;
+	glm::mat4				_position_decode = glm::mat4(1.0f);
+	
+	void upload_vertices(const Vertex* vertices);
+	
+	/**
+	 * @param import Filled with the meshes of the cache
+	 * @return false if the cache is missing, incompatible, out of date or corrupted.
+	**/
+	static bool load_cache(const std::string& cache_path, unsigned long long source_hash, Import& import);
+	static void save_cache(const std::string& cache_path, unsigned long long source_hash,
+						   const std::vector<Mesh*>& meshes, const std::vector<MaterialReference>& materials);
 };
@@ -13,22 +13,24 @@ void MeshBatch::createVAO()
 	
 	_mesh->getVertexBuffer().bind();
 	
-	// Could be declared elsewhere.
-	constexpr unsigned int PerVertexAttributesCount = 3; 
+	const Mesh::VertexLayout& layout = _mesh->getVertexLayout();
+	const unsigned int PerVertexAttributesCount = layout.attributes.size(); 
 	constexpr unsigned int PerInstanceAttributesCount = 4; 
 	
 	for(unsigned int i = 0; i < PerVertexAttributesCount + PerInstanceAttributesCount; ++i)
 		glEnableVertexAttribArray(i);
 
 	// Basic mesh attributes
-    _vao.attribute(0, 3, Type::Float, false, sizeof(Mesh::Vertex), offsetof(struct Mesh::Vertex, position));
-    _vao.attribute(1, 3, Type::Float, true, sizeof(Mesh::Vertex), offsetof(struct Mesh::Vertex, normal));
-    _vao.attribute(2, 2, Type::Float, false, sizeof(Mesh::Vertex), offsetof(struct Mesh::Vertex, texcoord));
+	for(const auto& a : layout.attributes)
+		_vao.attribute(a.index, a.size, a.type, a.normalized, layout.stride, a.offset);
 
-	// Per instance attributes
+	// Per instance attributes (Position decoding of quantized meshes is folded in the model matrices)
+	std::vector<InstanceData> instances_data(_instances_data);
+	for(auto& i : instances_data)
+		i.modelMatrix = i.modelMatrix * _mesh->getPositionDecodeMatrix();
 	_instances_attributes.init();
 	_instances_attributes.bind();
-	_instances_attributes.data(_instances_data.data(), sizeof(InstanceData) * _instances_data.size(), Buffer::Usage::StaticDraw);
+	_instances_attributes.data(instances_data.data(), sizeof(InstanceData) * instances_data.size(), Buffer::Usage::StaticDraw);
 	for(int i = 0; i < 4; ++i)
 	{
 		_vao.attribute(PerVertexAttributesCount + i, 4, Type::Float, false, sizeof(InstanceData), (sizeof(float) * i * 4));
@@ -1,38 +1,59 @@
 #include <MeshRenderer.hpp>
 
-#include <Context.hpp>
 #include <Resources.hpp>
 
+namespace
+{
+
+Ref<Mesh> reference(const Mesh& mesh)
+{
+	auto h = Resources::_meshes.find(mesh.getName());
+	if(Resources::_meshes.get(h) != &mesh) // Not managed by Resources
+		return {};
+	return Resources::_meshes.ref(h);
+}
+
+}
+
 MeshRenderer::MeshRenderer(const Mesh& mesh) :
 	_mesh{&mesh},
-	_material{mesh.getMaterial()},
+	_mesh_ref{reference(mesh)},
+	_material{Material::share(mesh.getMaterial())},
 	_entity{get_owner<MeshRenderer>(*this)}
 {
-	_occlusion_query.init();
 	_aabb_vertices_buffer.init();
 	update_aabb_vertices();
 }
 
 MeshRenderer::MeshRenderer(MeshRenderer&& m) :
 	_mesh{m._mesh},
+	_mesh_ref{std::move(m._mesh_ref)},
 	_material{std::move(m._material)},
+	_private_material{std::move(m._private_material)},
 	_entity{m._entity}
 {
+	occluder = m.occluder;
 	m._mesh = nullptr;
 	m._entity = invalid_entity;
-	_occlusion_query.init();
 	_aabb_vertices_buffer.init();
 	update_aabb_vertices();
 }
 
 MeshRenderer::MeshRenderer(const nlohmann::json& json) :
-	_mesh{&Resources::getMesh(json["mesh"])},
-	_material{_mesh->getMaterial()},
+	_mesh{&Resources::getMesh(json["mesh"].get<std::string>())},
+	_mesh_ref{reference(*_mesh)},
 	_entity{get_owner<MeshRenderer>(*this)}
 {
 	if(json.count("material") > 0)
-		update_material(json["material"], _material);
-	_occlusion_query.init();
+	{
+		Material material{_mesh->getMaterial()};
+		update_material(json["material"], material);
+		_material = Material::share(std::move(material));
+	} else {
+		_material = Material::share(_mesh->getMaterial());
+	}
+	if(json.count("occluder") > 0)
+		occluder = json["occluder"].get<bool>();
 	_aabb_vertices_buffer.init();
 	update_aabb_vertices();
 }
@@ -41,10 +62,36 @@ nlohmann::json MeshRenderer::json() const
 {
 	return {
 		{"mesh", getMesh().getName()},
-		{"material", tojson(getMaterial())}
+		{"material", tojson(getMaterial())},
+		{"occluder", occluder}
 	};
 }
 
+Material& MeshRenderer::editMaterial()
+{
+	assert(_material);
+	if(!_private_material)
+	{
+		_private_material = std::make_shared<Material>(*_material);
+		_material = _private_material;
+	}
+	return *_private_material;
+}
+
+void MeshRenderer::setMaterial(Material&& material)
+{
+	_material = Material::share(std::move(material));
+	_private_material.reset();
+}
+
+void MeshRenderer::shareMaterial()
+{
+	if(!_private_material)
+		return;
+	_material = Material::share(std::move(*_private_material));
+	_private_material.reset();
+}
+
 bool MeshRenderer::isVisible(const Frustum& f) const
 {
     return f.isIntersecting(getAABB());
@@ -129,18 +176,3 @@ void MeshRenderer::draw_bounding_box() const
 	setUniform("ModelMatrix", getTransformation().getGlobalMatrix());
 	glDrawArrays(GL_TRIANGLES, 0, 12 * 3 * 3);
 }
-
-void MeshRenderer::occlusion_query()
-{
-	glDepthFunc(GL_LEQUAL);
-	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-	glDepthMask(GL_FALSE);
-	Context::disable(Capability::CullFace);
-	_occlusion_query.begin(Query::Target::AnySamplesPassed);
-	draw_bounding_box();
-	_occlusion_query.end();
-	Context::enable(Capability::CullFace);
-	glDepthMask(GL_TRUE);
-	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-	glDepthFunc(GL_LESS);
-}
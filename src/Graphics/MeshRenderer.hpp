@@ -4,9 +4,12 @@
 #include <Transformation.hpp>
 #include <Entity.hpp>
 #include <serialization.hpp>
-#include <Query.hpp>
 #include <Frustum.hpp>
 
+/**
+ * Draws a Mesh with the transformation of its entity.
+ * Renderers with identical materials share a single instance (see Material::share).
+**/
 class MeshRenderer
 {
 public:
@@ -17,13 +20,22 @@ public:
 	
 	nlohmann::json json() const;
 	
-	void occlusion_query();
 	inline void draw() const;
-	inline void draw_occlusion_culled() const;
+	/// @param state Only the state that differs is changed (see Scene::draw)
+	inline void draw(Material::BindingState& state) const;
 	void draw_bounding_box() const;
 
-	inline Material& getMaterial()             { return _material; }
-	inline const Material& getMaterial() const { return _material; }
+	inline const Material& getMaterial() const { assert(_material); return *_material; }
+	/**
+	 * Copy-on-write access to the material: a shared material is copied first.
+	 * The copy is private to this renderer until shareMaterial() (or setMaterial()).
+	**/
+	Material& editMaterial();
+	/// Replaces the material by the shared instance equal to material.
+	void setMaterial(Material&& material);
+	/// Replaces a private material (see editMaterial) by the equal shared instance.
+	void shareMaterial();
+	inline bool hasPrivateMaterial() const { return _private_material != nullptr; }
 	inline const Mesh& getMesh()         const { return *_mesh; }
 	
 	inline const Transformation& getTransformation() const { return entities[_entity].get<Transformation>(); }
@@ -33,12 +45,15 @@ public:
 	
 	inline AABB<glm::vec3> getAABB() const;
 	
+	bool	occluder = false;	///< Rasterized by the software occlusion culling (should be large and simple, see OcclusionRasterizer)
+	
 private:
 	const Mesh*				_mesh = nullptr;	
-	Material				_material;
+	Ref<Mesh>				_mesh_ref;			///< Keeps _mesh from being evicted (if it is managed by Resources)
+	std::shared_ptr<const Material>	_material;			///< Shared, or _private_material
+	std::shared_ptr<Material>		_private_material;	///< Set by editMaterial()
 	EntityID				_entity = invalid_entity;
 	
-	Query 							_occlusion_query;
 	std::array<glm::vec3, 12 * 3>	_aabb_vertices;
 	Buffer							_aabb_vertices_buffer;
 	
@@ -47,21 +62,21 @@ private:
 
 inline void MeshRenderer::draw() const
 {
-	assert(_mesh != nullptr);
-	assert(_entity != invalid_entity);
-	
-	_material.use();
-	setUniform("ModelMatrix", getTransformation().getGlobalMatrix());
-	_mesh->draw();
+	Material::BindingState state;
+	draw(state);
 }
 
-inline void MeshRenderer::draw_occlusion_culled() const
+inline void MeshRenderer::draw(Material::BindingState& state) const
 {
-	glBeginConditionalRender(_occlusion_query.getName(), GL_QUERY_NO_WAIT);
+	assert(_mesh != nullptr);
+	assert(_entity != invalid_entity);
 	
-	draw();
-		
-	glEndConditionalRender();
+	_material->use(state);
+	if(_material->setModelIndex(static_cast<GLint>(get_id(*this))))
+		_material->setOctahedralNormals(_mesh->getVertexLayout().octahedralNormals);
+	else
+		_mesh->setModelMatrix(getTransformation().getGlobalMatrix());
+	_mesh->draw();
 }
 
 inline AABB<glm::vec3> MeshRenderer::getAABB() const
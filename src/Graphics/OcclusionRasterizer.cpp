@@ -0,0 +1,273 @@
+#include <OcclusionRasterizer.hpp>
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <ThreadPool.hpp>
+
+static_assert(OcclusionRasterizer::Width % 4 == 0, "Rows are processed 4 pixels at a time.");
+static_assert(OcclusionRasterizer::Height % OcclusionRasterizer::BandHeight == 0, "Bands have to cover the depth buffer.");
+
+OcclusionRasterizer::OcclusionRasterizer() :
+	_viewProjection(1.0f)
+{
+	_depth.fill(1.0f);
+}
+
+void OcclusionRasterizer::begin(const glm::mat4& viewProjection)
+{
+	_viewProjection = viewProjection;
+	_depth.fill(1.0f);
+	_occluders.clear();
+	_triangleCount = 0;
+}
+
+void OcclusionRasterizer::addOccluder(const glm::mat4& model, const void* positions, size_t stride, const uint32_t* indices, size_t triangleCount)
+{
+	_occluders.push_back(Occluder{model, static_cast<const char*>(positions), stride, indices, triangleCount});
+}
+
+void OcclusionRasterizer::render(ThreadPool* pool)
+{
+	_triangles.resize(_occluders.size());
+	auto setup_occluder = [&](size_t i) {
+		_triangles[i].clear();
+		setup(_occluders[i], _triangles[i]);
+	};
+	auto band = [&](size_t b) { rasterize_band(b); };
+
+	if(pool != nullptr)
+		pool->parallel_for(_occluders.size(), setup_occluder);
+	else
+		for(size_t i = 0; i < _occluders.size(); ++i)
+			setup_occluder(i);
+
+	_triangleCount = 0;
+	for(const auto& t : _triangles)
+		_triangleCount += t.size();
+
+	// Bands don't overlap: no synchronisation needed
+	constexpr size_t bands = Height / BandHeight;
+	if(pool != nullptr)
+		pool->parallel_for(bands, band);
+	else
+		for(size_t b = 0; b < bands; ++b)
+			band(b);
+}
+
+bool OcclusionRasterizer::isVisible(const AABB<glm::vec3>& box) const
+{
+	glm::vec2 smin{std::numeric_limits<float>::max()};
+	glm::vec2 smax{std::numeric_limits<float>::lowest()};
+	float zmin = std::numeric_limits<float>::max();
+	for(int i = 0; i < 8; ++i)
+	{
+		const glm::vec3 corner{(i & 1) == 0 ? box.min.x : box.max.x,
+							   (i & 2) == 0 ? box.min.y : box.max.y,
+							   (i & 4) == 0 ? box.min.z : box.max.z};
+		const glm::vec4 p = _viewProjection * glm::vec4{corner, 1.0f};
+		if(p.w <= 0.0f || p.z < -p.w) // Crosses the near plane
+			return true;
+		const glm::vec3 ndc = glm::vec3{p} / p.w;
+		const glm::vec2 s = (0.5f * glm::vec2{ndc} + 0.5f) * glm::vec2{Width, Height};
+		smin = glm::min(smin, s);
+		smax = glm::max(smax, s);
+		zmin = std::min(zmin, 0.5f * ndc.z + 0.5f);
+	}
+
+	if(smax.x < 0.0f || smax.y < 0.0f || smin.x >= Width || smin.y >= Height || zmin > 1.0f) // Outside of the frustum, not our business.
+		return true;
+	// Pixels touched by the box, and their neighbours: occluders are sampled at the center
+	// of the pixels and may overlap the box by less than a pixel.
+	const int xmin = std::max(0, static_cast<int>(std::floor(smin.x)) - 1);
+	const int xmax = std::min(static_cast<int>(Width) - 1, static_cast<int>(std::floor(smax.x)) + 1);
+	const int ymin = std::max(0, static_cast<int>(std::floor(smin.y)) - 1);
+	const int ymax = std::min(static_cast<int>(Height) - 1, static_cast<int>(std::floor(smax.y)) + 1);
+
+	for(int y = ymin; y <= ymax; ++y)
+	{
+		const float* row = _depth.data() + y * Width;
+#ifdef __SSE2__
+		if(UseSIMD)
+		{
+			const __m128 z = _mm_set1_ps(zmin);
+			const __m128 first = _mm_set1_ps(static_cast<float>(xmin));
+			const __m128 last = _mm_set1_ps(static_cast<float>(xmax));
+			for(int x = xmin & ~3; x <= xmax; x += 4)
+			{
+				const __m128 lanes = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+				const __m128 inside = _mm_and_ps(_mm_cmpge_ps(lanes, first), _mm_cmple_ps(lanes, last));
+				const __m128 behind = _mm_cmpge_ps(_mm_load_ps(row + x), z); // The occluder (if any) is behind the box
+				if(_mm_movemask_ps(_mm_and_ps(inside, behind)) != 0)
+					return true;
+			}
+			continue;
+		}
+#endif
+		for(int x = xmin; x <= xmax; ++x)
+			if(row[x] >= zmin)
+				return true;
+	}
+	return false;
+}
+
+void OcclusionRasterizer::setup(const Occluder& o, std::vector<Triangle>& triangles) const
+{
+	const glm::mat4 mvp = _viewProjection * o.model;
+	auto vertex = [&](uint32_t i) {
+		const float* p = reinterpret_cast<const float*>(o.positions + i * o.stride);
+		return mvp * glm::vec4{p[0], p[1], p[2], 1.0f};
+	};
+
+	for(size_t t = 0; t < o.triangleCount; ++t)
+	{
+		const std::array<glm::vec4, 3> v{vertex(o.indices[3 * t]), vertex(o.indices[3 * t + 1]), vertex(o.indices[3 * t + 2])};
+
+		// Trivial rejection against the side planes
+		bool outside = false;
+		for(int axis = 0; axis < 2 && !outside; ++axis)
+			outside = (v[0][axis] > v[0].w && v[1][axis] > v[1].w && v[2][axis] > v[2].w) ||
+					  (v[0][axis] < -v[0].w && v[1][axis] < -v[1].w && v[2][axis] < -v[2].w);
+		if(outside)
+			continue;
+
+		// Clipping against the near plane (z >= -w)
+		auto distance = [](const glm::vec4& p) { return p.z + p.w; };
+		const int inside_count = (distance(v[0]) >= 0.0f) + (distance(v[1]) >= 0.0f) + (distance(v[2]) >= 0.0f);
+		if(inside_count == 0)
+			continue;
+		if(inside_count == 3)
+		{
+			setup_triangle(v[0], v[1], v[2], triangles);
+			continue;
+		}
+
+		std::array<glm::vec4, 4> polygon;
+		size_t count = 0;
+		for(size_t i = 0; i < 3; ++i)
+		{
+			const glm::vec4& a = v[i];
+			const glm::vec4& b = v[(i + 1) % 3];
+			const float da = distance(a);
+			const float db = distance(b);
+			if(da >= 0.0f)
+				polygon[count++] = a;
+			if((da >= 0.0f) != (db >= 0.0f))
+				polygon[count++] = a + (da / (da - db)) * (b - a);
+		}
+		for(size_t i = 2; i < count; ++i)
+			setup_triangle(polygon[0], polygon[i - 1], polygon[i], triangles);
+	}
+}
+
+void OcclusionRasterizer::setup_triangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2, std::vector<Triangle>& triangles) const
+{
+	auto to_screen = [](const glm::vec4& p) {
+		const glm::vec3 ndc = glm::vec3{p} / std::max(p.w, 1e-6f);
+		return glm::vec3{(0.5f * ndc.x + 0.5f) * Width, (0.5f * ndc.y + 0.5f) * Height, 0.5f * ndc.z + 0.5f};
+	};
+	std::array<glm::vec3, 3> s{to_screen(v0), to_screen(v1), to_screen(v2)};
+
+	float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[1].y - s[0].y) * (s[2].x - s[0].x);
+	if(std::abs(area) < 1e-6f)
+		return;
+	if(area < 0.0f) // Occluders are double sided
+	{
+		std::swap(s[1], s[2]);
+		area = -area;
+	}
+	if(s[0].z > 1.0f && s[1].z > 1.0f && s[2].z > 1.0f) // Beyond the far plane
+		return;
+
+	Triangle t;
+	t.xmin = std::max(0, static_cast<int>(std::floor(std::min({s[0].x, s[1].x, s[2].x}))));
+	t.xmax = std::min(static_cast<int>(Width) - 1, static_cast<int>(std::floor(std::max({s[0].x, s[1].x, s[2].x}))));
+	t.ymin = std::max(0, static_cast<int>(std::floor(std::min({s[0].y, s[1].y, s[2].y}))));
+	t.ymax = std::min(static_cast<int>(Height) - 1, static_cast<int>(std::floor(std::max({s[0].y, s[1].y, s[2].y}))));
+	if(t.xmin > t.xmax || t.ymin > t.ymax)
+		return;
+
+	// Edge i goes from vertex i to vertex i + 1, its function is the (scaled) barycentric coordinate of vertex i + 2.
+	for(size_t i = 0; i < 3; ++i)
+	{
+		const glm::vec3& p = s[i];
+		const glm::vec3& q = s[(i + 1) % 3];
+		t.a[i] = p.y - q.y;
+		t.b[i] = q.x - p.x;
+		t.c[i] = -(t.a[i] * p.x + t.b[i] * p.y);
+	}
+
+	const float inv_area = 1.0f / area;
+	t.zx = (t.a[1] * s[0].z + t.a[2] * s[1].z + t.a[0] * s[2].z) * inv_area;
+	t.zy = (t.b[1] * s[0].z + t.b[2] * s[1].z + t.b[0] * s[2].z) * inv_area;
+	t.zc = (t.c[1] * s[0].z + t.c[2] * s[1].z + t.c[0] * s[2].z) * inv_area;
+	// Farthest depth over the pixel
+	t.zc += 0.5f * (std::abs(t.zx) + std::abs(t.zy));
+
+	triangles.push_back(t);
+}
+
+void OcclusionRasterizer::rasterize(const Triangle& t, int ymin, int ymax)
+{
+	ymin = std::max(ymin, t.ymin);
+	ymax = std::min(ymax, t.ymax);
+	for(int y = ymin; y <= ymax; ++y)
+	{
+		const float py = y + 0.5f;
+		float* row = _depth.data() + y * Width;
+#ifdef __SSE2__
+		if(UseSIMD)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 e0 = _mm_set1_ps(t.b[0] * py + t.c[0]);
+			const __m128 e1 = _mm_set1_ps(t.b[1] * py + t.c[1]);
+			const __m128 e2 = _mm_set1_ps(t.b[2] * py + t.c[2]);
+			const __m128 a0 = _mm_set1_ps(t.a[0]);
+			const __m128 a1 = _mm_set1_ps(t.a[1]);
+			const __m128 a2 = _mm_set1_ps(t.a[2]);
+			const __m128 z0 = _mm_set1_ps(t.zy * py + t.zc);
+			const __m128 zx = _mm_set1_ps(t.zx);
+			for(int x = t.xmin & ~3; x <= t.xmax; x += 4)
+			{
+				const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+				__m128 mask = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0), zero);
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1), zero));
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2), zero));
+				if(_mm_movemask_ps(mask) == 0)
+					continue;
+				const __m128 z = _mm_add_ps(_mm_mul_ps(zx, px), z0);
+				const __m128 old = _mm_load_ps(row + x);
+				const __m128 nearest = _mm_min_ps(old, z);
+				_mm_store_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearest), _mm_andnot_ps(mask, old)));
+			}
+			continue;
+		}
+#endif
+		// Same operations as the SSE path (edge functions factorized by row): same results.
+		const float e0 = t.b[0] * py + t.c[0];
+		const float e1 = t.b[1] * py + t.c[1];
+		const float e2 = t.b[2] * py + t.c[2];
+		const float z0 = t.zy * py + t.zc;
+		for(int x = t.xmin; x <= t.xmax; ++x)
+		{
+			const float px = x + 0.5f;
+			if(t.a[0] * px + e0 >= 0.0f && t.a[1] * px + e1 >= 0.0f && t.a[2] * px + e2 >= 0.0f)
+				row[x] = std::min(row[x], t.zx * px + z0);
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterize_band(size_t band)
+{
+	const int ymin = band * BandHeight;
+	const int ymax = ymin + BandHeight - 1;
+	for(const auto& triangles : _triangles)
+		for(const auto& t : triangles)
+			if(t.ymin <= ymax && t.ymax >= ymin)
+				rasterize(t, ymin, ymax);
+}
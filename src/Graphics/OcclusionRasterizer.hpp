@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include <BoundingShape.hpp>
+
+class ThreadPool;
+
+/**
+ * Coarse CPU depth buffer for occlusion culling (no GL involved).
+ * Large occluders are rasterized (SSE when available, pixel centers) with the farthest
+ * depth of the triangle over each pixel. Occludees (AABBs) are then tested against it,
+ * including one pixel around them to account for the coarse sampling of the occluders:
+ * isVisible() only returns false if the box is entirely behind the occluders.
+ * Depth is the window depth of OpenGL ([0, 1], 1 being the far plane).
+ *
+ * Usage: begin(), addOccluder() for each occluder, render(), then isVisible().
+**/
+class OcclusionRasterizer
+{
+public:
+	static constexpr size_t Width = 256;
+	static constexpr size_t Height = 128;
+	static constexpr size_t BandHeight = 16;	///< Rows rasterized by a single task
+
+	/// SSE path when compiled with SSE2, the scalar one is kept as a reference (see exe/OcclusionRasterizerTest.cpp).
+	bool UseSIMD = true;
+
+	OcclusionRasterizer();
+
+	/**
+	 * Clears the depth buffer and the occluders.
+	 * @param viewProjection Matrices of the camera
+	**/
+	void begin(const glm::mat4& viewProjection);
+
+	/**
+	 * The data isn't copied, it has to remain valid until render().
+	 * @param positions First vertex position (3 floats)
+	 * @param stride Distance between two vertex positions, in bytes.
+	 * @param indices 3 indices per triangle
+	**/
+	void addOccluder(const glm::mat4& model, const void* positions, size_t stride, const uint32_t* indices, size_t triangleCount);
+
+	/**
+	 * Rasterizes the occluders. Uses the workers of pool if not null.
+	**/
+	void render(ThreadPool* pool = nullptr);
+
+	/// @return false if box is entirely occluded.
+	bool isVisible(const AABB<glm::vec3>& box) const;
+
+	/// @return Depth buffer, Width * Height values, row by row from the bottom of the screen.
+	inline const float* getDepth() const { return _depth.data(); }
+
+	inline size_t getTriangleCount() const { return _triangleCount; }	///< Rasterized by the last render()
+
+private:
+	struct Occluder
+	{
+		glm::mat4		model;
+		const char*		positions;
+		size_t			stride;
+		const uint32_t*	indices;
+		size_t			triangleCount;
+	};
+
+	/**
+	 * Screen space triangle, ready to be rasterized.
+	**/
+	struct Triangle
+	{
+		std::array<float, 3>	a, b, c;			///< Edge functions: a * x + b * y + c >= 0 inside
+		float					zx, zy, zc;			///< Depth plane, farthest depth of the triangle over the pixel
+		int						xmin, xmax, ymin, ymax;
+	};
+
+	glm::mat4				_viewProjection;
+	alignas(16) std::array<float, Width * Height>	_depth;
+	std::vector<Occluder>	_occluders;
+	std::vector<std::vector<Triangle>>	_triangles;	///< By occluder
+	size_t					_triangleCount = 0;
+
+	void setup(const Occluder& o, std::vector<Triangle>& triangles) const;
+	void setup_triangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2, std::vector<Triangle>& triangles) const;
+	void rasterize(const Triangle& t, int ymin, int ymax);
+	void rasterize_band(size_t band);
+};
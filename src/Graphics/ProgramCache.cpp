@@ -0,0 +1,172 @@
+#include <ProgramCache.hpp>
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <sys/stat.h>
+
+#include <hash.hpp>
+#include <Log.hpp>
+
+namespace ProgramCache
+{
+
+bool			Enabled = true;
+std::string		Directory = "programcache/";
+
+namespace
+{
+
+constexpr char Magic[4] = {'S', 'P', 'R', 'G'};
+
+struct Header
+{
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	key;
+	uint32_t	format;		///< Binary format returned by the driver
+	uint32_t	size;		///< Size of the binary in bytes
+};
+
+std::string path(unsigned long long key)
+{
+	std::ostringstream ss;
+	ss << Directory << std::hex << std::setw(16) << std::setfill('0') << key << Extension;
+	return ss.str();
+}
+
+std::string driver()
+{
+	std::string r;
+	for(GLenum e : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION})
+	{
+		auto s = glGetString(e);
+		r += s ? reinterpret_cast<const char*>(s) : "";
+		r += '\n';
+	}
+	return r;
+}
+
+void create_directory(const std::string& dir)
+{
+#if defined (__WIN32__)
+	mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+}
+
+}
+
+bool isSupported()
+{
+	static const bool supported = []() {
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if(formats == 0)
+			Log::warn("ProgramCache: The driver doesn't support program binaries, the cache is disabled.");
+		return formats > 0;
+	}();
+	return supported;
+}
+
+unsigned long long key(const std::vector<std::string>& files)
+{
+	static const std::string driver_string = driver();
+	auto k = hash_rt(driver_string.data(), driver_string.size());
+	for(const auto& f : files)
+	{
+		std::ifstream in(f, std::ios::binary);
+		std::ostringstream content;
+		content << in.rdbuf();
+		const auto s = content.str();
+		k = hash_rt(f.data(), f.size() + 1, k); // Separator included
+		k = hash_rt(s.data(), s.size(), k);
+	}
+	return k;
+}
+
+void prepare(GLuint program)
+{
+	if(Enabled && isSupported())
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool load(GLuint program, unsigned long long key)
+{
+	if(!Enabled || !isSupported())
+		return false;
+	
+	std::ifstream in(path(key), std::ios::binary);
+	if(!in)
+		return false;
+	
+	Header header;
+	if(!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+	   std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+	   header.version != Version || header.key != key)
+		return false;
+	std::vector<char> binary(header.size);
+	if(!in.read(binary.data(), binary.size()))
+		return false;
+	
+	glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+	// The driver may reject a binary (updated driver, different hardware...)
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+void save(GLuint program, unsigned long long key)
+{
+	if(!Enabled || !isSupported())
+		return;
+	
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+	
+	create_directory(Directory);
+	const std::string cache_path = path(key);
+	const std::string tmp_path = cache_path + ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ios::binary);
+		if(!out)
+		{
+			Log::warn("ProgramCache: Could not write '", cache_path, "'.");
+			return;
+		}
+		Header header;
+		std::memcpy(header.magic, Magic, sizeof(Magic));
+		header.version = Version;
+		header.key = key;
+		header.format = format;
+		header.size = static_cast<uint32_t>(length);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(binary.data(), binary.size());
+		if(!out)
+		{
+			Log::warn("ProgramCache: Error while writing '", cache_path, "'.");
+			out.close();
+			std::remove(tmp_path.c_str());
+			return;
+		}
+	}
+	std::remove(cache_path.c_str());
+	if(std::rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+		Log::warn("ProgramCache: Could not write '", cache_path, "'.");
+}
+
+Statistics& getStatistics()
+{
+	static Statistics stats;
+	return stats;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/gl3w.h>
+
+/**
+ * On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary),
+ * used by Resources to skip GLSL compilation at startup.
+ * Binaries are keyed by the sources of the program (including their '#pragma include' dependencies)
+ * and by the driver: updating either simply misses the cache.
+**/
+namespace ProgramCache
+{
+
+constexpr const char*	Extension = ".sprog";
+constexpr uint32_t		Version = 1;		///< Has to be incremented on any change to the cache format.
+
+extern bool				Enabled;
+extern std::string		Directory;			///< Where the binaries are stored (created if needed)
+
+/**
+ * @param files Source files of the program (including the included files).
+ * @return Key of the program for the current driver.
+**/
+unsigned long long key(const std::vector<std::string>& files);
+
+/**
+ * Has to be called before linking a program that will be saved.
+**/
+void prepare(GLuint program);
+
+/**
+ * Loads a cached binary in program.
+ * @return true if the program is linked and ready to use.
+**/
+bool load(GLuint program, unsigned long long key);
+
+/**
+ * Saves the binary of a linked program.
+**/
+void save(GLuint program, unsigned long long key);
+
+/// @return true if the driver supports at least one binary format
+bool isSupported();
+
+/**
+ * Programs built by Resources since the start of the application.
+**/
+struct Statistics
+{
+	size_t	hits = 0;		///< Programs loaded from the cache
+	size_t	misses = 0;		///< Programs compiled from sources
+	double	time = 0.0;		///< Total time spent building programs (ms)
+};
+
+Statistics& getStatistics();
+
+}
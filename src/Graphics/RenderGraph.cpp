@@ -0,0 +1,247 @@
+#include <RenderGraph.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_set>
+
+namespace
+{
+
+/// Barrier making the image stores visible to an access
+GLbitfield barrier_bit(RenderGraph::Access a)
+{
+	switch(a)
+	{
+		case RenderGraph::Access::Sampled: return GL_TEXTURE_FETCH_BARRIER_BIT;
+		case RenderGraph::Access::Image: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+		case RenderGraph::Access::Attachment: return GL_FRAMEBUFFER_BARRIER_BIT;
+	}
+	return GL_ALL_BARRIER_BITS;
+}
+
+size_t bytes_per_pixel(GLenum internalFormat)
+{
+	switch(internalFormat)
+	{
+		case GL_R8: return 1;
+		case GL_RG8: case GL_R16F: return 2;
+		case GL_RGBA8: case GL_RG16F: case GL_R32F: case GL_DEPTH_COMPONENT32F: return 4;
+		case GL_RGBA16F: case GL_RG32F: return 8;
+		case GL_RGBA32F: return 16;
+		default: return 4;
+	}
+}
+
+}
+
+void RenderGraph::reset()
+{
+	_passes.clear();
+	_resources.clear();
+}
+
+RenderGraph::Handle RenderGraph::create(const std::string& name, const TextureDesc& desc)
+{
+	assert(desc.width > 0 && desc.height > 0);
+	_resources.push_back(Resource{name, desc});
+	return _resources.size() - 1;
+}
+
+RenderGraph::Handle RenderGraph::import(const std::string& name, const Texture2D& texture)
+{
+	Resource r{name};
+	r.imported = &texture;
+	_resources.push_back(r);
+	return _resources.size() - 1;
+}
+
+RenderGraph::Pass& RenderGraph::addPass(const std::string& name, const Execute& execute)
+{
+	_passes.emplace_back();
+	_passes.back()._name = name;
+	_passes.back()._execute = execute;
+	return _passes.back();
+}
+
+void RenderGraph::compile()
+{
+	cull();
+	place_barriers();
+	allocate();
+}
+
+void RenderGraph::cull()
+{
+	// Backwards: a pass is needed if it has side effects or writes a texture read by a later needed pass.
+	std::unordered_set<Handle> needed;
+	_culledPasses = 0;
+	for(auto it = _passes.rbegin(); it != _passes.rend(); ++it)
+	{
+		auto& p = *it;
+		p._culled = !p._sideEffect && std::none_of(p._writes.begin(), p._writes.end(),
+			[&](const auto& w) { return needed.count(w.first) > 0; });
+		if(p._culled)
+		{
+			++_culledPasses;
+			continue;
+		}
+		// Earlier writes are overwritten, unless also read by this pass.
+		for(const auto& w : p._writes)
+			needed.erase(w.first);
+		for(const auto& r : p._reads)
+			needed.insert(r.first);
+	}
+}
+
+void RenderGraph::place_barriers()
+{
+	// Accesses not yet synchronized with the last image stores of each texture
+	std::vector<GLbitfield> pending(_resources.size(), 0);
+	_barriers = 0;
+	for(auto& p : _passes)
+	{
+		p._barrier = 0;
+		if(p._culled)
+			continue;
+		for(const auto* accesses : {&p._reads, &p._writes})
+			for(const auto& a : *accesses)
+				p._barrier |= pending[a.first] & barrier_bit(a.second);
+		if(p._barrier != 0)
+		{
+			++_barriers;
+			for(auto& b : pending)
+				b &= ~p._barrier;
+		}
+		for(const auto& w : p._writes)
+			if(w.second == Access::Image)
+				pending[w.first] = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+	}
+}
+
+void RenderGraph::allocate()
+{
+	for(auto& r : _resources)
+		r.used = false;
+	for(size_t i = 0; i < _passes.size(); ++i)
+	{
+		if(_passes[i]._culled)
+			continue;
+		for(const auto* accesses : {&_passes[i]._reads, &_passes[i]._writes})
+			for(const auto& a : *accesses)
+			{
+				auto& r = _resources[a.first];
+				if(!r.used)
+					r.firstUse = i;
+				r.lastUse = std::max(r.lastUse, i);
+				r.used = true;
+			}
+	}
+
+	// Releases the textures unused for too long (before assigning the indices)
+	_pool.erase(std::remove_if(_pool.begin(), _pool.end(), [](const PooledTexture& t) {
+		return t.unusedFrames > MaxUnusedFrames;
+	}), _pool.end());
+	for(auto& t : _pool)
+	{
+		t.busy = false;
+		++t.unusedFrames;
+	}
+
+	// By first use: a pooled texture is free again after the last use of its previous transient.
+	std::vector<Handle> transients;
+	for(Handle h = 0; h < _resources.size(); ++h)
+		if(_resources[h].used && _resources[h].imported == nullptr)
+			transients.push_back(h);
+	std::stable_sort(transients.begin(), transients.end(), [&](Handle l, Handle r) {
+		return _resources[l].firstUse < _resources[r].firstUse;
+	});
+	_transients = transients.size();
+	for(Handle h : transients)
+	{
+		auto& r = _resources[h];
+		auto it = std::find_if(_pool.begin(), _pool.end(), [&](const PooledTexture& t) {
+			return t.desc == r.desc && (!t.busy || t.busyUntil < r.firstUse);
+		});
+		if(it == _pool.end())
+		{
+			_pool.emplace_back();
+			it = _pool.end() - 1;
+			it->desc = r.desc;
+			init_texture(it->texture, r.desc);
+		}
+		it->busy = true;
+		it->busyUntil = r.lastUse;
+		it->unusedFrames = 0;
+		r.texture = static_cast<size_t>(it - _pool.begin());
+	}
+}
+
+void RenderGraph::execute()
+{
+	for(const auto& p : _passes)
+	{
+		auto& timing = _timings[p._name];
+		if(p._culled)
+		{
+			timing.last = 0;
+			continue;
+		}
+		if(p._barrier != 0)
+			glMemoryBarrier(p._barrier);
+		timing.query.begin(Query::Target::TimeElapsed);
+		p._execute(*this);
+		timing.query.end();
+		timing.pending = true;
+	}
+}
+
+const Texture2D& RenderGraph::getTexture(Handle h) const
+{
+	assert(h < _resources.size());
+	const auto& r = _resources[h];
+	if(r.imported != nullptr)
+		return *r.imported;
+	assert(r.used);
+	return _pool[r.texture].texture;
+}
+
+void RenderGraph::updateTimings()
+{
+	for(auto& t : _timings)
+	{
+		if(!t.second.pending)
+			continue;
+		t.second.last = t.second.query.get<GLuint64>();
+		t.second.pending = false;
+	}
+}
+
+GLuint64 RenderGraph::getPassTime(const std::string& name) const
+{
+	const auto it = _timings.find(name);
+	return it == _timings.end() ? 0 : it->second.last;
+}
+
+size_t RenderGraph::getPooledBytes() const
+{
+	size_t bytes = 0;
+	for(const auto& t : _pool)
+	{
+		const size_t level0 = t.desc.width * t.desc.height * bytes_per_pixel(t.desc.internalFormat);
+		bytes += t.desc.mipmaps ? level0 * 4 / 3 : level0;
+	}
+	return bytes;
+}
+
+void RenderGraph::init_texture(Texture2D& t, const TextureDesc& desc)
+{
+	t.setPixelType(desc.type);
+	t.create(nullptr, desc.width, desc.height, desc.internalFormat, desc.format, false);
+	t.set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
+	t.set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
+	if(desc.mipmaps)
+	{
+		t.generateMipmaps(); // Allocates the levels
+		t.set(Texture::Parameter::MinFilter, GL_LINEAR_MIPMAP_NEAREST);
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Texture2D.hpp>
+#include <Query.hpp>
+
+/**
+ * Frame graph: each frame, passes are declared in their execution order with the textures
+ * they read and write, then compile():
+ *  - culls the passes that don't contribute to a pass with side effects (see Pass::sideEffect()),
+ *  - computes the memory barriers needed after the image stores, merged in a single
+ *    glMemoryBarrier before the first pass that needs them,
+ *  - assigns the transient textures (see create()) to pooled ones, the same texture being aliased by
+ *    transients of the same description whose lifetimes don't overlap.
+ * The pool is kept between the frames: the transient textures are only allocated when their
+ * description changes (e.g. resolution) and are released after some unused frames.
+ * The passes are timed by execute(), see getPassTime().
+**/
+class RenderGraph
+{
+public:
+	using Handle = size_t;
+
+	/// How a pass accesses a texture: defines the barriers needed after image stores.
+	enum class Access
+	{
+		Sampled,	///< Texture fetches
+		Image,		///< Image load/store
+		Attachment	///< Framebuffer attachment, blit
+	};
+
+	struct TextureDesc
+	{
+		size_t				width = 0;
+		size_t				height = 0;
+		GLenum				internalFormat = GL_RGBA8;
+		GLenum				format = GL_RGBA;
+		Texture::PixelType	type = Texture::PixelType::UnsignedByte;
+		bool				mipmaps = false;	///< Allocates all the levels
+
+		inline bool operator==(const TextureDesc& d) const
+		{
+			return width == d.width && height == d.height && internalFormat == d.internalFormat &&
+				   format == d.format && type == d.type && mipmaps == d.mipmaps;
+		}
+	};
+
+	using Execute = std::function<void(const RenderGraph&)>;
+
+	class Pass
+	{
+	public:
+		inline Pass& read(Handle h, Access a) { _reads.push_back({h, a}); return *this; }
+		inline Pass& write(Handle h, Access a) { _writes.push_back({h, a}); return *this; }
+		/// The pass is never culled (draws to the screen, reads back to the CPU...).
+		inline Pass& sideEffect() { _sideEffect = true; return *this; }
+
+	private:
+		std::string								_name;
+		Execute									_execute;
+		std::vector<std::pair<Handle, Access>>	_reads;
+		std::vector<std::pair<Handle, Access>>	_writes;
+		bool									_sideEffect = false;
+		bool									_culled = false;
+		GLbitfield								_barrier = 0;	///< Issued before the pass
+
+		friend class RenderGraph;
+	};
+
+	RenderGraph() =default;
+
+	/// Clears the passes and resources of the last frame, keeps the pool of textures.
+	void reset();
+
+	/// @return Handle of a texture managed by the graph, only valid during the frame.
+	Handle create(const std::string& name, const TextureDesc& desc);
+	/// @return Handle of a texture managed by the application.
+	Handle import(const std::string& name, const Texture2D& texture);
+
+	/// Adds a pass, executed after the previous ones.
+	Pass& addPass(const std::string& name, const Execute& execute);
+
+	/// Culling, barriers and allocation of the transient textures.
+	void compile();
+	/// Executes the passes of the last compile().
+	void execute();
+
+	/// Only valid in the passes.
+	const Texture2D& getTexture(Handle h) const;
+
+	/// Fetches the results of the timer queries of the last execute(), once per frame.
+	void updateTimings();
+	/// @return GPU time of the pass during the last execute() fetched by updateTimings(), 0 if culled (ns).
+	GLuint64 getPassTime(const std::string& name) const;
+
+	inline size_t getPassCount() const { return _passes.size(); }
+	inline size_t getCulledPassCount() const { return _culledPasses; }
+	inline size_t getBarrierCount() const { return _barriers; }
+	inline size_t getTransientCount() const { return _transients; }
+	inline size_t getPooledTextureCount() const { return _pool.size(); }
+	size_t getPooledBytes() const;
+
+	/// Pooled textures unused for this number of frames are released.
+	static constexpr size_t MaxUnusedFrames = 3;
+
+private:
+	struct Resource
+	{
+		std::string			name;
+		TextureDesc			desc;
+		const Texture2D*	imported = nullptr;
+		size_t				texture = 0;			///< In _pool, for transients
+		size_t				firstUse = 0;			///< Indices of the first and last (live) passes using it
+		size_t				lastUse = 0;
+		bool				used = false;
+	};
+
+	struct PooledTexture
+	{
+		TextureDesc			desc;
+		Texture2D			texture;
+		size_t				unusedFrames = 0;
+		size_t				busyUntil = 0;			///< Last pass using it, during compile()
+		bool				busy = false;
+	};
+
+	struct Timing
+	{
+		Query				query;
+		bool				pending = false;
+		GLuint64			last = 0;
+	};
+
+	std::vector<Pass>			_passes;
+	std::vector<Resource>		_resources;
+	std::vector<PooledTexture>	_pool;
+	std::unordered_map<std::string, Timing>	_timings;
+
+	size_t						_culledPasses = 0;
+	size_t						_barriers = 0;
+	size_t						_transients = 0;
+
+	void cull();
+	void place_barriers();
+	void allocate();
+	static void init_texture(Texture2D& t, const TextureDesc& desc);
+};
@@ -0,0 +1,250 @@
+#include <ShadowAtlas.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+#include <Resources.hpp>
+#include <ComponentIterator.hpp>
+#include <MeshRenderer.hpp>
+
+namespace
+{
+
+size_t ceil_power_of_two(float target, size_t min, size_t max)
+{
+	size_t s = min;
+	while(s < target && s < max)
+		s *= 2;
+	return s;
+}
+
+/// Inverse of the interleaving of the bits of x (even bits) and y (odd bits).
+glm::uvec2 morton_decode(size_t code)
+{
+	glm::uvec2 r{0};
+	for(size_t bit = 0; (code >> (2 * bit)) != 0; ++bit)
+	{
+		r.x |= ((code >> (2 * bit)) & 1) << bit;
+		r.y |= ((code >> (2 * bit + 1)) & 1) << bit;
+	}
+	return r;
+}
+
+}
+
+const glm::mat4 ShadowAtlas::BiasMatrix
+(
+	0.5, 0.0, 0.0, 0.0,
+	0.0, 0.5, 0.0, 0.0,
+	0.0, 0.0, 0.5, 0.0,
+	0.5, 0.5, 0.5, 1.0
+);
+
+ShadowAtlas::ShadowAtlas(size_t size, Format format) :
+	_size(size),
+	_format(format),
+	_framebuffer(size)
+{
+	assert(size >= MinTileSize && (size & (size - 1)) == 0);
+}
+
+GLenum ShadowAtlas::internal_format() const
+{
+	return _format == Format::RG16F ? GL_RG16F : GL_RG32F;
+}
+
+void ShadowAtlas::init_texture(Texture2D& t, size_t size) const
+{
+	t.init();
+	t.bind();
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format(), size, size, 0, GL_RG, GL_FLOAT, nullptr);
+	t.set(Texture::Parameter::WrapS, GL_CLAMP_TO_EDGE);
+	t.set(Texture::Parameter::WrapT, GL_CLAMP_TO_EDGE);
+	// No mipmaps: they would bleed between the tiles.
+	t.set(Texture::Parameter::MinFilter, GL_LINEAR);
+	t.set(Texture::Parameter::MagFilter, GL_LINEAR);
+	t.unbind();
+}
+
+void ShadowAtlas::init()
+{
+	init_texture(_framebuffer.getColor(), _size);
+	_framebuffer.init();
+	init_texture(_blurBuffer, getMaxTileSize());
+	_initialized = true;
+	
+	if(_depthProgram == nullptr)
+		_depthProgram = &Resources::loadProgram("Light_Depth",
+			Resources::load<VertexShader>("src/GLSL/depth_vs.glsl"),
+			Resources::load<FragmentShader>("src/GLSL/depth_fs.glsl")
+		);
+}
+
+void ShadowAtlas::setFormat(Format format)
+{
+	if(format == _format)
+		return;
+	_format = format;
+	if(_initialized)
+	{
+		_framebuffer = AtlasBuffer(_size);
+		_blurBuffer = Texture2D();
+		init();
+	}
+}
+
+size_t ShadowAtlas::tileSize(float target, size_t previous, size_t max)
+{
+	max = std::max(max, MinTileSize);
+	// Keeps the previous resolution while it isn't too far from the target
+	if(previous >= MinTileSize && previous <= max && previous >= 0.75f * target && previous <= 3.0f * target)
+		return previous;
+	return ceil_power_of_two(target, MinTileSize, max);
+}
+
+std::vector<ShadowAtlas::Tile> ShadowAtlas::allocate(const std::vector<Request>& requests) const
+{
+	auto cells = [](size_t s) { return (s / MinTileSize) * (s / MinTileSize); };
+
+	std::vector<size_t> sizes(requests.size());
+	size_t total = 0;
+	for(size_t i = 0; i < requests.size(); ++i)
+	{
+		sizes[i] = requests[i].size == 0 ? 0 : ceil_power_of_two(requests[i].size, MinTileSize, getMaxTileSize());
+		total += cells(sizes[i]);
+	}
+
+	// Reduces the largest tiles, then drops the least important ones until everything fits.
+	auto less_important = [&](size_t a, size_t b) {
+		return requests[a].importance < requests[b].importance || (requests[a].importance == requests[b].importance && a > b);
+	};
+	while(total > getCapacity())
+	{
+		size_t victim = requests.size();
+		for(size_t i = 0; i < requests.size(); ++i)
+			if(sizes[i] > 0 && (victim == requests.size() || sizes[i] > sizes[victim] ||
+				(sizes[i] == sizes[victim] && less_important(i, victim))))
+				victim = i;
+		total -= cells(sizes[victim]);
+		sizes[victim] = sizes[victim] > MinTileSize ? sizes[victim] / 2 : 0;
+		total += cells(sizes[victim]);
+	}
+
+	// Morton order placement by decreasing size: each tile starts at a multiple of its own area
+	// and is a square block of the grid of MinTileSize cells.
+	std::vector<size_t> order(requests.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+	std::vector<Tile> tiles(requests.size());
+	size_t cursor = 0;
+	for(size_t i : order)
+	{
+		if(sizes[i] == 0)
+			break;
+		tiles[i].offset = morton_decode(cursor) * static_cast<unsigned int>(MinTileSize);
+		tiles[i].size = sizes[i];
+		cursor += cells(sizes[i]);
+	}
+	return tiles;
+}
+
+void ShadowAtlas::begin(const Tile& tile) const
+{
+	_framebuffer.bind();
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(tile.offset.x, tile.offset.y, tile.size, tile.size);
+	Context::viewport(tile.offset.x, tile.offset.y, tile.size, tile.size);
+	_framebuffer.clear(BufferBit::All);
+}
+
+void ShadowAtlas::end() const
+{
+	glDisable(GL_SCISSOR_TEST);
+	_framebuffer.unbind();
+}
+
+void ShadowAtlas::cull(const glm::mat4& viewProjection, std::vector<const MeshRenderer*>& casters)
+{
+	const Frustum frustum{viewProjection};
+	casters.clear();
+	for(const auto& b : ComponentIterator<MeshRenderer>{})
+		if(b.isVisible(frustum))
+			casters.push_back(&b);
+}
+
+size_t ShadowAtlas::hash(const glm::mat4& viewProjection, const std::vector<const MeshRenderer*>& casters)
+{
+	// FNV-1a
+	size_t hash = 14695981039346656037ull;
+	auto add = [&](const void* data, size_t size) {
+		for(size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<const unsigned char*>(data)[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	add(&viewProjection, sizeof(glm::mat4));
+	for(const auto* b : casters)
+	{
+		const Mesh* mesh = &b->getMesh();
+		add(&mesh, sizeof(const Mesh*));
+		add(&b->getTransformation().getGlobalMatrix(), sizeof(glm::mat4));
+	}
+	return hash;
+}
+
+void ShadowAtlas::draw(const Tile& tile, const glm::mat4& viewProjection, const std::vector<const MeshRenderer*>& casters) const
+{
+	assert(_depthProgram != nullptr);
+	begin(tile);
+	_depthProgram->setUniform("DepthVP", viewProjection);
+	_depthProgram->use();
+	Context::disable(Capability::CullFace);
+	
+	for(const auto* b : casters)
+	{
+		b->getMesh().setModelMatrix(*_depthProgram, b->getTransformation().getGlobalMatrix());
+		b->getMesh().draw();
+	}
+	
+	Program::useNone();
+	end();
+	
+	/// @todo Add some way to configure the blur
+	blur(tile);
+}
+
+void ShadowAtlas::blur(const Tile& tile) const
+{
+	static const auto VSMBlurHandle = Resources::getShaderHandle("VSMBlur");
+	ComputeShader& VSMBlur = Resources::isLoaded(VSMBlurHandle) ?
+		Resources::getShader<ComputeShader>(VSMBlurHandle) :
+		Resources::load<ComputeShader>("VSMBlur", "src/GLSL/vsm_blur_cs.glsl");
+	
+	const GLuint groups = static_cast<GLuint>((tile.size + 15) / 16); // See WORKGROUP_SIZE
+	const float size = static_cast<float>(tile.size);
+	Program& program = VSMBlur.getProgram();
+	
+	getTexture().bind(0);
+	_blurBuffer.bindImage(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, internal_format());
+	program.setUniform("SourceRegion", glm::vec4{tile.offset.x, tile.offset.y, size, size});
+	program.setUniform("DestinationOrigin", glm::vec2{0.0f});
+	program.setUniform("Direction", glm::vec2{1.0f, 0.0f});
+	VSMBlur.compute(groups, groups, 1);
+	VSMBlur.memoryBarrier();
+	
+	_blurBuffer.bind(0);
+	getTexture().bindImage(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, internal_format());
+	program.setUniform("SourceRegion", glm::vec4{0.0f, 0.0f, size, size});
+	program.setUniform("DestinationOrigin", glm::vec2{tile.offset});
+	program.setUniform("Direction", glm::vec2{0.0f, 1.0f});
+	VSMBlur.compute(groups, groups, 1);
+	VSMBlur.memoryBarrier();
+}
+
+glm::vec4 ShadowAtlas::getRect(const Tile& tile) const
+{
+	const float s = static_cast<float>(_size);
+	return glm::vec4{tile.offset.x / s, tile.offset.y / s, tile.size / s, tile.size / s};
+}
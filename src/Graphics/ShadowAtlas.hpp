@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <Texture2D.hpp>
+#include <Framebuffer.hpp>
+#include <Shaders.hpp>
+
+class MeshRenderer;
+
+/**
+ * Single shadow map texture shared by all the lights (SpotLights and cascades of DirectionalLights), divided in square tiles
+ * of power of two resolutions (between MinTileSize and getMaxTileSize()).
+ * Tiles are packed in Morton order by decreasing size, which never fragments the atlas:
+ * the placement of a tile only changes if the size or the order of the requests before it changes.
+ * The number of tiles is limited to getCapacity(), i.e. (size / MinTileSize)².
+ * Only the two moments of the variance shadow maps are stored (see Format).
+ * A tile only has to be redrawn when its hash (see hash()) changes.
+**/
+class ShadowAtlas
+{
+public:
+	using AtlasBuffer = Framebuffer<Texture2D, 1, Texture2D, true>;
+
+	static constexpr size_t MinTileSize = 128;
+
+	/**
+	 * Storage of the moments.
+	**/
+	enum class Format
+	{
+		RG16F,	///< Half the memory and bandwidth, less precise (may need a higher minimum variance)
+		RG32F
+	};
+
+	/**
+	 * Region of the atlas, in texels.
+	**/
+	struct Tile
+	{
+		glm::uvec2	offset{0};
+		size_t		size = 0;	///< 0: No tile
+
+		inline bool operator==(const Tile& t) const { return offset == t.offset && size == t.size; }
+		inline bool operator!=(const Tile& t) const { return !(*this == t); }
+	};
+
+	struct Request
+	{
+		size_t		size;			///< Requested resolution, power of two (0: No tile)
+		float		importance;		///< Tiles of the least important requests are reduced first when the atlas is full
+	};
+
+	/**
+	 * @param size Resolution of the atlas, power of two.
+	**/
+	ShadowAtlas(size_t size = 4096, Format format = Format::RG32F);
+
+	/// Bias from clip space to the [0, 1] texture space of a tile.
+	static const glm::mat4 BiasMatrix;
+
+	/// Creates the textures and loads the depth program.
+	void init();
+
+	/// Recreates the textures if needed: the content of all the tiles is lost.
+	void setFormat(Format format);
+
+	inline size_t getSize() const { return _size; }
+	inline Format getFormat() const { return _format; }
+	inline size_t getMaxTileSize() const { return _size / 2; }
+	inline size_t getCapacity() const { return (_size / MinTileSize) * (_size / MinTileSize); }
+
+	inline const AtlasBuffer& getFramebuffer() const { return _framebuffer; }
+	inline const Texture2D& getTexture() const { return _framebuffer.getColor(); }
+
+	/**
+	 * Places the tiles of all the requests. If they don't fit, the largest tiles are halved first
+	 * (the least important first among equals), then the least important are dropped (size of 0).
+	 * No GL calls.
+	 * @return A tile for each request.
+	**/
+	std::vector<Tile> allocate(const std::vector<Request>& requests) const;
+
+	/**
+	 * Power of two resolution covering target, with some hysteresis to avoid reallocating tiles
+	 * back and forth (each new tile has to be rendered again).
+	 * @param target Ideal resolution
+	 * @param previous Resolution of the current tile (0 if none)
+	 * @param max Maximum resolution
+	**/
+	static size_t tileSize(float target, size_t previous, size_t max);
+
+	/**
+	 * Binds the framebuffer and restricts the viewport and the scissor test to the tile, which is cleared.
+	 * The scissor test stays enabled until end().
+	**/
+	void begin(const Tile& tile) const;
+	void end() const;
+
+	/**
+	 * @param casters Filled with the MeshRenderers intersecting the frustum of viewProjection.
+	**/
+	static void cull(const glm::mat4& viewProjection, std::vector<const MeshRenderer*>& casters);
+
+	/**
+	 * @return Hash of viewProjection and of the meshes and matrices of casters.
+	**/
+	static size_t hash(const glm::mat4& viewProjection, const std::vector<const MeshRenderer*>& casters);
+
+	/**
+	 * Renders the moments of the depth of casters to tile, then blurs it.
+	**/
+	void draw(const Tile& tile, const glm::mat4& viewProjection, const std::vector<const MeshRenderer*>& casters) const;
+
+	/**
+	 * Separable gaussian blur of a tile: the horizontal pass goes to a scratch texture,
+	 * the vertical one back to the tile (see vsm_blur_cs.glsl).
+	**/
+	void blur(const Tile& tile) const;
+
+	/**
+	 * @return Offset (xy) and scale (zw) from the [0, 1] texture coordinates of a tile to the atlas.
+	**/
+	glm::vec4 getRect(const Tile& tile) const;
+
+private:
+	size_t			_size;
+	Format			_format;
+	bool			_initialized = false;
+	AtlasBuffer		_framebuffer;
+	Texture2D		_blurBuffer;	///< getMaxTileSize()², result of the horizontal pass of blur()
+	Program*		_depthProgram = nullptr;
+
+	GLenum internal_format() const;
+	void init_texture(Texture2D& t, size_t size) const;
+};
@@ -36,7 +36,8 @@ void Skybox::loadCubeMap(const std::array<std::string, 6>& Paths)
 	
 void Skybox::draw(const glm::mat4& p, const glm::mat4& mv) const
 {
-	Program& P = Resources::getProgram("SkyboxProgram");
+	static const auto SkyboxProgram = Resources::getProgramHandle("SkyboxProgram");
+	Program& P = Resources::getProgram(SkyboxProgram);
 	if(!P)
 	{
 		Resources::loadProgram("SkyboxProgram",
@@ -64,7 +65,8 @@ void Skybox::draw(const glm::mat4& p, const glm::mat4& mv) const
 
 void Skybox::cubedraw() const
 {
-	Program& P = Resources::getProgram("CubeSkyboxProgram");
+	static const auto CubeSkyboxProgram = Resources::getProgramHandle("CubeSkyboxProgram");
+	Program& P = Resources::getProgram(CubeSkyboxProgram);
 	if(!P)
 	{
 		Resources::loadProgram("CubeSkyboxProgram",
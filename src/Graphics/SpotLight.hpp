@@ -3,16 +3,18 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 
-#include <Texture2D.hpp>
-#include <Framebuffer.hpp>
 #include <MeshRenderer.hpp>
+#include <ShadowAtlas.hpp>
 #include <Shaders.hpp>
+#include <Query.hpp>
 #include <serialization.hpp>
 
 /**
  * SpotLight
  *
  * Describes a spotlight which can cast shadows (Variance Shadow Mapping).
+ * Its shadow map is a tile of the ShadowAtlas of the Scene, which is only redrawn
+ * when the light or a MeshRenderer in its frustum moves (see ShadowAtlas::hash()), or each frame if dynamic.
 **/
 class SpotLight
 {
@@ -22,17 +24,17 @@ public:
 		glm::vec4	position_range;
 		glm::vec4	color_info;
 		glm::mat4	depthMVP;
+		glm::vec4	atlas_rect;		///< Tile of the shadow map in the atlas, see ShadowAtlas::getRect() (no shadow if empty)
 	};
-	using ShadowBuffer = Framebuffer<Texture2D, 1, Texture2D, true>;
 	
 	// Public attributes
-	bool			dynamic = false;	///< Tells the application if the shadow map should be redrawn each frame
-	unsigned int	downsampling = 1;	///< Strengh of the shadow map's downsampling
+	bool			dynamic = false;	///< Redraws the shadow map each frame, even if nothing moved (e.g. animated meshes)
+	unsigned int	downsampling = 1;	///< Divides the resolution of the shadow map by 2^downsampling
 	
 	/**
 	 * Constructor
 	 *
-	 * @param shadowMapResolution Resolution of the shadow map depth texture.
+	 * @param shadowMapResolution Maximum resolution of the shadow map (the actual one depends on the size of the light on screen).
 	**/
 	SpotLight(unsigned int shadowMapResolution = 2048);
 	
@@ -45,25 +47,20 @@ public:
 	
 	nlohmann::json json() const;
 
-	/**
-	 * Initialize the shadow mapping attributes (Shaders, Framebuffer...)
-	 * for this light.
-	**/
-	void init();
-	
 	/// @return RW Reference to the color of the light
 	inline glm::vec3& getColor() { return _color; }
 	
 	/// @return Color of the light
 	inline const glm::vec3& getColor() const { return _color; }
 	
-	/// @return SpotLight's GPU buffer.
-	inline const UniformBuffer& getGPUBuffer() const { return _gpuBuffer; }
-	
 	/// @return SpotLight's data structured for GPU use.
 	inline GPUData getGPUData() const { return GPUData{glm::vec4(getTransformation().getPosition(), _range),  
 															glm::vec4(glm::vec3(getColor()), 0.0), 
-															getBiasedMatrix()}; }
+															getBiasedMatrix(),
+															_shadowRect}; }
+	
+	/// @return World space position of the light
+	inline glm::vec3 getGlobalPosition() const { return getTransformation().getGlobalPosition(); }
 	
 	/// @return Range of the light
 	inline float getRange() const { return _range; }
@@ -73,14 +70,31 @@ public:
 	/// @return Light's projection matrix.
 	inline const glm::mat4& getProjectionMatrix() const { return _projection; }
 
-	/// @return Light's shadow map frame buffer.
-	inline const ShadowBuffer& getShadowBuffer() const { return _shadowMapFramebuffer; }
-	
-	/// @return Light's shadow map depth texture.
-	inline const Texture2D& getShadowMap() const { return _shadowMapFramebuffer.getColor(); }
+	/// @return Tile of the shadow map in the ShadowAtlas (size of 0 if none).
+	inline const ShadowAtlas::Tile& getShadowTile() const { return _shadowTile; }
 	
+	/// @return Maximum resolution of the shadow map.
 	inline size_t getResolution() const { return _shadowMapResolution; }
 	
+	/// @return true if the shadow map has to be redrawn, hash being the ShadowAtlas::hash() of its casters.
+	inline bool isShadowMapOutdated(const ShadowAtlas::Tile& tile, size_t hash) const
+	{
+		return dynamic || tile != _shadowTile || hash != _shadowHash;
+	}
+	
+	/// Forces the next update of the shadow map.
+	inline void invalidateShadowMap() { _shadowHash = 0; _shadowTile = ShadowAtlas::Tile{}; }
+	
+	/**
+	 * Assigns a tile of the atlas to this light, without drawing it.
+	 * Used to remove the shadows of lights without tile.
+	**/
+	inline void setShadowTile(const ShadowAtlas& atlas, const ShadowAtlas::Tile& tile)
+	{
+		_shadowTile = tile;
+		_shadowRect = tile.size > 0 ? atlas.getRect(tile) : glm::vec4{0.0f};
+	}
+	
 	/// @return World to SpotLight's view space matrix.
 	inline const glm::mat4& getViewMatrix() const { return _view; }
 
@@ -125,32 +139,24 @@ public:
 	inline void setProjectionMatrix(const glm::mat4& p) { _projection = p; updateMatrices(); }
 	
 	/**
-	 * Warning! Reconstruct the buffer (obviously)
+	 * Sets the maximum resolution of the shadow map, used by the next allocation of the atlas.
 	**/
-	inline void setResolution(size_t r)
-	{
-		_shadowMapResolution = r;
-		_shadowMapFramebuffer = ShadowBuffer(_shadowMapResolution);
-		updateMatrices();
-		init();
-	}
+	inline void setResolution(size_t r) { _shadowMapResolution = r; }
 	
 	/**
-	 * Setup the context to draw to this light' shadow map.
-	 * @todo Find a better name...
+	 * Draws casters to this light's shadow map, in tile of atlas.
+	 * @param casters MeshRenderers in the frustum of the light (see ShadowAtlas::cull())
+	 * @param hash ShadowAtlas::hash() of casters
 	**/
-	void bind() const;
+	void drawShadowMap(const ShadowAtlas& atlas, const ShadowAtlas::Tile& tile, size_t hash, const std::vector<const MeshRenderer*>& casters);
 	
 	/**
-	 * Restores the default framebuffer.
-	 * @todo Find a better name...
+	 * Fetches the GPU time of the last drawShadowMap() (waits for it), once the frame is done.
 	**/
-	void unbind() const;
+	void updateShadowMapTime();
 	
-	/**
-	 * Draws passed objects to this light's shadow map
-	**/
-	void drawShadowMap(const ComponentIterator<MeshRenderer>& objects) const;
+	/// @return GPU time of the last drawShadowMap() fetched by updateShadowMapTime(), in ns.
+	inline GLuint64 getShadowMapTime() const { return _lastShadowTiming; }
 	
 	/**
 	 * Updates SpotLight's internal transformation matrices according to
@@ -160,16 +166,7 @@ public:
 	
 	// Static
 	
-	inline static const glm::mat4& getBiasMatrix() { return s_depthBiasMVP; }
-	
-	/**
-	 * @return Program used to draw the shadow map.
-	**/
-	inline static const Program& getShadowMapProgram()
-	{
-		assert(s_depthProgram != nullptr);
-		return *s_depthProgram;
-	}
+	inline static const glm::mat4& getBiasMatrix() { return ShadowAtlas::BiasMatrix; }
 	
 protected:
 	EntityID			_entity = invalid_entity;
@@ -178,18 +175,17 @@ protected:
 	float				_angle = 0.7853975;			///< SpotLight's opening angle (rad)
 	float				_range = 1000.0; 			///< SpotLight's range, mainly used for the Shadow Mapping settings
 	
-	unsigned int		_shadowMapResolution;		///< Resolution of the shadow map (depth map)
-	ShadowBuffer		_shadowMapFramebuffer;		///< Framebuffer used to draw the shadow map
+	unsigned int		_shadowMapResolution;		///< Maximum resolution of the shadow map (depth map)
+	ShadowAtlas::Tile	_shadowTile;				///< Tile of the last drawShadowMap()
+	glm::vec4			_shadowRect = glm::vec4{0.0f};	///< Of _shadowTile, see ShadowAtlas::getRect()
+	size_t				_shadowHash = 0;			///< Of the last drawShadowMap(), see ShadowAtlas::hash()
+	Query				_shadowTiming;				///< Of the last drawShadowMap()
+	bool				_shadowTimingPending = false;
+	GLuint64			_lastShadowTiming = 0;
 	glm::mat4			_projection;				///< Projection matrix used to draw the shadow map
-	UniformBuffer		_gpuBuffer;					///< Buffer used for shadow mapping
 	glm::mat4			_view;						///< View matrix computed from the transformation
 	glm::mat4			_VPMatrix;					///< ViewProjection matrix used to draw the shadow map
 	glm::mat4			_biasedVPMatrix;			///< Biased ViewProjection matrix used to compute the shadows projected on the scene
 	
 	inline const Transformation& getTransformation() const { return entities[_entity].get<Transformation>(); }
-	
-	// Static
-	static void initPrograms();
-	static const glm::mat4	s_depthBiasMVP;	///< Used to compute the biased ViewProjection matrix
-	static Program* 		s_depthProgram;	///< Program used to draw the shadow map
 };
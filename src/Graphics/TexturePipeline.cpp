@@ -0,0 +1,479 @@
+#include <TexturePipeline.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <Log.hpp>
+#include <MappedFile.hpp>
+#include <hash.hpp>
+
+// S3TC is an extension, not always exposed by the GL loader.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT		0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	0x83F3
+#endif
+
+namespace TexturePipeline
+{
+
+bool CompressionEnabled = true;
+
+namespace
+{
+
+struct CacheHeader
+{
+	char				magic[4];
+	uint32_t			version;
+	unsigned long long	source_hash;
+	uint32_t			usage;
+	uint32_t			allow_compression;
+	uint32_t			compression;
+	uint32_t			level_count;
+};
+
+struct CacheLevel
+{
+	uint32_t	width;
+	uint32_t	height;
+	uint64_t	size;
+};
+
+constexpr char CacheMagic[4] = {'S', 'T', 'E', 'X'};
+
+/**
+ * RGBA8 image
+**/
+struct Image
+{
+	int							width;
+	int							height;
+	std::vector<unsigned char>	pixels;
+};
+
+GLenum internal_format(Compression c)
+{
+	switch(c)
+	{
+		case Compression::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case Compression::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case Compression::BC5: return GL_COMPRESSED_RG_RGTC2;
+		default: return GL_RGBA8;
+	}
+}
+
+size_t block_size(Compression c)
+{
+	return c == Compression::BC1 ? 8 : 16;
+}
+
+/**
+ * 2x2 box filter. Normals are renormalized.
+**/
+Image downsample(const Image& src, Usage usage)
+{
+	Image dst{std::max(1, src.width / 2), std::max(1, src.height / 2), {}};
+	dst.pixels.resize(4 * dst.width * dst.height);
+	for(int y = 0; y < dst.height; ++y)
+		for(int x = 0; x < dst.width; ++x)
+		{
+			unsigned int sum[4] = {0, 0, 0, 0};
+			for(int dy = 0; dy < 2; ++dy)
+				for(int dx = 0; dx < 2; ++dx)
+				{
+					const int sx = std::min(2 * x + dx, src.width - 1);
+					const int sy = std::min(2 * y + dy, src.height - 1);
+					for(int c = 0; c < 4; ++c)
+						sum[c] += src.pixels[4 * (sy * src.width + sx) + c];
+				}
+			unsigned char* p = &dst.pixels[4 * (y * dst.width + x)];
+			for(int c = 0; c < 4; ++c)
+				p[c] = static_cast<unsigned char>((sum[c] + 2) / 4);
+			
+			if(usage == Usage::Normal)
+			{
+				glm::vec3 n{p[0] / 127.5f - 1.0f, p[1] / 127.5f - 1.0f, p[2] / 127.5f - 1.0f};
+				if(glm::dot(n, n) > 0.0f)
+					n = glm::normalize(n);
+				for(int c = 0; c < 3; ++c)
+					p[c] = static_cast<unsigned char>(glm::clamp(std::round((n[c] + 1.0f) * 127.5f), 0.0f, 255.0f));
+			}
+		}
+	return dst;
+}
+
+inline uint16_t pack565(const int c[3])
+{
+	return static_cast<uint16_t>(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+inline void unpack565(uint16_t v, int c[3])
+{
+	const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+/**
+ * Single channel block (BC4), used for BC3 alpha and BC5.
+**/
+void encode_bc4(const unsigned char* rgba, int channel, unsigned char* out)
+{
+	int min = 255, max = 0;
+	for(int i = 0; i < 16; ++i)
+	{
+		min = std::min<int>(min, rgba[4 * i + channel]);
+		max = std::max<int>(max, rgba[4 * i + channel]);
+	}
+	out[0] = static_cast<unsigned char>(max);
+	out[1] = static_cast<unsigned char>(min);
+	
+	uint64_t indices = 0;
+	if(max != min)
+	{
+		// 8 values mode (out[0] > out[1])
+		int palette[8] = {max, min};
+		for(int i = 2; i < 8; ++i)
+			palette[i] = ((8 - i) * max + (i - 1) * min) / 7;
+		for(int i = 0; i < 16; ++i)
+		{
+			const int v = rgba[4 * i + channel];
+			uint64_t best = 0;
+			for(int p = 1; p < 8; ++p)
+				if(std::abs(palette[p] - v) < std::abs(palette[best] - v))
+					best = p;
+			indices |= best << (3 * i);
+		}
+	}
+	for(int i = 0; i < 6; ++i)
+		out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
+/**
+ * Color endpoints: extremes of the block colors along their principal axis, slightly inset.
+**/
+void encode_bc1_color(const unsigned char* rgba, unsigned char* out)
+{
+	glm::vec3 mean{0.0f};
+	for(int i = 0; i < 16; ++i)
+		mean += glm::vec3{rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2]};
+	mean /= 16.0f;
+	
+	glm::mat3 covariance{0.0f};
+	for(int i = 0; i < 16; ++i)
+	{
+		const glm::vec3 d = glm::vec3{rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2]} - mean;
+		covariance += glm::outerProduct(d, d);
+	}
+	// Power iteration, starting from the diagonal of the bounding box
+	glm::vec3 axis{1.0f};
+	for(int i = 0; i < 8; ++i)
+	{
+		axis = covariance * axis;
+		const float l = std::max(std::abs(axis.x), std::max(std::abs(axis.y), std::abs(axis.z)));
+		if(l == 0.0f)
+		{
+			axis = glm::vec3{1.0f};
+			break;
+		}
+		axis /= l;
+	}
+	
+	float min_proj = std::numeric_limits<float>::max(), max_proj = -std::numeric_limits<float>::max();
+	for(int i = 0; i < 16; ++i)
+	{
+		const float proj = glm::dot(glm::vec3{rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2]} - mean, axis);
+		min_proj = std::min(min_proj, proj);
+		max_proj = std::max(max_proj, proj);
+	}
+	const float inset = (max_proj - min_proj) / 16.0f;
+	const glm::vec3 e0 = glm::clamp(mean + (max_proj - inset) * axis / glm::dot(axis, axis), 0.0f, 255.0f);
+	const glm::vec3 e1 = glm::clamp(mean + (min_proj + inset) * axis / glm::dot(axis, axis), 0.0f, 255.0f);
+	const int max[3] = {static_cast<int>(e0.r + 0.5f), static_cast<int>(e0.g + 0.5f), static_cast<int>(e0.b + 0.5f)};
+	const int min[3] = {static_cast<int>(e1.r + 0.5f), static_cast<int>(e1.g + 0.5f), static_cast<int>(e1.b + 0.5f)};
+	
+	uint16_t c0 = pack565(max), c1 = pack565(min);
+	if(c0 < c1)
+		std::swap(c0, c1);
+	
+	uint32_t indices = 0;
+	if(c0 != c1)
+	{
+		// 4 colors mode (c0 > c1)
+		int palette[4][3];
+		unpack565(c0, palette[0]);
+		unpack565(c1, palette[1]);
+		for(int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for(int i = 0; i < 16; ++i)
+		{
+			uint32_t best = 0;
+			int best_dist = std::numeric_limits<int>::max();
+			for(uint32_t p = 0; p < 4; ++p)
+			{
+				int dist = 0;
+				for(int c = 0; c < 3; ++c)
+					dist += (palette[p][c] - rgba[4 * i + c]) * (palette[p][c] - rgba[4 * i + c]);
+				if(dist < best_dist)
+				{
+					best_dist = dist;
+					best = p;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+	for(int i = 0; i < 4; ++i)
+		out[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
+std::vector<unsigned char> compress(const Image& img, Compression c)
+{
+	const int bw = (img.width + 3) / 4;
+	const int bh = (img.height + 3) / 4;
+	const size_t bsize = block_size(c);
+	std::vector<unsigned char> r(bw * bh * bsize);
+	unsigned char block[4 * 16];
+	for(int by = 0; by < bh; ++by)
+		for(int bx = 0; bx < bw; ++bx)
+		{
+			// Texels outside of the image are clamped.
+			for(int y = 0; y < 4; ++y)
+				for(int x = 0; x < 4; ++x)
+				{
+					const int sx = std::min(4 * bx + x, img.width - 1);
+					const int sy = std::min(4 * by + y, img.height - 1);
+					std::memcpy(block + 4 * (4 * y + x), &img.pixels[4 * (sy * img.width + sx)], 4);
+				}
+			unsigned char* out = &r[(by * bw + bx) * bsize];
+			switch(c)
+			{
+				case Compression::BC1: encodeBC1(block, out); break;
+				case Compression::BC3: encodeBC3(block, out); break;
+				case Compression::BC5: encodeBC5(block, out); break;
+				default: break;
+			}
+		}
+	return r;
+}
+
+std::unique_ptr<MipChain> load_cache(const std::string& cache_path, unsigned long long source_hash, Usage usage, bool allowCompression)
+{
+	auto file = std::make_shared<MappedFile>();
+	if(!file->open(cache_path))
+		return nullptr;
+	
+	CacheHeader header;
+	if(file->size() < sizeof(header))
+		return nullptr;
+	std::memcpy(&header, file->data(), sizeof(header));
+	if(std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0 || header.version != CacheVersion ||
+		header.source_hash != source_hash || header.usage != static_cast<uint32_t>(usage) ||
+		header.allow_compression != static_cast<uint32_t>(allowCompression) || header.level_count == 0)
+		return nullptr;
+	
+	std::unique_ptr<MipChain> chain{new MipChain()};
+	chain->compression = static_cast<Compression>(header.compression);
+	size_t offset = sizeof(header);
+	for(uint32_t i = 0; i < header.level_count; ++i)
+	{
+		CacheLevel level;
+		if(file->size() - offset < sizeof(level))
+			return nullptr;
+		std::memcpy(&level, file->data() + offset, sizeof(level));
+		offset += sizeof(level);
+		if(file->size() - offset < level.size)
+			return nullptr;
+		chain->levels.push_back(Level{static_cast<GLsizei>(level.width), static_cast<GLsizei>(level.height),
+									  reinterpret_cast<const unsigned char*>(file->data() + offset), level.size});
+		offset += level.size;
+	}
+	chain->mapping = file;
+	return chain;
+}
+
+void save_cache(const std::string& cache_path, unsigned long long source_hash, Usage usage, bool allowCompression, const MipChain& chain)
+{
+	const std::string tmp_path = cache_path + ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ios::binary);
+		if(!out)
+		{
+			Log::warn("Could not write texture cache '", cache_path, "'.");
+			return;
+		}
+		CacheHeader header;
+		std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+		header.version = CacheVersion;
+		header.source_hash = source_hash;
+		header.usage = static_cast<uint32_t>(usage);
+		header.allow_compression = static_cast<uint32_t>(allowCompression);
+		header.compression = static_cast<uint32_t>(chain.compression);
+		header.level_count = static_cast<uint32_t>(chain.levels.size());
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for(const auto& l : chain.levels)
+		{
+			const CacheLevel level{static_cast<uint32_t>(l.width), static_cast<uint32_t>(l.height), l.size};
+			out.write(reinterpret_cast<const char*>(&level), sizeof(level));
+			out.write(reinterpret_cast<const char*>(l.data), l.size);
+		}
+		if(!out)
+		{
+			Log::warn("Error while writing texture cache '", cache_path, "'.");
+			out.close();
+			std::remove(tmp_path.c_str());
+			return;
+		}
+	}
+	std::remove(cache_path.c_str());
+	if(std::rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+		Log::warn("Could not write texture cache '", cache_path, "'.");
+}
+
+}
+
+size_t MipChain::getByteSize() const
+{
+	size_t r = 0;
+	for(const auto& l : levels)
+		r += l.size;
+	return r;
+}
+
+bool isSupported(Compression c)
+{
+	if(c != Compression::BC1 && c != Compression::BC3)
+		return true; // RGTC is core since 3.0
+	
+	static int s3tc = -1;
+	if(s3tc < 0)
+	{
+		s3tc = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for(GLint i = 0; i < count; ++i)
+			if(std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_EXT_texture_compression_s3tc") == 0)
+				s3tc = 1;
+	}
+	return s3tc == 1;
+}
+
+std::unique_ptr<MipChain> load(const std::string& path, Usage usage, bool allowCompression)
+{
+	MappedFile source;
+	if(!source.open(path))
+	{
+		Log::error("Could not open '", path, "'.");
+		return nullptr;
+	}
+	const auto source_hash = hash_rt(source.data(), source.size());
+	
+	const std::string cache_path = path + CacheExtension;
+	if(auto chain = load_cache(cache_path, source_hash, usage, allowCompression))
+		return chain;
+	
+	Image img;
+	int components = 0;
+	std::unique_ptr<unsigned char, void(*)(void*)> pixels{
+		stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), static_cast<int>(source.size()),
+							  &img.width, &img.height, &components, 4),
+		stbi_image_free
+	};
+	if(!pixels)
+	{
+		Log::error("Texture ", path, " is invalid.");
+		return nullptr;
+	}
+	img.pixels.assign(pixels.get(), pixels.get() + 4 * img.width * img.height);
+	pixels.reset();
+	
+	std::unique_ptr<MipChain> chain{new MipChain()};
+	if(allowCompression)
+	{
+		if(usage == Usage::Normal)
+		{
+			chain->compression = Compression::BC5;
+		} else {
+			chain->compression = Compression::BC1;
+			for(size_t i = 3; i < img.pixels.size(); i += 4)
+				if(img.pixels[i] < 255)
+				{
+					chain->compression = Compression::BC3;
+					break;
+				}
+		}
+	}
+	
+	while(true)
+	{
+		if(chain->compression == Compression::None)
+			chain->storage.push_back(img.pixels);
+		else
+			chain->storage.push_back(compress(img, chain->compression));
+		chain->levels.push_back(Level{img.width, img.height, chain->storage.back().data(), chain->storage.back().size()});
+		if(img.width == 1 && img.height == 1)
+			break;
+		img = downsample(img, usage);
+	}
+	
+	save_cache(cache_path, source_hash, usage, allowCompression, *chain);
+	
+	return chain;
+}
+
+void upload(Texture2D& t, const MipChain& chain)
+{
+	const GLenum format = internal_format(chain.compression);
+	t.create(nullptr, chain.levels[0].width, chain.levels[0].height, format, GL_RGBA, false);
+	t.bind();
+	for(size_t i = 0; i < chain.levels.size(); ++i)
+	{
+		const auto& l = chain.levels[i];
+		if(chain.compression == Compression::None)
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, l.width, l.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, l.data);
+		else
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, format, l.width, l.height, 0, l.size, l.data);
+	}
+	t.set(Texture::Parameter::BaseLevel, 0);
+	t.set(Texture::Parameter::MaxLevel, chain.levels.size() - 1);
+	t.set(Texture::Parameter::MinFilter, GL_LINEAR_MIPMAP_LINEAR);
+	t.set(Texture::Parameter::MagFilter, GL_LINEAR);
+	t.set(Texture::Parameter::WrapS, GL_REPEAT);
+	t.set(Texture::Parameter::WrapT, GL_REPEAT);
+	t.unbind();
+}
+
+void encodeBC1(const unsigned char* rgba, unsigned char* out)
+{
+	encode_bc1_color(rgba, out);
+}
+
+void encodeBC3(const unsigned char* rgba, unsigned char* out)
+{
+	encode_bc4(rgba, 3, out);
+	encode_bc1_color(rgba, out + 8);
+}
+
+void encodeBC5(const unsigned char* rgba, unsigned char* out)
+{
+	encode_bc4(rgba, 0, out);
+	encode_bc4(rgba, 1, out + 8);
+}
+
+}
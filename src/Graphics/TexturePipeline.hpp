@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <Texture2D.hpp>
+
+class MappedFile;
+
+/**
+ * CPU side texture processing: decoding, mip chain generation,
+ * optional block compression (BC1/BC3/BC5) and on-disk caching of the result.
+ * Everything except upload() and isSupported() can run on worker threads.
+**/
+namespace TexturePipeline
+{
+
+enum class Usage
+{
+	Color,	///< Diffuse/albedo: BC1, or BC3 if alpha is used
+	Normal	///< Tangent space normal map: BC5 (Z is reconstructed in the shaders)
+};
+
+enum class Compression : uint32_t
+{
+	None,
+	BC1,
+	BC3,
+	BC5
+};
+
+struct Level
+{
+	GLsizei					width;
+	GLsizei					height;
+	const unsigned char*	data;
+	size_t					size;
+};
+
+/**
+ * Complete mip chain, ready for upload.
+ * The data is either owned (storage) or points into a mapped cache file.
+**/
+struct MipChain
+{
+	Compression								compression = Compression::None;
+	std::vector<Level>						levels;
+	std::vector<std::vector<unsigned char>>	storage;
+	std::shared_ptr<MappedFile>				mapping;
+	
+	size_t getByteSize() const;
+};
+
+constexpr const char*	CacheExtension = ".stex";
+constexpr uint32_t		CacheVersion = 1;	///< Has to be incremented on any change to the cache format or to the processing.
+
+/// Enables block compression of the textures loaded from now on (when supported by the driver).
+extern bool CompressionEnabled;
+
+/**
+ * Main thread only.
+ * @return true if the driver supports this compression format.
+**/
+bool isSupported(Compression c);
+
+/**
+ * Loads the texture from its cache, or decodes it, builds its mip chain,
+ * compresses it and writes the cache.
+ * @param allowCompression Typically CompressionEnabled && isSupported(...), evaluated on the main thread.
+ * @return nullptr on failure.
+**/
+std::unique_ptr<MipChain> load(const std::string& path, Usage usage, bool allowCompression);
+
+/**
+ * Main thread only. (Re)Specifies all the levels of t from chain.
+**/
+void upload(Texture2D& t, const MipChain& chain);
+
+/**
+ * Encodes a 4x4 block of RGBA8 texels (row major).
+ * @param out 8 bytes for BC1, 16 for BC3 and BC5.
+**/
+void encodeBC1(const unsigned char* rgba, unsigned char* out);
+void encodeBC3(const unsigned char* rgba, unsigned char* out);
+void encodeBC5(const unsigned char* rgba, unsigned char* out);
+
+}
@@ -1,7 +1,35 @@
 #pragma once
 
+#include <cstring>
+
 #include <UniformBinding.hpp>
 #include <UniformGLM.hpp>
+#include <hash.hpp>
+
+/**
+ * Writes a value as laid out in a std140 uniform block (see Material).
+ * @return false if the type isn't supported.
+**/
+template<typename T>
+inline bool std140_store(char* dst, const T& value) { return false; }
+
+template<typename T>
+inline bool std140_store_raw(char* dst, const T& value) { std::memcpy(dst, &value, sizeof(T)); return true; }
+
+inline bool std140_store(char* dst, const float& value)			{ return std140_store_raw(dst, value); }
+inline bool std140_store(char* dst, const int& value)			{ return std140_store_raw(dst, value); }
+inline bool std140_store(char* dst, const unsigned int& value)	{ return std140_store_raw(dst, value); }
+inline bool std140_store(char* dst, const glm::vec2& value)		{ return std140_store_raw(dst, value); }
+inline bool std140_store(char* dst, const glm::vec3& value)		{ return std140_store_raw(dst, value); }
+inline bool std140_store(char* dst, const glm::vec4& value)		{ return std140_store_raw(dst, value); }
+inline bool std140_store(char* dst, const glm::mat4& value)		{ return std140_store_raw(dst, value); }
+inline bool std140_store(char* dst, const glm::mat3& value)
+{
+	// Columns are padded to vec4
+	for(int i = 0; i < 3; ++i)
+		std::memcpy(dst + i * sizeof(glm::vec4), &value[i], sizeof(glm::vec3));
+	return true;
+}
 
 class GenericUniform
 {
@@ -24,6 +52,17 @@ public:
 	
 	virtual void unbind(GLuint program) {}
 	
+	/**
+	 * Writes the value at dst, with the std140 layout.
+	 * @return false if not supported by this type of uniform.
+	**/
+	virtual bool store(char* dst) const { return false; }
+	
+	/// @return Hash of the name and value (see Material::getHash).
+	virtual unsigned long long hash() const =0;
+	/// @return true if other has the same name, type and value.
+	virtual bool equals(const GenericUniform& other) const =0;
+	
 	/**
 	 * Construct a new Uniform with the same attributes as this one.
 	 * Used for Material copying.
@@ -64,6 +103,22 @@ public:
 		setUniform(program,  getLocation(), getValue());
 	}
 	
+	virtual inline bool store(char* dst) const override
+	{
+		return std140_store(dst, getValue());
+	}
+	
+	virtual inline unsigned long long hash() const override
+	{
+		return hash_rt(&_value, sizeof(T), hash_rt(getName().c_str()));
+	}
+	
+	virtual inline bool equals(const GenericUniform& other) const override
+	{
+		auto o = dynamic_cast<const Uniform<T>*>(&other);
+		return o != nullptr && getName() == o->getName() && getValue() == o->getValue();
+	}
+	
 	virtual Uniform<T>* clone() const override
 	{
 		return new Uniform<T>(getName(), getLocation(), getValue());
@@ -74,6 +129,7 @@ protected:
 };
 
 #include <Texture.hpp>
+#include <BindlessTextures.hpp>
 
 template<>
 class Uniform<Texture> : public GenericUniform
@@ -112,6 +168,26 @@ public:
 		_value->unbind(_textureUnit);
 	}
 	
+	/// Bindless handle, for textures declared in a uniform block
+	virtual inline bool store(char* dst) const override
+	{
+		const GLuint64 handle = BindlessTextures::getHandle(*_value);
+		std::memcpy(dst, &handle, sizeof(handle));
+		return handle != 0;
+	}
+	
+	// The texture unit is an implementation detail, only the texture matters.
+	virtual inline unsigned long long hash() const override
+	{
+		return hash_rt(&_value, sizeof(_value), hash_rt(getName().c_str()));
+	}
+	
+	virtual inline bool equals(const GenericUniform& other) const override
+	{
+		auto o = dynamic_cast<const Uniform<Texture>*>(&other);
+		return o != nullptr && getName() == o->getName() && _value == o->_value;
+	}
+	
 	virtual Uniform<Texture>* clone() const override
 	{
 		return new Uniform<Texture>(getName(), getLocation(), getTextureUnit(), getValue());
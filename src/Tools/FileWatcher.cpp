@@ -0,0 +1,161 @@
+#include <FileWatcher.hpp>
+
+#include <algorithm>
+
+#include <Log.hpp>
+
+#if defined (__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#else
+#include <chrono>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+
+std::string parent_directory(const std::string& path)
+{
+	auto p = path.find_last_of('/');
+	return p == std::string::npos ? "." : (p == 0 ? "/" : path.substr(0, p));
+}
+
+}
+
+std::string FileWatcher::normalize(const std::string& path)
+{
+	std::string p = path;
+	std::replace(p.begin(), p.end(), '\\', '/');
+	const bool absolute = !p.empty() && p[0] == '/';
+	
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while(start <= p.size())
+	{
+		auto end = p.find('/', start);
+		if(end == std::string::npos) end = p.size();
+		const std::string part = p.substr(start, end - start);
+		if(part == "..")
+		{
+			if(!parts.empty() && parts.back() != "..")
+				parts.pop_back();
+			else if(!absolute)
+				parts.push_back(part);
+		} else if(!part.empty() && part != ".") {
+			parts.push_back(part);
+		}
+		start = end + 1;
+	}
+	
+	std::string r = absolute ? "/" : "";
+	for(size_t i = 0; i < parts.size(); ++i)
+		r += (i > 0 ? "/" : "") + parts[i];
+	return r.empty() ? "." : r;
+}
+
+#if defined (__linux__)
+
+FileWatcher::FileWatcher() :
+	_fd{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}
+{
+	if(_fd < 0)
+		Log::error("FileWatcher: inotify_init1 failed (", std::strerror(errno), ").");
+}
+
+FileWatcher::~FileWatcher()
+{
+	if(_fd >= 0)
+		close(_fd);
+}
+
+void FileWatcher::watch(const std::string& path)
+{
+	const auto file = normalize(path);
+	if(!_files.insert(file).second || _fd < 0)
+		return;
+	
+	// Directories are watched rather than files: most editors save by replacing the file.
+	const auto directory = parent_directory(file);
+	int wd = inotify_add_watch(_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if(wd < 0)
+		Log::warn("FileWatcher: Can't watch '", directory, "' (", std::strerror(errno), ").");
+	else
+		_directories[wd] = directory;
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+	std::vector<std::string> modified;
+	if(_fd < 0)
+		return modified;
+	
+	alignas(inotify_event) char buffer[4096];
+	ssize_t length;
+	while((length = read(_fd, buffer, sizeof(buffer))) > 0)
+	{
+		for(char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(ptr)->len)
+		{
+			const auto event = reinterpret_cast<const inotify_event*>(ptr);
+			auto it = _directories.find(event->wd);
+			if(event->len == 0 || it == _directories.end())
+				continue;
+			const auto file = normalize(it->second + "/" + event->name);
+			if(_files.count(file) > 0 && std::find(modified.begin(), modified.end(), file) == modified.end())
+				modified.push_back(file);
+		}
+	}
+	return modified;
+}
+
+#else
+
+namespace
+{
+
+long long modification_time(const std::string& path)
+{
+	struct stat s;
+	return stat(path.c_str(), &s) == 0 ? static_cast<long long>(s.st_mtime) : 0;
+}
+
+double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+FileWatcher::FileWatcher() =default;
+FileWatcher::~FileWatcher() =default;
+
+void FileWatcher::watch(const std::string& path)
+{
+	const auto file = normalize(path);
+	if(_files.insert(file).second)
+		_times[file] = modification_time(file);
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+	std::vector<std::string> modified;
+	const double t = now();
+	if(t - _last_poll < PollingPeriod)
+		return modified;
+	_last_poll = t;
+	
+	for(auto& f : _times)
+	{
+		const auto time = modification_time(f.first);
+		if(time != f.second)
+		{
+			f.second = time;
+			modified.push_back(f.first);
+		}
+	}
+	return modified;
+}
+
+#endif
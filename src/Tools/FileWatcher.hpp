@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+
+/**
+ * Reports modifications of a set of files.
+ * Uses inotify on Linux (watching the parent directories, so files replaced
+ * by editors are still tracked), and falls back to polling the modification
+ * times elsewhere.
+**/
+class FileWatcher
+{
+public:
+	FileWatcher();
+	FileWatcher(const FileWatcher&) =delete;
+	FileWatcher& operator=(const FileWatcher&) =delete;
+	~FileWatcher();
+	
+	/**
+	 * Starts watching path (no-op if already watched).
+	**/
+	void watch(const std::string& path);
+	
+	/**
+	 * Non-blocking.
+	 * @return Watched files (normalized, see normalize()) modified since the last call.
+	**/
+	std::vector<std::string> poll();
+	
+	/**
+	 * Lexically normalizes a path: uses '/' as separator, removes '.' and resolves '..' when possible.
+	**/
+	static std::string normalize(const std::string& path);
+	
+	/// Minimum time between two checks of the modification times (polling fallback only).
+	static constexpr float PollingPeriod = 0.5f;
+	
+private:
+	std::unordered_set<std::string>					_files;
+#if defined (__linux__)
+	int												_fd = -1;
+	std::unordered_map<int, std::string>			_directories;	///< Watch descriptor to directory
+#else
+	std::unordered_map<std::string, long long>		_times;			///< Last known modification times
+	double											_last_poll = 0.0;
+#endif
+};
@@ -0,0 +1,97 @@
+#include <MappedFile.hpp>
+
+#if defined (__WIN32__)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path)
+{
+	open(path);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined (__WIN32__)
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(_file == INVALID_HANDLE_VALUE)
+	{
+		_file = nullptr;
+		return false;
+	}
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(_mapping == nullptr)
+	{
+		close();
+		return false;
+	}
+	_data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	if(_data == nullptr)
+	{
+		close();
+		return false;
+	}
+	_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(_data) UnmapViewOfFile(_data);
+	if(_mapping) CloseHandle(_mapping);
+	if(_file) CloseHandle(_file);
+	_data = nullptr;
+	_mapping = nullptr;
+	_file = nullptr;
+	_size = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping keeps its own reference to the file
+	if(ptr == MAP_FAILED)
+		return false;
+	_data = static_cast<const char*>(ptr);
+	_size = static_cast<size_t>(st.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(_data)
+		munmap(const_cast<char*>(_data), _size);
+	_data = nullptr;
+	_size = 0;
+}
+
+#endif
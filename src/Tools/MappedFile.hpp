@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file.
+**/
+class MappedFile
+{
+public:
+	MappedFile() =default;
+	MappedFile(const std::string& path);
+	MappedFile(const MappedFile&) =delete;
+	MappedFile& operator=(const MappedFile&) =delete;
+	~MappedFile();
+	
+	/**
+	 * Maps the file at path (unmaps the previous one, if any).
+	 * @return true on success.
+	**/
+	bool open(const std::string& path);
+	void close();
+	
+	inline const char*	data() const { return _data; }	///< @return Pointer to the first byte of the mapping
+	inline size_t		size() const { return _size; }	///< @return Size of the mapping in bytes
+	inline explicit		operator bool() const { return _data != nullptr; }
+	
+private:
+	const char*	_data = nullptr;
+	size_t		_size = 0;
+#if defined (__WIN32__)
+	void*		_file = nullptr;
+	void*		_mapping = nullptr;
+#endif
+};
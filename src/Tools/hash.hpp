@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 // From https://github.com/elanthis/constexpr-hash-demo ("CC0" licensed)
 
 namespace impl
@@ -24,7 +26,7 @@ constexpr unsigned long long hash(const char* str)
 }
 
 // run-time hash
-unsigned long long hash_rt(const char* str)
+inline unsigned long long hash_rt(const char* str)
 {
 	unsigned long long hash = impl::basis;
 	while (*str != 0) {
@@ -34,3 +36,15 @@ unsigned long long hash_rt(const char* str)
 	}
 	return hash;
 }
+
+// run-time hash of a buffer, value can be used to chain calls
+inline unsigned long long hash_rt(const void* data, size_t size, unsigned long long value = impl::basis)
+{
+	const unsigned char* ptr = static_cast<const unsigned char*>(data);
+	for(size_t i = 0; i < size; ++i)
+	{
+		value ^= ptr[i];
+		value *= impl::prime;
+	}
+	return value;
+}